@@ -1,62 +1,17 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.*/
 
-//	Using SDL, SDL_image, SDL_ttf, standard IO, math, and strings
+//	Using SDL, SDL_ttf, standard IO, strings, and distance field fonts
 #include <SDL.h>
-#include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
 #include <string>
-#include <cmath>
+#include "../share/LSDFFont.h"
 
 // Screen dimension constants
 const int SCREEN_WIDTH	= 640;
 const int SCREEN_HEIGHT = 480;
 
-// Texture wrapper class
-class LTexture
-{
-	public:
-		// Initializes variables
-		LTexture();
-
-		// Deallocates memory
-		~LTexture();
-
-		// Loads image at specified path
-		bool loadFromFile( std::string path );
-		
-		// Creates image from font string
-		bool loadFromRenderedText( std::string textureText, SDL_Color textColor );
-
-		// Deallocates texture
-		void free();
-
-		// Set color modulation
-		void setColor( Uint8 red, Uint8 green, Uint8 blue );
-
-		// Set blending
-		void setBlendMode( SDL_BlendMode blending );
-
-		// Set alpha modulation
-		void setAlpha( Uint8 alpha );
-		
-		// Renders texture at given point
-		void render( int x, int y, SDL_Rect* clip = NULL, double angle = 0.0, SDL_Point* center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE );
-
-		// Gets image dimensions
-		int getWidth();
-		int getHeight();
-
-	private:
-		// The actual hardware texture
-		SDL_Texture* mTexture;
-
-		// Image dimensions
-		int mWidth;
-		int mHeight;
-};
-
 // Starts up SDL and creates window
 bool init();
 
@@ -72,153 +27,12 @@ SDL_Window*		gWindow		= NULL;
 // The window renderer
 SDL_Renderer*	gRenderer	= NULL;
 
-// Globally used font
-TTF_Font *		gFont		= NULL;
-
-// Rendered texture
-LTexture gTextTexture;
-
-
-LTexture::LTexture()
-{
-	// Initialize
-	mTexture= NULL;
-	mWidth	= 0;
-	mHeight = 0;
-}
-
-LTexture::~LTexture()
-{
-	// Deallocate
-	free();
-}
-
-bool LTexture::loadFromFile( std::string path )
-{
-	// Get rid of preexisting texture
-	free();
-
-	// The final texture
-	SDL_Texture* newTexture = NULL;
-
-	// Load image at specified path
-	SDL_Surface* loadedSurface = IMG_Load( path.c_str() );
-	if	( loadedSurface == NULL )	{
-		printf( "Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError() );
-	}
-	else	{
-		// Color key image
-		SDL_SetColorKey( loadedSurface, SDL_TRUE, SDL_MapRGB( loadedSurface->format, 0, 0xFF, 0xFF ) );
-
-		// Create texture from surface pixels
-        newTexture = SDL_CreateTextureFromSurface( gRenderer, loadedSurface );
-		if	( newTexture == NULL )	{
-			printf( "Unable to create texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
-		}
-		else	{
-			// Get image dimensions
-			mWidth	= loadedSurface->w;
-			mHeight = loadedSurface->h;
-		}
-
-		// Get rid of old loaded surface
-		SDL_FreeSurface( loadedSurface );
-	}
-
-	//	Return success
-	mTexture = newTexture;
-	return mTexture != NULL;
-}
-
-bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor )
-{
-	//	Get rid of preexisting texture
-	free();
-
-	//	Render text surface
-	SDL_Surface* textSurface =
-		TTF_RenderText_Solid(
-			gFont				,
-			textureText.c_str()	,
-			textColor
-		);
-
-	if	( textSurface == NULL )	{
-		printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
-	}
-	else	{
-		//	Create texture from surface pixels
-        mTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
-		if	( mTexture == NULL )	{
-			printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
-		}
-		else	{
-			//	Get image dimensions
-			mWidth	= textSurface->w;
-			mHeight = textSurface->h;
-		}
-
-		//	Get rid of old surface
-		SDL_FreeSurface( textSurface );
-	}
-	
-	// Return success
-	return mTexture != NULL;
-}
-
-void LTexture::free()
-{
-	//	Free texture if it exists
-	if	( mTexture != NULL )	{
-		SDL_DestroyTexture( mTexture );
-		mTexture= NULL;
-		mWidth	= 0;
-		mHeight = 0;
-	}
-}
-
-void LTexture::setColor( Uint8 red, Uint8 green, Uint8 blue )
-{
-	//	Modulate texture rgb
-	SDL_SetTextureColorMod( mTexture, red, green, blue );
-}
-
-void LTexture::setBlendMode( SDL_BlendMode blending )
-{
-	//	Set blending function
-	SDL_SetTextureBlendMode( mTexture, blending );
-}
-		
-void LTexture::setAlpha( Uint8 alpha )
-{
-	//	Modulate texture alpha
-	SDL_SetTextureAlphaMod( mTexture, alpha );
-}
-
-void LTexture::render( int x, int y, SDL_Rect* clip, double angle, SDL_Point* center, SDL_RendererFlip flip )
-{
-	//	Set rendering space and render to screen
-	SDL_Rect renderQuad = { x, y, mWidth, mHeight };
-
-	//	Set clip rendering dimensions
-	if	( clip != NULL )	{
-		renderQuad.w = clip->w;
-		renderQuad.h = clip->h;
-	}
-
-	//	Render to screen
-	SDL_RenderCopyEx( gRenderer, mTexture, clip, &renderQuad, angle, center, flip );
-}
-
-int LTexture::getWidth()
-{
-	return mWidth;
-}
+// Distance field font, one atlas for every size
+LSDFFont gSDFFont;
 
-int LTexture::getHeight()
-{
-	return mHeight;
-}
+// Shown text and sizes
+const std::string	TEXT		= "The quick brown fox jumps over the lazy dog";
+const int			TEXT_SIZES[]= { 14, 28, 56 };
 
 bool init()
 {
@@ -268,17 +82,6 @@ bool init()
 				//	Initialize renderer color
 				SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 
-				//	Initialize PNG loading
-				int imgFlags = IMG_INIT_PNG;
-				if	( !( IMG_Init( imgFlags ) & imgFlags ) )
-				{
-					printf(
-						"SDL_image could not initialize! SDL_image Error: %s\n"	,
-						IMG_GetError()
-					);
-					success = false;
-				}
-
 				//	Initialize SDL_ttf
 				if	( TTF_Init() == -1 )
 				{
@@ -300,32 +103,19 @@ bool loadMedia()
 	// Loading success flag
 	bool success = true;
 
-	// Open the font
-	gFont = TTF_OpenFont( "./lazy.ttf", 28 );
-	if	( gFont == NULL )	{
-		printf( "Failed to load lazy font! SDL_ttf Error: %s\n", TTF_GetError() );
+	// Build the font once, sizes are scaled from it
+	if	( !gSDFFont.build( gRenderer, "./lazy.ttf" ) )	{
+		printf( "Failed to load lazy font!\n" );
 		success = false;
 	}
-	else	{
-		//	Render text
-		SDL_Color textColor = { 0, 0, 0, 255 };
-		if	( !gTextTexture.loadFromRenderedText( "The quick brown fox jumps over the lazy dog", textColor ) )	{
-			printf( "Failed to render text texture!\n" );
-			success = false;
-		}
-	}
 
 	return success;
 }
 
 void close()
 {
-	//	Free loaded images
-	gTextTexture.free();
-
-	//	Free global font
-	TTF_CloseFont( gFont );
-	gFont = NULL;
+	//	Free the font atlas
+	gSDFFont.free();
 
 	// Destroy window	
 	SDL_DestroyRenderer	( gRenderer );
@@ -335,7 +125,6 @@ void close()
 
 	// Quit SDL subsystems
 	TTF_Quit();
-	IMG_Quit();
 	SDL_Quit();
 }
 
@@ -371,8 +160,15 @@ int main( int, char* [])
 				SDL_SetRenderDrawColor	( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 				SDL_RenderClear			( gRenderer );
 
-				// Render current frame
-				gTextTexture.render( ( SCREEN_WIDTH - gTextTexture.getWidth() ) / 2, ( SCREEN_HEIGHT - gTextTexture.getHeight() ) / 2 );
+				// Render current frame, the same text at every size
+				SDL_Color	textColor	= { 0, 0, 0, 255 };
+				int			y			= SCREEN_HEIGHT / 4;
+				for	( int size : TEXT_SIZES )	{
+					int w = 0, h = 0;
+					gSDFFont.getTextSize( TEXT, size, &w, &h );
+					gSDFFont.renderText( ( SCREEN_WIDTH - w ) / 2, y, TEXT, size, textColor );
+					y += h;
+				}
 
 				// Update screen
 				SDL_RenderPresent		( gRenderer );
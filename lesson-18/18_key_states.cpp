@@ -1,12 +1,13 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.*/
 
-//	Using SDL, SDL_image, standard IO, and strings
+//	Using SDL, SDL_image, SDL_ttf, standard IO, strings, and distance field fonts
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
 #include <string>
+#include "../share/LSDFFont.h"
 
 //	Screen dimension constants
 const int SCREEN_WIDTH	= 640;
@@ -25,11 +26,6 @@ class LTexture
 		//Loads image at specified path
 		bool loadFromFile( std::string path );
 		
-		#if	defined( SDL_TTF_MAJOR_VERSION )
-		//	Creates image from font string
-		bool loadFromRenderedText( std::string textureText, SDL_Color textColor );
-		#endif
-		
 		//	Deallocates texture
 		void free();
 
@@ -73,11 +69,10 @@ SDL_Window*		gWindow		= NULL;
 //	The window renderer
 SDL_Renderer*	gRenderer	= NULL;
 
-// Globally used font
-TTF_Font *		gFont		= NULL;
+//	Prompt font, one atlas for every size
+LSDFFont gSDFFont;
 
 //	Scene textures
-LTexture gPressTexture;
 LTexture gUpTexture;
 LTexture gDownTexture;
 LTexture gLeftTexture;
@@ -136,47 +131,6 @@ bool LTexture::loadFromFile( std::string path )
 	return mTexture != NULL;
 }
 
-#if	defined( SDL_TTF_MAJOR_VERSION )
-bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor )
-{
-	//	Get rid of preexisting texture
-	free();
-
-	//	Render text surface
-	SDL_Surface* textSurface =
-		TTF_RenderText_Solid(
-			gFont				,
-			textureText.c_str()	,
-			textColor
-		);
-
-	if	( textSurface != NULL )	{
-		//	Create texture from surface pixels
-        mTexture =
-			SDL_CreateTextureFromSurface( gRenderer, textSurface );
-
-		if	( mTexture == NULL )	{
-			printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
-		}
-		else	{
-			//	Get image dimensions
-			mWidth	= textSurface->w;
-			mHeight = textSurface->h;
-		}
-
-		//	Get rid of old surface
-		SDL_FreeSurface( textSurface );
-	}
-	else
-	{
-		printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
-	}
-
-	//	Return success
-	return mTexture != NULL;
-}
-#endif
-
 void LTexture::free()
 {
 	//	Free texture if it exists
@@ -316,29 +270,11 @@ bool loadMedia()
 	//	Loading success flag
 	bool success = true;
 
-	//	Open the font
-	gFont = TTF_OpenFont( "./OpenSans-Regular.ttf", 76 );
-	if	( gFont == NULL )	{
-		printf(
-			"Failed to load lazy font! SDL_ttf Error: %s\n"		,
-			TTF_GetError()
-		);
+	//	Build the prompt font once instead of opening it at 76 points
+	if	( !gSDFFont.build( gRenderer, "./OpenSans-Regular.ttf" ) )	{
+		printf( "Failed to load OpenSans font!\n" );
 		success = false;
 	}
-	else	{
-		//	Render text
-		SDL_Color textColor = { 0, 0, 0, 255 };
-		if	(
-				!gPressTexture.loadFromRenderedText(
-					"Pressez une touche",
-					textColor
-				)
-			)
-		{
-			printf( "Failed to render text texture!\n" );
-			success = false;
-		}
-	}
 
 	//	Load press texture
 /* 	if	( !gPressTexture.loadFromFile( "./press.png" ) )
@@ -381,16 +317,12 @@ bool loadMedia()
 void close()
 {
 	//	Free loaded images
-	gPressTexture.	free();
+	gSDFFont.		free();
 	gUpTexture.		free();
 	gDownTexture.	free();
 	gLeftTexture.	free();
 	gRightTexture.	free();
 
-	//	Free global font
-	TTF_CloseFont( gFont );
-	gFont = NULL;
-
 	//	Destroy window	
 	SDL_DestroyRenderer	( gRenderer );
 	SDL_DestroyWindow	( gWindow );
@@ -461,15 +393,23 @@ int main( int, char* [] )
 				}
 				else
 				{
-					currentTexture = &gPressTexture;
+					currentTexture = NULL;
 				}
 
 				//	Clear screen
 				SDL_SetRenderDrawColor	( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 				SDL_RenderClear			( gRenderer );
 
-				//	Render current texture
-				currentTexture->render( 0, 0 );
+				//	Render current texture, or the prompt
+				if	( currentTexture != NULL )
+				{
+					currentTexture->render( 0, 0 );
+				}
+				else
+				{
+					SDL_Color textColor = { 0, 0, 0, 255 };
+					gSDFFont.renderText( 0, 0, "Pressez une touche", 76, textColor );
+				}
 
 				//	Update screen
 				SDL_RenderPresent( gRenderer );
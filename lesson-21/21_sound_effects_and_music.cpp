@@ -1,17 +1,32 @@
 /*	This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.*/
 
-//	Using SDL, SDL_image, SDL_ttf, SDL_mixer, standard IO, math, and strings
+//	Using SDL, SDL_image, standard IO, strings, vectors and the software mixer
 #include <SDL.h>
 #include <SDL_image.h>
-#include <SDL_mixer.h>
 #include <stdio.h>
 #include <string>
+#include <vector>
+#include "../share/LMixer.h"
 
 //	Screen dimension constants
 const int SCREEN_WIDTH	= 640;
 const int SCREEN_HEIGHT = 480;
 
+//	Mixing rate and default device buffer, 512 frames is under 12 ms
+const int       MIXER_FREQUENCY = 44100;
+const Uint16    MIXER_SAMPLES   = 512;
+
+//	Most voices playing at once
+const int       MIXER_VOICES    = 256;
+
+//	Effects can never take over the music's voice
+const int       PRIORITY_EFFECT = 0;
+const int       PRIORITY_MUSIC  = 1;
+
+//	Voices started by one burst
+const int       BURST_VOICES    = 64;
+
 //	Texture wrapper class
 class LTexture
 {
@@ -64,6 +79,12 @@ bool init();
 //	Loads media
 bool loadMedia();
 
+//	Random number from low to high
+float randomRange( float low, float high );
+
+//	Times the mixer instead of running the demo
+void benchmark();
+
 //	Frees media and shuts down SDL
 void close();
 
@@ -76,14 +97,20 @@ SDL_Renderer*	gRenderer	= NULL;
 //	Scene texture
 LTexture		gPromptTexture;
 
-//	The music that will be played
-Mix_Music *		gMusic		= NULL;
+//	The mixer everything plays through and its device buffer size
+LMixer          gMixer;
+Uint16          gMixerSamples   = MIXER_SAMPLES;
+
+//	The music that will be played, its voice and whether it is paused
+LSound          gMusic;
+Uint32          gMusicVoice = 0;
+bool            gMusicPaused= false;
 
 //	The sound effects that will be used
-Mix_Chunk *		gScratch    = NULL;
-Mix_Chunk *		gHigh       = NULL;
-Mix_Chunk *		gMedium     = NULL;
-Mix_Chunk *		gLow        = NULL;
+LSound          gScratch;
+LSound          gHigh;
+LSound          gMedium;
+LSound          gLow;
 
 
 LTexture::LTexture()
@@ -301,10 +328,10 @@ bool init()
                     success = false;
                 }
 
-                //  Initialize SDL_mixer
-                if  ( Mix_OpenAudio( 44100, MIX_DEFAULT_FORMAT, 2, 2048 ) < 0 )
+                //  Initialize the mixer and start its audio device
+                if  ( !gMixer.init( MIXER_VOICES, MIXER_FREQUENCY ) || !gMixer.open( gMixerSamples ) )
                 {
-                    printf( "SDL_mixer could not initialize! SDL_mixer Error: %s\n", Mix_GetError() );
+                    printf( "Mixer could not initialize!\n" );
                     success = false;
                 }
             }
@@ -327,63 +354,116 @@ bool loadMedia()
     }
 
     //  Load music
-    gMusic  = Mix_LoadMUS( "./wav/beat.wav" );
-    if  ( gMusic == NULL )
+    if  ( !gMusic.loadFromFile( "./wav/beat.wav", MIXER_FREQUENCY ) )
     {
-        printf( "Failed to load beat music! SDL_mixer Error: %s\n", Mix_GetError() );
+        printf( "Failed to load beat music!\n" );
         success = false;
     }
 
     //  Load sound effects
-    gScratch= Mix_LoadWAV( "./wav/scratch.wav" );
-    if  ( gScratch == NULL )
+    if  ( !gScratch.loadFromFile( "./wav/scratch.wav", MIXER_FREQUENCY ) )
     {
-        printf( "Failed to load scratch sound effect! SDL_mixer Error: %s\n", Mix_GetError() );
+        printf( "Failed to load scratch sound effect!\n" );
         success = false;
     }
 
-    gHigh   = Mix_LoadWAV( "./wav/high.wav" );
-    if  ( gHigh == NULL )
+    if  ( !gHigh.loadFromFile( "./wav/high.wav", MIXER_FREQUENCY ) )
     {
-        printf( "Failed to load high sound effect! SDL_mixer Error: %s\n", Mix_GetError() );
+        printf( "Failed to load high sound effect!\n" );
         success = false;
     }
 
-    gMedium = Mix_LoadWAV( "./wav/medium.wav" );
-    if  ( gMedium == NULL )
+    if  ( !gMedium.loadFromFile( "./wav/medium.wav", MIXER_FREQUENCY ) )
     {
-        printf( "Failed to load medium sound effect! SDL_mixer Error: %s\n", Mix_GetError() );
+        printf( "Failed to load medium sound effect!\n" );
         success = false;
     }
 
-    gLow    = Mix_LoadWAV( "./wav/low.wav" );
-    if  ( gLow == NULL )
+    if  ( !gLow.loadFromFile( "./wav/low.wav", MIXER_FREQUENCY ) )
     {
-        printf( "Failed to load low sound effect! SDL_mixer Error: %s\n", Mix_GetError() );
+        printf( "Failed to load low sound effect!\n" );
         success = false;
     }
 
     return success;
 }
 
+//  Random number from low to high
+float randomRange( float low, float high )
+{
+    return low + ( high - low ) * rand() / (float) RAND_MAX;
+}
+
+void benchmark()
+{
+    //  Voice counts and seconds of audio per measure
+    const int   VOICE_COUNTS[]  = { 64, 256, 1024 };
+    const int   BENCH_SECONDS   = 4;
+
+    //  Sounds the voices are picked from
+    LSound*     sounds[ 5 ]     = { &gHigh, &gMedium, &gLow, &gScratch, &gMusic };
+
+    std::vector<float> out( MIXER_SAMPLES * 2 );
+
+    printf( "%8s %8s %16s %18s\n", "voices", "pitch", "cpu ms per s", "voice ms / cpu ms" );
+
+    for ( int count : VOICE_COUNTS )
+    {
+        for ( bool pitched : { false, true } )
+        {
+            //  A mixer of its own with every voice looping
+            LMixer mixer;
+            mixer.init( count, MIXER_FREQUENCY );
+            for ( int i = 0; i < count; ++i )
+            {
+                mixer.play(
+                    sounds[ rand() % 5 ]                            ,
+                    1.0f / count                                    ,
+                    randomRange( -1.0f, 1.0f )                      ,
+                    pitched ? randomRange( 0.5f, 2.0f ) : 1.0f      ,
+                    PRIORITY_EFFECT                                 ,
+                    true
+                );
+            }
+
+            //  Mix device sized buffers as a callback would
+            Uint64 start = SDL_GetPerformanceCounter();
+            for ( int frames = 0; frames < MIXER_FREQUENCY * BENCH_SECONDS; frames += MIXER_SAMPLES )
+            {
+                mixer.mix( out.data(), MIXER_SAMPLES );
+            }
+            double cpuMs = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency();
+
+            //  Milliseconds of voices mixed per millisecond of CPU, the voices one core could keep playing
+            printf(
+                "%8d %8s %16.3f %18.1f\n"                          ,
+                count                                               ,
+                pitched ? "varied" : "1.0"                          ,
+                cpuMs / BENCH_SECONDS                               ,
+                count * BENCH_SECONDS * 1000.0 / cpuMs
+            );
+        }
+    }
+}
+
 void close()
 {
     //  Free loaded images
     gPromptTexture.free();
 
+    //  Stop mixing before the sounds go away
+    printf( "Voices stolen: %u, dropped: %u\n", gMixer.getStolenVoices(), gMixer.getDroppedVoices() );
+    gMixer.close();
+
     //  Free the sound effects
-    Mix_FreeChunk( gScratch );
-    Mix_FreeChunk( gHigh    );
-    Mix_FreeChunk( gMedium  );
-    Mix_FreeChunk( gLow     );
-    gScratch= NULL;
-    gHigh   = NULL;
-    gMedium = NULL;
-    gLow    = NULL;
+    gScratch.free();
+    gHigh.   free();
+    gMedium. free();
+    gLow.    free();
 
     //  Free the music
-    Mix_FreeMusic( gMusic );
-    gMusic = NULL;
+    gMusic.free();
+    gMusicVoice = 0;
 
     //  Destroy window
     SDL_DestroyRenderer ( gRenderer );
@@ -392,13 +472,21 @@ void close()
     gRenderer   = NULL;
 
     //  Quit SDL subsystems
-    Mix_Quit();
     IMG_Quit();
     SDL_Quit();
 }
 
-int main( int, char* [] )
+int main( int argc, char* args[] )
 {
+    //  Take a device buffer size, as measured by lesson 34's --latency
+    for ( int i = 1; i + 1 < argc; ++i )
+    {
+        if  ( std::string( args[ i ] ) == "--samples" )
+        {
+            gMixerSamples = (Uint16) SDL_clamp( SDL_atoi( args[ i + 1 ] ), 64, 8192 );
+        }
+    }
+
     //  Start up SDL and create window
     if  ( !init() )
     {
@@ -411,6 +499,11 @@ int main( int, char* [] )
         {
             printf( "Failed to load media!\n" );
         }
+        //  Time the mixer instead of running the demo
+        else if ( argc > 1 && std::string( args[ 1 ] ) == "--bench" )
+        {
+            benchmark();
+        }
         else
         {
             //  Main loop flag
@@ -437,52 +530,71 @@ int main( int, char* [] )
                         {
                             //  Play high sound effect
                             case SDLK_1:
-                            Mix_PlayChannel( -1, gHigh, 0 );
+                            gMixer.play( &gHigh, 1.0f, 0.0f, 1.0f, PRIORITY_EFFECT );
                             break;
 
                             //  Play medium sound effect
                             case SDLK_2:
-                            Mix_PlayChannel( -1, gMedium, 0 );
+                            gMixer.play( &gMedium, 1.0f, 0.0f, 1.0f, PRIORITY_EFFECT );
                             break;
 
                             //  Play low sound effect
                             case SDLK_3:
-                            Mix_PlayChannel( -1, gLow, 0 );
+                            gMixer.play( &gLow, 1.0f, 0.0f, 1.0f, PRIORITY_EFFECT );
                             break;
 
                             //  Play scratch sound effect
                             case SDLK_4:
-                            Mix_PlayChannel( -1, gScratch, 0 );
+                            gMixer.play( &gScratch, 1.0f, 0.0f, 1.0f, PRIORITY_EFFECT );
+                            break;
+
+                            //  Play a burst of effects spread across the stereo field at random pitches
+                            case SDLK_5:
+                            for ( int i = 0; i < BURST_VOICES; ++i )
+                            {
+                                LSound* effects[ 4 ] = { &gHigh, &gMedium, &gLow, &gScratch };
+                                gMixer.play(
+                                    effects[ rand() % 4 ]           ,
+                                    0.25f                           ,
+                                    randomRange( -1.0f, 1.0f )      ,
+                                    randomRange( 0.5f, 2.0f )       ,
+                                    PRIORITY_EFFECT
+                                );
+                            }
                             break;
 
                             case SDLK_9:
                             //  If there is no music playing
-                            if  ( Mix_PlayingMusic() == 0 )
+                            if  ( gMusicVoice == 0 )
                             {
                                 //  Play the music
-                                Mix_PlayMusic( gMusic, -1 );
+                                gMusicVoice     = gMixer.play( &gMusic, 1.0f, 0.0f, 1.0f, PRIORITY_MUSIC, true );
+                                gMusicPaused    = false;
                             }
                             //  If music is being played
                             else
                             {
                                 //  If the music is paused
-                                if  ( Mix_PausedMusic() == 1 )
+                                if  ( gMusicPaused )
                                 {
                                     //  Resume the music
-                                    Mix_ResumeMusic();
+                                    gMixer.resume( gMusicVoice );
+                                    gMusicPaused = false;
                                 }
                                 //  If the music is playing
                                 else
                                 {
                                     //  Pause the music
-                                    Mix_PauseMusic();
+                                    gMixer.pause( gMusicVoice );
+                                    gMusicPaused = true;
                                 }
                             }
                             break;
 
                             case SDLK_0:
                             //  Stop the music
-                            Mix_HaltMusic();
+                            gMixer.stop( gMusicVoice );
+                            gMusicVoice = 0;
                             break;
                         }
                     }
@@ -1,64 +1,18 @@
 /*  This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.*/
 
-//  Using SDL, SDL_image, SDL_ttf, standard IO, strings, and string streams
+//  Using SDL, SDL_ttf, standard IO, strings, string streams, and the glyph atlas
 #include <SDL.h>
-#include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
 #include <string>
 #include <sstream>
+#include "../share/LGlyphAtlas.h"
 
 //  Screen dimension constants
 const int SCREEN_WIDTH  = 640;
 const int SCREEN_HEIGHT = 480;
 
-//Texture wrapper class
-class LTexture
-{
-	public:
-		//  Initializes variables
-		LTexture();
-
-		//  Deallocates memory
-		~LTexture();
-
-		//  Loads image at specified path
-		bool loadFromFile( std::string path );
-		
-		#if defined(SDL_TTF_MAJOR_VERSION)
-		//  Creates image from font string
-		bool loadFromRenderedText( std::string textureText, SDL_Color textColor );
-		#endif
-
-		//  Deallocates texture
-		void free();
-
-		//  Set color modulation
-		void setColor( Uint8 red, Uint8 green, Uint8 blue );
-
-		//  Set blending
-		void setBlendMode( SDL_BlendMode blending );
-
-		//  Set alpha modulation
-		void setAlpha( Uint8 alpha );
-		
-		//  Renders texture at given point
-		void render( int x, int y, SDL_Rect* clip = NULL, double angle = 0.0, SDL_Point* center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE );
-
-		//  Gets image dimensions
-		int getWidth();
-		int getHeight();
-
-	private:
-		//  The actual hardware texture
-		SDL_Texture* mTexture;
-
-		//  Image dimensions
-		int mWidth;
-		int mHeight;
-};
-
 //  The application time based timer
 class LTimer
 {
@@ -109,156 +63,8 @@ SDL_Renderer* gRenderer = NULL;
 //  Globally used font
 TTF_Font* gFont = NULL;
 
-//  Scene textures
-LTexture gFPSTextTexture;
-
-LTexture::LTexture()
-{
-	//  Initialize
-	mTexture= NULL;
-	mWidth  = 0;
-	mHeight = 0;
-}
-
-LTexture::~LTexture()
-{
-	//  Deallocate
-	free();
-}
-
-bool LTexture::loadFromFile( std::string path )
-{
-	//  Get rid of preexisting texture
-	free();
-
-	//  The final texture
-	SDL_Texture*    newTexture      = NULL;
-
-	//  Load image at specified path
-	SDL_Surface*    loadedSurface   = IMG_Load( path.c_str() );
-	if  ( loadedSurface == NULL )
-	{
-		printf( "Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError() );
-	}
-	else
-	{
-		//  Color key image
-		SDL_SetColorKey( loadedSurface, SDL_TRUE, SDL_MapRGB( loadedSurface->format, 0, 0xFF, 0xFF ) );
-
-		//  Create texture from surface pixels
-        newTexture = SDL_CreateTextureFromSurface( gRenderer, loadedSurface );
-		if  ( newTexture == NULL )
-		{
-			printf( "Unable to create texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
-		}
-		else
-		{
-			//  Get image dimensions
-			mWidth  = loadedSurface->w;
-			mHeight = loadedSurface->h;
-		}
-
-		//  Get rid of old loaded surface
-		SDL_FreeSurface( loadedSurface );
-	}
-
-	//  Return success
-	mTexture = newTexture;
-	return mTexture != NULL;
-}
-
-#if defined(SDL_TTF_MAJOR_VERSION)
-bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor )
-{
-	//  Get rid of preexisting texture
-	free();
-
-	//  Render text surface
-	SDL_Surface* textSurface = TTF_RenderText_Solid( gFont, textureText.c_str(), textColor );
-	if  ( textSurface != NULL )
-	{
-		//  Create texture from surface pixels
-        mTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
-		if  ( mTexture == NULL )
-		{
-			printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
-		}
-		else
-		{
-			//  Get image dimensions
-			mWidth  = textSurface->w;
-			mHeight = textSurface->h;
-		}
-
-		//  Get rid of old surface
-		SDL_FreeSurface( textSurface );
-	}
-	else
-	{
-		printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
-	}
-
-	
-	//  Return success
-	return mTexture != NULL;
-}
-#endif
-
-void LTexture::free()
-{
-	//  Free texture if it exists
-	if  ( mTexture != NULL )
-	{
-		SDL_DestroyTexture( mTexture );
-		mTexture= NULL;
-		mWidth  = 0;
-		mHeight = 0;
-	}
-}
-
-void LTexture::setColor     ( Uint8 red, Uint8 green, Uint8 blue )
-{
-	//  Modulate texture rgb
-	SDL_SetTextureColorMod  ( mTexture, red, green, blue );
-}
-
-void LTexture::setBlendMode ( SDL_BlendMode blending )
-{
-	//  Set blending function
-	SDL_SetTextureBlendMode ( mTexture, blending );
-}
-		
-void LTexture::setAlpha     ( Uint8 alpha )
-{
-	//  Modulate texture alpha
-	SDL_SetTextureAlphaMod  ( mTexture, alpha );
-}
-
-void LTexture::render( int x, int y, SDL_Rect* clip, double angle, SDL_Point* center, SDL_RendererFlip flip )
-{
-	//  Set rendering space and render to screen
-	SDL_Rect renderQuad = { x, y, mWidth, mHeight };
-
-	//  Set clip rendering dimensions
-	if  ( clip != NULL )
-	{
-		renderQuad.w = clip->w;
-		renderQuad.h = clip->h;
-	}
-
-	//  Render to screen
-	SDL_RenderCopyEx( gRenderer, mTexture, clip, &renderQuad, angle, center, flip );
-}
-
-int LTexture::getWidth()
-{
-	return mWidth;
-}
-
-int LTexture::getHeight()
-{
-	return mHeight;
-}
+//  Glyphs of the FPS text
+LGlyphAtlas gTextAtlas;
 
 LTimer::LTimer()
 {
@@ -417,14 +223,6 @@ bool init()
 				//  Initialize renderer color
 				SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 
-				//  Initialize PNG loading
-				int imgFlags = IMG_INIT_PNG;
-				if  ( !( IMG_Init( imgFlags ) & imgFlags ) )
-				{
-					printf( "SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError() );
-					success = false;
-				}
-
 				//  Initialize SDL_ttf
 				if  ( TTF_Init() == -1 )
 				{
@@ -450,14 +248,20 @@ bool loadMedia()
 		printf( "Failed to load lazy font! SDL_ttf Error: %s\n", TTF_GetError() );
 		success = false;
 	}
+	//  Cache its glyphs
+	else if ( !gTextAtlas.init( gRenderer, gFont ) )
+	{
+		printf( "Failed to create glyph atlas!\n" );
+		success = false;
+	}
 
 	return success;
 }
 
 void close()
 {
-	//  Free loaded images
-	gFPSTextTexture.free();
+	//  Free the glyph atlas
+	gTextAtlas.free();
 
 	//  Free global font
 	TTF_CloseFont( gFont );
@@ -471,7 +275,6 @@ void close()
 
 	//  Quit SDL subsystems
 	TTF_Quit();
-	IMG_Quit();
 	SDL_Quit();
 }
 
@@ -534,18 +337,21 @@ int main( int, char* [] )
 				timeText.str( "" );
 				timeText << "Average Frames Per Second " << avgFPS; 
 
-				//  Render text
-				if  ( !gFPSTextTexture.loadFromRenderedText( timeText.str().c_str(), textColor ) )
-				{
-					printf( "Unable to render FPS texture!\n" );
-				}
-
 				//  Clear screen
 				SDL_SetRenderDrawColor  ( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 				SDL_RenderClear         ( gRenderer );
 
-				//  Render textures
-				gFPSTextTexture.render  ( ( SCREEN_WIDTH - gFPSTextTexture.getWidth() ) / 2, ( SCREEN_HEIGHT - gFPSTextTexture.getHeight() ) / 2 );
+				//  Render text from cached glyphs, nothing is rasterized once
+				//	the digits have been seen
+				int textWidth = 0, textHeight = 0;
+				gTextAtlas.getTextSize( timeText.str(), &textWidth, &textHeight );
+				gTextAtlas.
+                    renderText(
+                        ( SCREEN_WIDTH  - textWidth  ) / 2,
+                        ( SCREEN_HEIGHT - textHeight ) / 2,
+                        timeText.str(),
+                        textColor
+                    );
 
 				//  Update screen
 				SDL_RenderPresent       ( gRenderer );
@@ -1,13 +1,17 @@
 /*  This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.*/
 
-//  Using SDL, SDL_image, SDL_ttf, standard IO, strings, and string streams
+//  Using SDL, SDL_image, SDL_ttf, standard IO, strings, string streams, vectors, algorithms, the glyph atlas and UTF-8
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include "../share/LGlyphAtlas.h"
+#include "../share/LUTF8.h"
 
 //  Screen dimension constants
 const int SCREEN_WIDTH	= 640;
@@ -59,6 +63,62 @@ class LTexture
 		int mHeight;
 };
 
+//  Single line text editor drawn from cached glyphs
+class LTextInput
+{
+    public:
+		//  Initializes variables
+		LTextInput();
+
+		//  Sets the glyphs the text is measured and drawn with
+		void setGlyphs( LGlyphAtlas* glyphs );
+
+		//  Inserts UTF-8 text at the cursor
+		void insert( std::string text );
+
+		//  Removes the character before or after the cursor
+		void erase( bool forward = false );
+
+		//  Moves the cursor by a number of characters or to a position
+		void moveCursor( int delta );
+		void setCursor( int position );
+
+		//  Gets the whole text as UTF-8
+		std::string getText();
+
+		//  Gets the number of characters and the text width
+		int getLength();
+		int getWidth();
+
+		//  Shows the text in a box, centered if it fits and scrolled
+		//	to the cursor if not, only visible characters are drawn
+		void render( int x, int y, int width, SDL_Color color );
+
+    private:
+		//  Moves the gap to a character position
+		void moveGap( int position );
+
+		//  Gets the character at a position, skipping the gap
+		Uint16 getCharacter( int position );
+
+		//  Measures again from the first changed character on
+		void layout( int from );
+
+		//  Characters with a gap at the cursor, so typing there only
+		//	writes into the gap
+		std::vector<Uint16> mBuffer;
+		int     mGapStart, mGapEnd;
+
+		//  Where each character starts, plus the end of the text
+		std::vector<int>    mOffsets;
+
+		//  The glyph cache
+		LGlyphAtlas*    mGlyphs;
+
+		//  Pixels scrolled off the left of the box
+		int     mScroll;
+};
+
 //  Starts up SDL and creates window
 bool init();
 
@@ -79,7 +139,10 @@ TTF_Font *gFont = NULL;
 
 //  Scene textures
 LTexture gPromptTextTexture;
-LTexture  gInputTextTexture;
+
+//  The input text and its glyphs
+LGlyphAtlas gInputGlyphs;
+LTextInput  gInputText;
 
 LTexture::LTexture()
 {
@@ -231,6 +294,195 @@ int LTexture::getHeight()
 	return mHeight;
 }
 
+        LTextInput::LTextInput()
+{
+    //  Initialize
+    mGapStart   = 0;
+    mGapEnd     = 0;
+    mGlyphs     = NULL;
+    mScroll     = 0;
+    mOffsets.push_back( 0 );
+}
+
+void    LTextInput::setGlyphs   ( LGlyphAtlas* glyphs )
+{
+    //  Measure everything again with the new glyphs
+    mGlyphs = glyphs;
+    layout( 0 );
+}
+
+void    LTextInput::insert  ( std::string text )
+{
+    //  Decode, controls such as pasted newlines become spaces
+    std::vector<Uint16> characters;
+    for ( int i = 0; i < (int) text.length(); )
+    {
+        Uint16 ch = nextCharacter( text, i );
+        characters.push_back( ch < ' ' ? ' ' : ch );
+    }
+
+    int count = (int) characters.size();
+    if  ( count == 0 )
+    {
+        return;
+    }
+
+    //  Grow the gap if it is too small
+    if  ( mGapEnd - mGapStart < count )
+    {
+        int     tail    = (int) mBuffer.size() - mGapEnd;
+        int     size    = SDL_max( (int) mBuffer.size() * 2, getLength() + count + 64 );
+        mBuffer.resize( size );
+        std::copy_backward( mBuffer.begin() + mGapEnd, mBuffer.begin() + mGapEnd + tail, mBuffer.end() );
+        mGapEnd = size - tail;
+    }
+
+    //  Fill the gap
+    int cursor = mGapStart;
+    std::copy( characters.begin(), characters.end(), mBuffer.begin() + mGapStart );
+    mGapStart += count;
+
+    //  Only the text from the cursor on moves
+    mOffsets.insert( mOffsets.begin() + cursor + 1, count, 0 );
+    layout( cursor );
+}
+
+void    LTextInput::erase   ( bool forward )
+{
+    if  ( forward ? mGapEnd == (int) mBuffer.size() : mGapStart == 0 )
+    {
+        return;
+    }
+
+    //  Widen the gap over the character
+    if  ( forward )
+    {
+        ++mGapEnd;
+    }
+    else
+    {
+        --mGapStart;
+    }
+
+    mOffsets.erase( mOffsets.begin() + mGapStart + 1 );
+    layout( mGapStart );
+}
+
+void    LTextInput::moveCursor  ( int delta )
+{
+    setCursor( mGapStart + delta );
+}
+
+void    LTextInput::setCursor   ( int position )
+{
+    moveGap( SDL_clamp( position, 0, getLength() ) );
+}
+
+std::string LTextInput::getText()
+{
+    std::string text;
+    for ( int i = 0; i < getLength(); ++i )
+    {
+        appendCharacter( text, getCharacter( i ) );
+    }
+
+    return text;
+}
+
+int     LTextInput::getLength()
+{
+    return (int) mBuffer.size() - ( mGapEnd - mGapStart );
+}
+
+int     LTextInput::getWidth()
+{
+    return mOffsets.back();
+}
+
+void    LTextInput::render  ( int x, int y, int width, SDL_Color color )
+{
+    if  ( mGlyphs == NULL )
+    {
+        return;
+    }
+
+    //  Center text that fits, otherwise keep the cursor in the box
+    int cursorX = mOffsets[ mGapStart ];
+    if  ( getWidth() <= width )
+    {
+        mScroll = -( width - getWidth() ) / 2;
+    }
+    else
+    {
+        mScroll = SDL_clamp( mScroll, cursorX - width + 1, cursorX );
+        mScroll = SDL_clamp( mScroll, 0, getWidth() - width );
+    }
+
+    //  Find the visible characters
+    int first = (int)( std::upper_bound( mOffsets.begin(), mOffsets.end() - 1, SDL_max( mScroll, 0 ) ) - mOffsets.begin() ) - 1;
+    first = SDL_max( first, 0 );
+
+    std::string visible;
+    int         last = first;
+    for ( ; last < getLength() && mOffsets[ last ] < mScroll + width; ++last )
+    {
+        appendCharacter( visible, getCharacter( last ) );
+    }
+
+    //  Draw them, and the cursor
+    mGlyphs->renderText( x + mOffsets[ first ] - mScroll, y, visible, color );
+
+    SDL_SetRenderDrawColor( gRenderer, color.r, color.g, color.b, color.a );
+    SDL_RenderDrawLine(
+        gRenderer                           ,
+        x + cursorX - mScroll               ,
+        y                                   ,
+        x + cursorX - mScroll               ,
+        y + mGlyphs->getLineHeight() - 1
+    );
+}
+
+void    LTextInput::moveGap ( int position )
+{
+    //  Shift the characters between the old and new gap across it
+    if  ( position < mGapStart )
+    {
+        int count = mGapStart - position;
+        std::copy_backward( mBuffer.begin() + position, mBuffer.begin() + mGapStart, mBuffer.begin() + mGapEnd );
+        mGapStart   -= count;
+        mGapEnd     -= count;
+    }
+    else if ( position > mGapStart )
+    {
+        int count = position - mGapStart;
+        std::copy( mBuffer.begin() + mGapEnd, mBuffer.begin() + mGapEnd + count, mBuffer.begin() + mGapStart );
+        mGapStart   += count;
+        mGapEnd     += count;
+    }
+}
+
+Uint16  LTextInput::getCharacter    ( int position )
+{
+    return mBuffer[ position < mGapStart ? position : position + mGapEnd - mGapStart ];
+}
+
+void    LTextInput::layout  ( int from )
+{
+    if  ( mGlyphs == NULL )
+    {
+        return;
+    }
+
+    //  The kerning before the first changed character changes too
+    int length = getLength();
+    for ( int i = SDL_max( from - 1, 0 ); i < length; ++i )
+    {
+        Uint16 ch   = getCharacter( i );
+        int    next = i + 1 < length ? mGlyphs->getKerning( ch, getCharacter( i + 1 ) ) : 0;
+        mOffsets[ i + 1 ] = mOffsets[ i ] + mGlyphs->getAdvance( ch ) + next;
+    }
+}
+
 bool init()
 {
 	//  Initialization flag
@@ -326,6 +578,14 @@ bool loadMedia()
 			printf( "Failed to render prompt text!\n" );
 			success = false;
 		}
+
+		//  Cache the glyphs of the input text
+		if  ( !gInputGlyphs.init( gRenderer, gFont ) )
+		{
+			printf( "Failed to create glyph atlas!\n" );
+			success = false;
+		}
+		gInputText.setGlyphs( &gInputGlyphs );
 	}
 
 	return success;
@@ -335,7 +595,7 @@ void close()
 {
 	//  Free loaded images
 	gPromptTextTexture.free();
-	 gInputTextTexture.free();
+	gInputGlyphs.free();
 
 	//  Free global font
 	TTF_CloseFont( gFont );
@@ -379,8 +639,7 @@ int main( int, char* [] )
 			SDL_Color textColor = { 0, 0, 0, 0xFF };
 
 			//  The current input text.
-			std::string inputText = "Some Text";
-			gInputTextTexture.loadFromRenderedText( inputText.c_str(), textColor );
+			gInputText.insert( "Some Text" );
 
 			//  Enable text input
 			SDL_StartTextInput();
@@ -388,9 +647,6 @@ int main( int, char* [] )
 			//  While application is running
 			while ( !quit )
 			{
-				//  The rerender text flag
-				bool renderText = false;
-
 				//  Handle events on queue
 				while ( SDL_PollEvent( &e ) != 0 )
 				{
@@ -402,23 +658,44 @@ int main( int, char* [] )
 					//  Special key input
 					else if ( e.type == SDL_KEYDOWN )
 					{
-						//  Handle backspace
-						if  ( e.key.keysym.sym == SDLK_BACKSPACE && inputText.length() > 0 )
+						//  Handle backspace and delete
+						if  ( e.key.keysym.sym == SDLK_BACKSPACE )
 						{
 							//  lop off character
-							inputText.pop_back();
-							renderText = true;
+							gInputText.erase();
+						}
+						else if ( e.key.keysym.sym == SDLK_DELETE )
+						{
+							gInputText.erase( true );
+						}
+						//  Handle cursor movement
+						else if ( e.key.keysym.sym == SDLK_LEFT )
+						{
+							gInputText.moveCursor( -1 );
+						}
+						else if ( e.key.keysym.sym == SDLK_RIGHT )
+						{
+							gInputText.moveCursor( 1 );
+						}
+						else if ( e.key.keysym.sym == SDLK_HOME )
+						{
+							gInputText.setCursor( 0 );
+						}
+						else if ( e.key.keysym.sym == SDLK_END )
+						{
+							gInputText.setCursor( gInputText.getLength() );
 						}
 						//  Handle copy
 						else if ( e.key.keysym.sym == SDLK_c && SDL_GetModState() & KMOD_CTRL )
 						{
-							SDL_SetClipboardText( inputText.c_str() );
+							SDL_SetClipboardText( gInputText.getText().c_str() );
 						}
-						//  Handle paste
+						//  Handle paste at the cursor
 						else if ( e.key.keysym.sym == SDLK_v && SDL_GetModState() & KMOD_CTRL )
 						{
-							 inputText = SDL_GetClipboardText();
-							renderText = true;
+							char* clipboard = SDL_GetClipboardText();
+							gInputText.insert( clipboard );
+							SDL_free( clipboard );
 						}
 					}
 					//  Special text input event
@@ -437,37 +714,19 @@ int main( int, char* [] )
                                 )
                             )
 						{
-							//  Append character
-							 inputText += e.text.text;
-							renderText  = true;
+							//  Insert character
+							gInputText.insert( e.text.text );
 						}
 					}
 				}
 
-				//  Rerender text if needed
-				if  ( renderText )
-				{
-					//  Text is not empty
-					if  ( inputText != "" )
-					{
-						//  Render new text
-						gInputTextTexture.loadFromRenderedText( inputText.c_str(), textColor );
-					}
-					//  Text is empty
-					else
-					{
-						//  Render space texture
-						gInputTextTexture.loadFromRenderedText( " ", textColor );
-					}
-				}
-
 				//  Clear screen
 				SDL_SetRenderDrawColor  ( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 				SDL_RenderClear         ( gRenderer );
 
-				//  Render text textures
+				//  Render text, only the visible part of the input
 				gPromptTextTexture.render( ( SCREEN_WIDTH - gPromptTextTexture.getWidth() ) / 2, 0 );
-				 gInputTextTexture.render( ( SCREEN_WIDTH -  gInputTextTexture.getWidth() ) / 2, gPromptTextTexture.getHeight() );
+				gInputText.render( 0, gPromptTextTexture.getHeight(), SCREEN_WIDTH, textColor );
 
 				//  Update screen
 				SDL_RenderPresent( gRenderer );
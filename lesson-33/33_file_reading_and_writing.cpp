@@ -1,13 +1,15 @@
 /*	This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.*/
 
-//	Using SDL, SDL_image, SDL_ttf, standard IO, strings, and string streams
+//	Using SDL, SDL_image, SDL_ttf, standard IO, strings, string streams, lists, and hash maps
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
 #include <string>
 #include <sstream>
+#include <list>
+#include <unordered_map>
 
 //	Screen dimension constants
 const int SCREEN_WIDTH	= 640;
@@ -16,6 +18,9 @@ const int SCREEN_HEIGHT = 480;
 //	Number of data integers
 const int TOTAL_DATA	= 10;
 
+//	Bytes of unused text textures kept for reuse
+const size_t TEXT_CACHE_BUDGET = 256 * 1024;
+
 //	Texture wrapper class
 class LTexture
 {
@@ -30,7 +35,8 @@ class LTexture
 		bool loadFromFile( std::string path );
 		
 		#if defined(SDL_TTF_MAJOR_VERSION)
-		//	Creates image from font string
+		//	Creates image from font string, shared through the text cache,
+		//	so color, alpha and blending changes apply to every user
 		bool loadFromRenderedText( std::string textureText, SDL_Color textColor );
 		#endif
 
@@ -60,6 +66,74 @@ class LTexture
 		//	Image dimensions
 		int mWidth;
 		int mHeight;
+
+		//	Whether the texture belongs to the text cache
+		bool mCached;
+};
+
+//	How rendered text is rasterized
+enum LTextMode
+{
+	TEXT_MODE_SOLID,
+	TEXT_MODE_BLENDED
+};
+
+//	Least recently used cache of rendered text textures
+class LTextCache
+{
+	public:
+		//	Initializes variables
+		LTextCache();
+
+		//	Deallocates memory
+		~LTextCache();
+
+		//	Gets the texture for the string, rendering it only on a miss,
+		//	the texture stays cached until every user has released it
+		SDL_Texture* acquire( TTF_Font* font, std::string text, SDL_Color color, LTextMode mode, int* w, int* h );
+
+		//	Gives back a texture from acquire
+		void release( SDL_Texture* texture );
+
+		//	Sets how many bytes of unused textures may stay cached
+		void setBudget( size_t bytes );
+
+		//	Deallocates every texture
+		void free();
+
+		//	Gets statistics
+		int		getHits();
+		int		getMisses();
+		size_t	getBytes();
+
+	private:
+		//	A rendered string
+		struct Entry
+		{
+			std::string		key;
+			SDL_Texture*	texture;
+			int				width, height;
+			size_t			bytes;
+			int				users;
+		};
+
+		//	Destroys unused textures, oldest first, until under budget
+		void trim();
+
+		//	Entries, most recently used first
+		std::list<Entry>	mEntries;
+
+		//	Entries by key and by texture
+		std::unordered_map<std::string, std::list<Entry>::iterator>		mByKey;
+		std::unordered_map<SDL_Texture*, std::list<Entry>::iterator>	mByTexture;
+
+		//	Memory used and allowed
+		size_t	mBytes;
+		size_t	mBudget;
+
+		//	Statistics
+		int		mHits;
+		int		mMisses;
 };
 
 //	Starts up SDL and creates window
@@ -80,6 +154,9 @@ SDL_Renderer*	gRenderer	= NULL;
 //Globally used font
 TTF_Font*		gFont		= NULL;
 
+//	Rendered text textures
+LTextCache gTextCache;
+
 //	Scene textures
 LTexture gPromptTextTexture;
 LTexture gDataTextures[ TOTAL_DATA ];
@@ -93,6 +170,7 @@ LTexture::LTexture()
 	mTexture= NULL;
 	mWidth	= 0;
 	mHeight = 0;
+	mCached	= false;
 }
 
 LTexture::~LTexture()
@@ -148,30 +226,9 @@ bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColo
 	//	Get rid of preexisting texture
 	free();
 
-	//	Render text surface
-	SDL_Surface* textSurface = TTF_RenderText_Solid( gFont, textureText.c_str(), textColor );
-	if	( textSurface != NULL )
-	{
-		//	Create texture from surface pixels
-        mTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
-		if	( mTexture == NULL )
-		{
-			printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
-		}
-		else
-		{
-			//	Get image dimensions
-			mWidth	= textSurface->w;
-			mHeight = textSurface->h;
-		}
-
-		//	Get rid of old surface
-		SDL_FreeSurface( textSurface );
-	}
-	else
-	{
-		printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
-	}
+	//	Repeated strings come from the cache
+	mTexture = gTextCache.acquire( gFont, textureText, textColor, TEXT_MODE_SOLID, &mWidth, &mHeight );
+	mCached	 = mTexture != NULL;
 
 	//	Return success
 	return mTexture != NULL;
@@ -183,8 +240,17 @@ void LTexture::free()
 	//	Free texture if it exists
 	if	( mTexture != NULL )
 	{
-		SDL_DestroyTexture( mTexture );
+		//	Cached textures are only given back
+		if	( mCached )
+		{
+			gTextCache.release( mTexture );
+		}
+		else
+		{
+			SDL_DestroyTexture( mTexture );
+		}
 		mTexture= NULL;
+		mCached	= false;
 		mWidth	= 0;
 		mHeight = 0;
 	}
@@ -234,6 +300,157 @@ int LTexture::getHeight()
 	return mHeight;
 }
 
+LTextCache::LTextCache()
+{
+	//	Initialize
+	mBytes	= 0;
+	mBudget	= TEXT_CACHE_BUDGET;
+	mHits	= 0;
+	mMisses	= 0;
+}
+
+LTextCache::~LTextCache()
+{
+	//	Deallocate
+	free();
+}
+
+SDL_Texture* LTextCache::acquire( TTF_Font* font, std::string text, SDL_Color color, LTextMode mode, int* w, int* h )
+{
+	//	Same font, color, mode and text give the same texture
+	char prefix[ 64 ];
+	SDL_snprintf(
+		prefix					,
+		sizeof( prefix )		,
+		"%p:%02x%02x%02x%02x:%d:",
+		(void*) font			,
+		color.r, color.g, color.b, color.a,
+		(int) mode
+	);
+	std::string key = prefix + text;
+
+	std::unordered_map<std::string, std::list<Entry>::iterator>::iterator found = mByKey.find( key );
+	if	( found != mByKey.end() )
+	{
+		//	Move it to the front
+		++mHits;
+		mEntries.splice( mEntries.begin(), mEntries, found->second );
+	}
+	else
+	{
+		//	Render text surface
+		++mMisses;
+		SDL_Surface* textSurface =
+			mode == TEXT_MODE_SOLID	?
+				TTF_RenderText_Solid	( font, text.c_str(), color ) :
+				TTF_RenderText_Blended	( font, text.c_str(), color );
+		if	( textSurface == NULL )
+		{
+			printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
+			return NULL;
+		}
+
+		//	Create texture from surface pixels
+		SDL_Texture* texture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
+		if	( texture == NULL )
+		{
+			printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
+			SDL_FreeSurface( textSurface );
+			return NULL;
+		}
+
+		//	Size in video memory
+		Uint32 format = SDL_PIXELFORMAT_UNKNOWN;
+		SDL_QueryTexture( texture, &format, NULL, NULL, NULL );
+
+		Entry entry;
+		entry.key		= key;
+		entry.texture	= texture;
+		entry.width		= textSurface->w;
+		entry.height	= textSurface->h;
+		entry.bytes		= (size_t) entry.width * entry.height * SDL_max( (int) SDL_BYTESPERPIXEL( format ), 1 );
+		entry.users		= 0;
+		SDL_FreeSurface( textSurface );
+
+		mEntries.push_front( entry );
+		mByKey[ key ]			= mEntries.begin();
+		mByTexture[ texture ]	= mEntries.begin();
+		mBytes += entry.bytes;
+	}
+
+	Entry& entry = mEntries.front();
+	++entry.users;
+	*w = entry.width;
+	*h = entry.height;
+
+	//	Make room for it
+	trim();
+
+	return entry.texture;
+}
+
+void LTextCache::release( SDL_Texture* texture )
+{
+	std::unordered_map<SDL_Texture*, std::list<Entry>::iterator>::iterator found = mByTexture.find( texture );
+	if	( found != mByTexture.end() && found->second->users > 0 )
+	{
+		--found->second->users;
+		trim();
+	}
+}
+
+void LTextCache::setBudget( size_t bytes )
+{
+	mBudget = bytes;
+	trim();
+}
+
+void LTextCache::trim()
+{
+	//	Walk from the least recently used end, textures in use stay
+	std::list<Entry>::iterator entry = mEntries.end();
+	while	( mBytes > mBudget && entry != mEntries.begin() )
+	{
+		--entry;
+		if	( entry->users == 0 )
+		{
+			mBytes -= entry->bytes;
+			mByKey.erase( entry->key );
+			mByTexture.erase( entry->texture );
+			SDL_DestroyTexture( entry->texture );
+			entry = mEntries.erase( entry );
+		}
+	}
+}
+
+void LTextCache::free()
+{
+	//	Destroy every texture
+	for	( Entry& entry : mEntries )
+	{
+		SDL_DestroyTexture( entry.texture );
+	}
+	mEntries.clear();
+	mByKey.clear();
+	mByTexture.clear();
+	mBytes = 0;
+}
+
+int		LTextCache::getHits()
+{
+	return mHits;
+}
+
+int		LTextCache::getMisses()
+{
+	return mMisses;
+}
+
+size_t	LTextCache::getBytes()
+{
+	return mBytes;
+}
+
 bool init()
 {
 	//	Initialization flag
@@ -427,6 +644,10 @@ void close()
 		gDataTextures[ i ].free();
 	}
 
+	//	Free rendered text
+	printf( "Text cache: %d hits, %d misses\n", gTextCache.getHits(), gTextCache.getMisses() );
+	gTextCache.free();
+
 	//	Free global font
 	TTF_CloseFont( gFont );
 	gFont = NULL;
@@ -1,13 +1,18 @@
 /*  This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.    */
 
-//  Using SDL, SDL_image, SDL_ttf, standard IO, strings, and string streams
+//  Using SDL, SDL_image, SDL_ttf, standard IO, math, strings, string streams, vectors, ring buffers, resamplers and spectra
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
+#include <math.h>
 #include <string>
 #include <sstream>
+#include <vector>
+#include "../share/LRingBuffer.h"
+#include "../share/LResampler.h"
+#include "../share/LSpectrum.h"
 
 //  Screen dimension constants
 const int SCREEN_WIDTH	= 640;
@@ -16,11 +21,40 @@ const int SCREEN_HEIGHT = 480;
 //  Maximum number of supported recording devices
 const int MAX_RECORDING_DEVICES = 10;
 
-//  Maximum recording time
-const int MAX_RECORDING_SECONDS = 5;
+//  Audio the rings between the callbacks and the main loop can hold
+const int RING_BUFFER_SECONDS = 1;
 
-//  Maximum recording time plus padding
-const int RECORDING_BUFFER_SECONDS = MAX_RECORDING_SECONDS + 1;
+//  File recordings are streamed to
+const char* RECORDING_FILE = "./recording.wav";
+
+//  Size of the WAV header before the samples
+const int WAV_HEADER_BYTES = 44;
+
+//  Bytes the WAV writer gathers before each write
+const int WAV_WRITE_BYTES = 256 * 1024;
+
+//  Buffer sizes the latency measurement tries, smallest first
+const Uint16 LATENCY_BUFFER_SIZES[] = { 128, 256, 512, 1024, 2048, 4096 };
+
+//  Seconds each size is measured for and callbacks left out while the devices fill
+const int LATENCY_SECONDS       = 4;
+const int LATENCY_WARMUP_CALLS  = 8;
+
+//  Time between clicks, their length and the level that counts as hearing one
+const double    CLICK_INTERVAL_SECONDS  = 0.5;
+const int       CLICK_FRAMES            = 32;
+const float     CLICK_THRESHOLD         = 0.25f;
+
+//  Conversion benchmark length and the frames handed over at a time
+const int BENCH_SECONDS         = 10;
+const int BENCH_PIECE_FRAMES    = 1024;
+
+//  Spectrum bars and level meters while recording
+const int SPECTRUM_MARGIN   = 20;
+const int SPECTRUM_BOTTOM   = 380;
+const int SPECTRUM_HEIGHT   = 300;
+const int METER_TOP         = 400;
+const int METER_HEIGHT      = 24;
 
 //  The various recording actions we can take
 enum RecordingState
@@ -79,6 +113,77 @@ class LTexture
 		int mHeight;
 };
 
+//  Appends audio from a ring to a WAV file on its own thread
+class LWavWriter
+{
+	public:
+		//  Initializes internals
+		LWavWriter();
+
+		//  Stops writing
+		~LWavWriter();
+
+		//  Creates the file and starts the thread that empties the ring into it
+		bool start( std::string path, const SDL_AudioSpec& spec, LRingBuffer* ring );
+
+		//  Writes what is left in the ring, completes the header and closes the file
+		bool stop();
+
+		//  Gets the bytes of audio written so far
+		Uint32 getDataBytes();
+
+	private:
+		//  Empties the ring into the file until stopped
+		static int writer( void* data );
+
+		//  Writes the gathered bytes and brings the header up to date
+		void flush();
+
+		//  Writes the header for the bytes written so far
+		bool writeHeader();
+
+		//  The file and its format
+		SDL_RWops*      mFile;
+		SDL_AudioSpec   mSpec;
+
+		//  The ring being emptied and the thread doing it
+		LRingBuffer*        mRing;
+		SDL_Thread*         mThread;
+		std::atomic<bool>   mQuit;
+
+		//  Bytes gathered for the next write
+		std::vector<Uint8>  mBuffer;
+		Uint32              mBuffered;
+
+		//  Bytes written and the most a WAV file can hold
+		std::atomic<Uint32> mDataBytes;
+		Uint32              mMaxBytes;
+
+		//  A write failed or the file is full
+		bool    mFailed;
+		bool    mFull;
+};
+
+//  How regularly an audio callback is called
+struct LCallbackTiming
+{
+	//  Starts over
+	void reset();
+
+	//  Notes a call for frames at frequency, made at now
+	void note( Uint64 now, int frames, int frequency );
+
+	//  When the last call was made and how many there were
+	Uint64  last;
+	int     calls;
+
+	//  Furthest a call was from a buffer after the one before, in seconds
+	double  worstJitter;
+
+	//  Calls more than half a buffer late, the device likely ran dry
+	int     late;
+};
+
 //  Starts up SDL and creates window
 bool init();
 
@@ -92,6 +197,40 @@ void close();
 void audioRecordingCallback( void* userdata, Uint8* stream, int len );
 void  audioPlaybackCallback( void* userdata, Uint8* stream, int len );
 
+//  Opens the recording and fills the playback ring
+bool openPlayback();
+
+//  Tops up the playback ring, returns false once everything has played
+bool feedPlayback();
+
+//  Closes the recording
+void closePlayback();
+
+//  Starts a new recording file, its analysis and the recording device,
+//	returns the state to go on to
+RecordingState startRecording( SDL_AudioDeviceID recordingDeviceId );
+
+//  Latency measurement callbacks
+void latencyRecordingCallback( void* userdata, Uint8* stream, int len );
+void  latencyPlaybackCallback( void* userdata, Uint8* stream, int len );
+
+//  Plays clicks with every buffer size, times how long they take to come
+//	back through recording and recommends the smallest size that kept up
+void measureLatency( bool simulatedLoopback );
+
+//  Times converting between sample rates with SDL_AudioStream
+//	and with the resampler at each quality
+void benchmarkConversion();
+
+//  Times analyzing the spectrum of 48 kHz stereo
+void benchmarkSpectrum();
+
+//  Draws the latest spectrum and levels of the recording
+void renderSpectrum();
+
+//  Gets the pixels of size a level in dB covers
+int levelToPixels( float level, int size );
+
 //  The window we'll be rendering to
 SDL_Window*     gWindow     = NULL;
 
@@ -115,17 +254,50 @@ int gRecordingDeviceCount = 0;
 SDL_AudioSpec   gReceivedRecordingSpec;
 SDL_AudioSpec   gReceivedPlaybackSpec;
 
-//  Recording data buffer
-Uint8*  gRecordingBuffer        = NULL;
-
-//  Size of data buffer
-Uint32  gBufferByteSize         = 0;
-
-//  Position in data buffer
-Uint32  gBufferBytePosition     = 0;
-
-//  Maximum position in data buffer for recording
-Uint32  gBufferByteMaxPosition  = 0;
+//  Rings from the recording callback and to the playback callback
+LRingBuffer gRecordingRing;
+LRingBuffer gPlaybackRing;
+
+//  Streams the recording ring to disk
+LWavWriter  gWavWriter;
+
+//  Analyzes a second copy of what is recorded
+LRingBuffer         gAnalyzerRing;
+LSpectrumAnalyzer   gSpectrum;
+
+//  Recording being played back, the bytes of it left to send and
+//	whether the converter's last frames were sent after them
+SDL_RWops*  gPlaybackFile       = NULL;
+Uint32      gPlaybackRemaining  = 0;
+bool        gPlaybackFlushed    = true;
+
+//  Converts the recording to the playback rate, format and channels
+LAudioConverter gPlaybackConverter;
+
+//  Bytes the callbacks dropped on a full ring or padded on an empty one
+std::atomic<Uint32> gOverrunBytes( 0 );
+std::atomic<Uint32> gUnderrunBytes( 0 );
+
+//  Frames per device buffer, 4096 unless measured smaller
+Uint16  gBufferSamples = 4096;
+
+//  Latency measurement format, callback timing and whether playback
+//	is fed straight to recording instead of through the devices
+SDL_AudioSpec   gLatencySpec;
+LCallbackTiming gPlaybackTiming;
+LCallbackTiming gRecordingTiming;
+bool            gSimulatedLoopback  = false;
+LRingBuffer     gLoopbackRing;
+
+//  Clicks played and heard and how long they took. Each is written by one
+//	callback and read by the main thread once the devices are closed
+Uint64              gPlayedFrames   = 0;
+std::atomic<Uint64> gClickTime( 0 );
+int                 gClicksSent     = 0;
+int                 gClicksHeard    = 0;
+double              gTotalTrip      = 0.0;
+double              gWorstTrip      = 0.0;
+Uint64              gDeafUntil      = 0;
 
 LTexture::LTexture()
 {
@@ -277,6 +449,201 @@ int LTexture::getHeight()
 	return mHeight;
 }
 
+LWavWriter::LWavWriter()
+{
+	//  Initialize
+	mFile       = NULL;
+	mRing       = NULL;
+	mThread     = NULL;
+	mQuit       = false;
+	mBuffered   = 0;
+	mDataBytes  = 0;
+	mMaxBytes   = 0;
+	mFailed     = false;
+	mFull       = false;
+	SDL_zero( mSpec );
+}
+
+LWavWriter::~LWavWriter()
+{
+	stop();
+}
+
+bool LWavWriter::start( std::string path, const SDL_AudioSpec& spec, LRingBuffer* ring )
+{
+	//  Finish any previous file
+	stop();
+
+	//  Open file for writing in binary
+	mFile = SDL_RWFromFile( path.c_str(), "wb" );
+	if  ( mFile == NULL )
+	{
+		printf( "Unable to create %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+		return false;
+	}
+
+	//  WAV sizes are 32 bit, stop at the last whole sample frame that fits
+	Uint32 blockAlign = spec.channels * ( SDL_AUDIO_BITSIZE( spec.format ) / 8 );
+	mSpec       = spec;
+	mRing       = ring;
+	mQuit       = false;
+	mBuffered   = 0;
+	mDataBytes  = 0;
+	mMaxBytes   = ( 0xFFFFFFFF - ( WAV_HEADER_BYTES - 8 ) ) / blockAlign * blockAlign;
+	mFailed     = false;
+	mFull       = false;
+	mBuffer.resize( WAV_WRITE_BYTES );
+
+	//  Write an empty header, then start the writer
+	if  ( !writeHeader() )
+	{
+		printf( "Unable to write %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+		SDL_RWclose( mFile );
+		mFile = NULL;
+		return false;
+	}
+	mThread = SDL_CreateThread( writer, "WAV writer", this );
+	if  ( mThread == NULL )
+	{
+		printf( "Unable to create writer thread! SDL Error: %s\n", SDL_GetError() );
+		SDL_RWclose( mFile );
+		mFile = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+bool LWavWriter::stop()
+{
+	if  ( mFile == NULL )
+	{
+		return false;
+	}
+
+	//  Let the writer empty the ring and finish
+	mQuit.store( true, std::memory_order_release );
+	SDL_WaitThread( mThread, NULL );
+	mThread = NULL;
+
+	if  ( mFull )
+	{
+		printf( "Recording reached the WAV size limit and was cut short!\n" );
+	}
+	if  ( mFailed )
+	{
+		printf( "Unable to write recording! SDL Error: %s\n", SDL_GetError() );
+	}
+
+	//  Close file handler
+	bool success = SDL_RWclose( mFile ) == 0 && !mFailed;
+	mFile = NULL;
+
+	//  Keep only a small buffer between recordings
+	std::vector<Uint8>().swap( mBuffer );
+
+	return success;
+}
+
+Uint32 LWavWriter::getDataBytes()
+{
+	return mDataBytes.load( std::memory_order_relaxed );
+}
+
+int LWavWriter::writer( void* data )
+{
+	LWavWriter* wav = (LWavWriter*) data;
+
+	while   ( true )
+	{
+		//  Check before reading, so a read after the stop gets everything
+		bool quit = wav->mQuit.load( std::memory_order_acquire );
+
+		//  Gather what the callback has captured
+		wav->mBuffered += wav->mRing->read( &wav->mBuffer[ wav->mBuffered ], WAV_WRITE_BYTES - wav->mBuffered );
+
+		//  Write in large blocks
+		if  ( wav->mBuffered == (Uint32) WAV_WRITE_BYTES )
+		{
+			wav->flush();
+		}
+		//  The ring is empty and nothing more is coming
+		else if ( quit )
+		{
+			wav->flush();
+			break;
+		}
+		//  Wait for more
+		else
+		{
+			SDL_Delay( 10 );
+		}
+	}
+
+	return 0;
+}
+
+void LWavWriter::flush()
+{
+	//  Write what fits, the rest is dropped once the file is full
+	Uint32 bytes = SDL_min( mBuffered, mMaxBytes - mDataBytes );
+	if  ( bytes < mBuffered )
+	{
+		mFull = true;
+	}
+	mBuffered = 0;
+
+	if  ( mFailed || bytes == 0 )
+	{
+		return;
+	}
+
+	if  ( SDL_RWwrite( mFile, &mBuffer[ 0 ], bytes, 1 ) != 1 )
+	{
+		mFailed = true;
+		return;
+	}
+	mDataBytes.fetch_add( bytes, std::memory_order_relaxed );
+
+	//  Keep the header current, so the file plays even if we never get to stop
+	if  ( !writeHeader() )
+	{
+		mFailed = true;
+	}
+}
+
+bool LWavWriter::writeHeader()
+{
+	Uint32  dataBytes   = mDataBytes.load( std::memory_order_relaxed );
+	Uint16  bits        = SDL_AUDIO_BITSIZE( mSpec.format );
+	Uint16  blockAlign  = mSpec.channels * ( bits / 8 );
+
+	return
+        SDL_RWseek( mFile, 0, RW_SEEK_SET ) == 0                                &&
+
+        //  RIFF chunk holding everything after its size
+        SDL_RWwrite( mFile, "RIFF", 4, 1 ) == 1                                 &&
+        SDL_WriteLE32( mFile, WAV_HEADER_BYTES - 8 + dataBytes ) == 1           &&
+        SDL_RWwrite( mFile, "WAVE", 4, 1 ) == 1                                 &&
+
+        //  Format chunk, 3 for floating point samples and 1 for integers
+        SDL_RWwrite( mFile, "fmt ", 4, 1 ) == 1                                 &&
+        SDL_WriteLE32( mFile, 16 ) == 1                                         &&
+        SDL_WriteLE16( mFile, SDL_AUDIO_ISFLOAT( mSpec.format ) ? 3 : 1 ) == 1  &&
+        SDL_WriteLE16( mFile, mSpec.channels ) == 1                             &&
+        SDL_WriteLE32( mFile, mSpec.freq ) == 1                                 &&
+        SDL_WriteLE32( mFile, mSpec.freq * blockAlign ) == 1                    &&
+        SDL_WriteLE16( mFile, blockAlign ) == 1                                 &&
+        SDL_WriteLE16( mFile, bits ) == 1                                       &&
+
+        //  Data chunk, the samples follow
+        SDL_RWwrite( mFile, "data", 4, 1 ) == 1                                 &&
+        SDL_WriteLE32( mFile, dataBytes ) == 1                                  &&
+
+        //  Carry on appending
+        SDL_RWseek( mFile, 0, RW_SEEK_END ) >= 0;
+}
+
 bool init()
 {
 	//  Initialization flag
@@ -425,39 +792,526 @@ void close()
 	gWindow     = NULL;
 	gRenderer   = NULL;
 
-	//  Free playback audio
-	if  ( gRecordingBuffer != NULL )
-	{
-		delete[] gRecordingBuffer;
-		gRecordingBuffer = NULL;
-	}
+	//  Report what the callbacks could not keep up with
+	printf( "Audio dropped: %u bytes, silence padded: %u bytes\n", gOverrunBytes.load(), gUnderrunBytes.load() );
+
+	//  Finish any recording and playback
+	gWavWriter.stop();
+	gSpectrum.stop();
+	closePlayback();
 
 	//  Quit SDL subsystems
 	TTF_Quit();
 	IMG_Quit();
 	SDL_Quit();
+
+	//  Free audio once the callbacks are gone
+	gRecordingRing.free();
+	gPlaybackRing.free();
+	gAnalyzerRing.free();
 }
 
 void audioRecordingCallback( void* /*userdata*/, Uint8* stream, int len )
 {
-	//  Copy audio from stream
-	memcpy( &gRecordingBuffer[ gBufferBytePosition ], stream, len );
+	//  Copy audio from stream, dropping what does not fit
+	Uint32 written = gRecordingRing.write( stream, len );
+	if  ( written < (Uint32) len )
+	{
+		gOverrunBytes.fetch_add( len - written, std::memory_order_relaxed );
+	}
 
-	//  Move along buffer
-	gBufferBytePosition += len;
+	//  The analyzer only sees what fits, it is not worth dropping the recording for
+	gAnalyzerRing.write( stream, len );
 }
 
 void audioPlaybackCallback( void* /*userdata*/, Uint8* stream, int len )
 {
-	//  Copy audio to stream
-	memcpy( stream, &gRecordingBuffer[ gBufferBytePosition ], len );
+	//  Copy audio to stream, silence where there is none
+	Uint32 read = gPlaybackRing.read( stream, len );
+	if  ( read < (Uint32) len )
+	{
+		memset( stream + read, gReceivedPlaybackSpec.silence, len - read );
+		gUnderrunBytes.fetch_add( len - read, std::memory_order_relaxed );
+	}
+}
+
+bool openPlayback()
+{
+	//  Open the recording, skipping its header
+	gPlaybackFile = SDL_RWFromFile( RECORDING_FILE, "rb" );
+	if  ( gPlaybackFile == NULL || SDL_RWseek( gPlaybackFile, WAV_HEADER_BYTES, RW_SEEK_SET ) < 0 )
+	{
+		printf( "Unable to open %s! SDL Error: %s\n", RECORDING_FILE, SDL_GetError() );
+		closePlayback();
+		return false;
+	}
+	gPlaybackRemaining = gWavWriter.getDataBytes();
+
+	//  The devices may have settled on different specs
+	if  ( !gPlaybackConverter.init( gReceivedRecordingSpec, gReceivedPlaybackSpec, RESAMPLER_HIGH ) )
+	{
+		closePlayback();
+		return false;
+	}
+
+	//  Fill the ring before the callback starts
+	gPlaybackRing.reset();
+	gPlaybackFlushed = false;
+	feedPlayback();
+
+	return true;
+}
+
+bool feedPlayback()
+{
+	//  Read as much of the rest of the recording as fits once converted, a piece at a time
+	Uint8 piece[ 16 * 1024 ];
+	Uint8 converted[ 64 * 1024 ];
+	while   ( gPlaybackRemaining > 0 )
+	{
+		Uint32 room     = SDL_min( gPlaybackRing.getWritable(), (Uint32) sizeof( converted ) );
+		Uint32 bytes    = SDL_min( SDL_min( (Uint32) sizeof( piece ), (Uint32) gPlaybackConverter.getMaxInputBytes( room ) ), gPlaybackRemaining );
+		if  ( bytes == 0 )
+		{
+			break;
+		}
+		if  ( SDL_RWread( gPlaybackFile, piece, bytes, 1 ) != 1 )
+		{
+			printf( "Unable to read %s! SDL Error: %s\n", RECORDING_FILE, SDL_GetError() );
+			gPlaybackRemaining = 0;
+			break;
+		}
+		gPlaybackRing.write( converted, gPlaybackConverter.convert( piece, bytes, converted ) );
+		gPlaybackRemaining -= bytes;
+	}
+
+	//  Then the frames the filter still holds, once they fit
+	if  ( gPlaybackRemaining == 0 && !gPlaybackFlushed && gPlaybackRing.getWritable() >= (Uint32) gPlaybackConverter.getMaxFlushBytes() )
+	{
+		gPlaybackRing.write( converted, gPlaybackConverter.flush( converted ) );
+		gPlaybackFlushed = true;
+	}
+
+	//  Done when all of it is sent and played
+	return gPlaybackRemaining > 0 || !gPlaybackFlushed || gPlaybackRing.getReadable() > 0;
+}
+
+void closePlayback()
+{
+	if  ( gPlaybackFile != NULL )
+	{
+		SDL_RWclose( gPlaybackFile );
+		gPlaybackFile = NULL;
+	}
+	gPlaybackRemaining  = 0;
+	gPlaybackFlushed    = true;
+}
+
+RecordingState startRecording( SDL_AudioDeviceID recordingDeviceId )
+{
+	//  Start a new recording file and its analysis
+	gRecordingRing.reset();
+	gAnalyzerRing.reset();
+	if  ( !gWavWriter.start( RECORDING_FILE, gReceivedRecordingSpec, &gRecordingRing ) )
+	{
+		gPromptTexture.loadFromRenderedText( "Failed to create recording file!", gTextColor );
+		return ERROR;
+	}
+
+	//  Analyze only once there is a recording to analyze
+	gSpectrum.start( gReceivedRecordingSpec, &gAnalyzerRing );
+
+	//  Start recording
+	SDL_PauseAudioDevice( recordingDeviceId, SDL_FALSE );
+
+	//  Go on to next state
+	gPromptTexture.loadFromRenderedText( "Recording... Press 1 to stop.", gTextColor );
+	return RECORDING;
+}
+
+void LCallbackTiming::reset()
+{
+	last        = 0;
+	calls       = 0;
+	worstJitter = 0.0;
+	late        = 0;
+}
+
+void LCallbackTiming::note( Uint64 now, int frames, int frequency )
+{
+	//  The first calls fill the device, only time the steady state
+	if  ( last != 0 && ++calls > LATENCY_WARMUP_CALLS )
+	{
+		double period   = (double) frames / frequency;
+		double interval = (double)( now - last ) / SDL_GetPerformanceFrequency();
+
+		worstJitter = SDL_max( worstJitter, fabs( interval - period ) );
+		if  ( interval > period * 1.5 )
+		{
+			++late;
+		}
+	}
+	last = now;
+}
+
+void latencyPlaybackCallback( void* /*userdata*/, Uint8* stream, int len )
+{
+	Uint64  now     = SDL_GetPerformanceCounter();
+	float*  samples = (float*) stream;
+	int     frames  = len / sizeof( float );
+	double  ticks   = (double) SDL_GetPerformanceFrequency() / gLatencySpec.freq;
+
+	gPlaybackTiming.note( now, frames, gLatencySpec.freq );
+
+	//  Silence with a short click every interval
+	memset( stream, 0, len );
+	int interval = (int)( gLatencySpec.freq * CLICK_INTERVAL_SECONDS );
+	for ( int i = 0; i < frames; ++i )
+	{
+		Uint64 frame = gPlayedFrames + i;
+		if  ( frame % interval < (Uint64) CLICK_FRAMES )
+		{
+			samples[ i ] = 1.0f;
+
+			//  When the click's first frame is due, relative to this call
+			if  ( frame % interval == 0 )
+			{
+				gClickTime.store( now + (Uint64)( i * ticks ), std::memory_order_release );
+				++gClicksSent;
+			}
+		}
+	}
+	gPlayedFrames += frames;
+
+	//  Send it straight to the recording side when simulating loopback
+	if  ( gSimulatedLoopback )
+	{
+		gLoopbackRing.write( stream, len );
+	}
+}
+
+void latencyRecordingCallback( void* /*userdata*/, Uint8* stream, int len )
+{
+	Uint64  now     = SDL_GetPerformanceCounter();
+	float*  samples = (float*) stream;
+	int     frames  = len / sizeof( float );
+	double  ticks   = (double) SDL_GetPerformanceFrequency() / gLatencySpec.freq;
+
+	gRecordingTiming.note( now, frames, gLatencySpec.freq );
+
+	//  Hear what was played instead of the device when simulating loopback
+	if  ( gSimulatedLoopback )
+	{
+		Uint32 read = gLoopbackRing.read( stream, len );
+		memset( stream + read, 0, len - read );
+	}
+
+	for ( int i = 0; i < frames; ++i )
+	{
+		//  The last frame was captured just before this call
+		Uint64 heard = now - (Uint64)( ( frames - i ) * ticks );
+		if  ( fabsf( samples[ i ] ) < CLICK_THRESHOLD || heard < gDeafUntil )
+		{
+			continue;
+		}
+
+		//  Pair it with the last click sent and ignore the rest of it
+		Uint64 sent = gClickTime.load( std::memory_order_acquire );
+		if  ( sent != 0 )
+		{
+			double trip = heard > sent ? (double)( heard - sent ) / SDL_GetPerformanceFrequency() : 0.0;
+			gTotalTrip += trip;
+			gWorstTrip = SDL_max( gWorstTrip, trip );
+			++gClicksHeard;
+		}
+		gDeafUntil = heard + (Uint64)( gLatencySpec.freq * CLICK_INTERVAL_SECONDS / 2 * ticks );
+	}
+}
+
+void measureLatency( bool simulatedLoopback )
+{
+	gSimulatedLoopback = simulatedLoopback;
+	printf(
+        "%8s %10s %10s %8s %12s %12s %6s\n"                         ,
+        "samples", "buffer ms", "trip ms", "heard", "worst ms", "jitter ms", "late"
+    );
+
+	Uint16 smallestStable = 0;
+	for ( Uint16 samples : LATENCY_BUFFER_SIZES )
+	{
+		//  Mono float both ways, SDL converts for the devices
+		SDL_AudioSpec desired;
+		SDL_zero( desired );
+		desired.freq        = 44100;
+		desired.format      = AUDIO_F32;
+		desired.channels    = 1;
+		desired.samples     = samples;
+
+		//  Start over
+		gPlayedFrames   = 0;
+		gClickTime      = 0;
+		gClicksSent     = 0;
+		gClicksHeard    = 0;
+		gTotalTrip      = 0.0;
+		gWorstTrip      = 0.0;
+		gDeafUntil      = 0;
+		gPlaybackTiming.reset();
+		gRecordingTiming.reset();
+		gLoopbackRing.allocate( desired.freq * sizeof( float ) );
+
+		//  Open both ends
+		desired.callback = latencyRecordingCallback;
+		SDL_AudioDeviceID recordingDeviceId = SDL_OpenAudioDevice( NULL, SDL_TRUE, &desired, &gLatencySpec, 0 );
+		desired.callback = latencyPlaybackCallback;
+		SDL_AudioDeviceID playbackDeviceId  = SDL_OpenAudioDevice( NULL, SDL_FALSE, &desired, &gLatencySpec, 0 );
+		if  ( recordingDeviceId == 0 || playbackDeviceId == 0 )
+		{
+			printf( "Unable to open audio devices with %d samples! SDL Error: %s\n", samples, SDL_GetError() );
+			SDL_CloseAudioDevice( recordingDeviceId );
+			SDL_CloseAudioDevice( playbackDeviceId );
+			continue;
+		}
+
+		//  Run both, keeping the window responsive
+		SDL_PauseAudioDevice( recordingDeviceId, SDL_FALSE );
+		SDL_PauseAudioDevice( playbackDeviceId, SDL_FALSE );
+		Uint32 end = SDL_GetTicks() + LATENCY_SECONDS * 1000;
+		while   ( !SDL_TICKS_PASSED( SDL_GetTicks(), end ) )
+		{
+			SDL_PumpEvents();
+			SDL_Delay( 10 );
+		}
+
+		//  Closing waits for the callbacks, their results are safe to read after
+		SDL_CloseAudioDevice( recordingDeviceId );
+		SDL_CloseAudioDevice( playbackDeviceId );
+
+		//  Stable when every click but one still in flight came back and playback never ran dry
+		int     sent    = gClicksSent;
+		bool    stable  = sent > 1 && gClicksHeard >= sent - 1 && gPlaybackTiming.late == 0;
+		if  ( stable && smallestStable == 0 )
+		{
+			smallestStable = samples;
+		}
+
+		printf(
+            "%8d %10.1f %10.1f %5d/%-2d %12.1f %12.2f %6d%s\n"          ,
+            samples                                                     ,
+            samples * 1000.0 / desired.freq                             ,
+            gClicksHeard > 0 ? gTotalTrip * 1000.0 / gClicksHeard : 0.0 ,
+            gClicksHeard, sent                                          ,
+            gWorstTrip * 1000.0                                         ,
+            SDL_max( gPlaybackTiming.worstJitter, gRecordingTiming.worstJitter ) * 1000.0,
+            gPlaybackTiming.late + gRecordingTiming.late                ,
+            stable ? "" : "  unstable"
+        );
+	}
+	gLoopbackRing.free();
+
+	if  ( smallestStable != 0 )
+	{
+		printf( "Smallest stable buffer: %d samples, run with --samples %d\n", smallestStable, smallestStable );
+	}
+	else
+	{
+		printf( "No buffer size was stable%s\n", gSimulatedLoopback ? "!" : ", is the output audible to the input? Try --loopback." );
+	}
+}
+
+void benchmarkConversion()
+{
+	//  Common rate changes, 16 bit stereo in and float stereo out
+	const int   RATES[][ 2 ]        = { { 44100, 48000 }, { 48000, 44100 }, { 48000, 16000 }, { 22050, 96000 } };
+	const char* QUALITY_NAMES[]     = { "low", "medium", "high" };
+
+	printf( "%-16s %-18s %10s %12s\n", "rates", "converter", "ms", "x realtime" );
+	for ( const int* rates : RATES )
+	{
+		SDL_AudioSpec from, to;
+		SDL_zero( from );
+		SDL_zero( to );
+		from.freq       = rates[ 0 ];
+		from.format     = AUDIO_S16SYS;
+		from.channels   = 2;
+		to.freq         = rates[ 1 ];
+		to.format       = AUDIO_F32SYS;
+		to.channels     = 2;
+
+		//  A sweep through the audible range
+		std::vector<Sint16> source( BENCH_SECONDS * from.freq * 2 );
+		double phase = 0.0;
+		for ( size_t i = 0; i < source.size() / 2; ++i )
+		{
+			phase += 2.0 * M_PI * ( 20.0 + 20000.0 * i / ( source.size() / 2 ) ) / from.freq;
+			source[ i * 2 ] = source[ i * 2 + 1 ] = (Sint16)( 16000 * sin( phase ) );
+		}
+		std::vector<Uint8> output( ( BENCH_SECONDS + 1 ) * to.freq * 2 * sizeof( float ) );
+
+		char name[ 32 ];
+		SDL_snprintf( name, sizeof( name ), "%d > %d", rates[ 0 ], rates[ 1 ] );
+		int pieceBytes = BENCH_PIECE_FRAMES * 2 * sizeof( Sint16 );
+		int totalBytes = (int)( source.size() * sizeof( Sint16 ) );
+
+		//  SDL's own, put a piece and take what came out
+		SDL_AudioStream* stream = SDL_NewAudioStream( from.format, from.channels, from.freq, to.format, to.channels, to.freq );
+		if  ( stream == NULL )
+		{
+			printf( "Unable to create audio stream! SDL Error: %s\n", SDL_GetError() );
+			return;
+		}
+		Uint64 start = SDL_GetPerformanceCounter();
+		int written = 0;
+		for ( int done = 0; done < totalBytes; done += pieceBytes )
+		{
+			SDL_AudioStreamPut( stream, (Uint8*) source.data() + done, SDL_min( pieceBytes, totalBytes - done ) );
+			written += SDL_AudioStreamGet( stream, output.data() + written, (int) output.size() - written );
+		}
+		SDL_AudioStreamFlush( stream );
+		written += SDL_AudioStreamGet( stream, output.data() + written, (int) output.size() - written );
+		double ms = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency();
+		SDL_FreeAudioStream( stream );
+		printf( "%-16s %-18s %10.1f %12.0f\n", name, "SDL_AudioStream", ms, BENCH_SECONDS * 1000.0 / ms );
+
+		//  Then the resampler at each quality
+		for ( int quality = RESAMPLER_LOW; quality <= RESAMPLER_HIGH; ++quality )
+		{
+			LAudioConverter converter;
+			if  ( !converter.init( from, to, (LResamplerQuality) quality ) )
+			{
+				return;
+			}
+			start   = SDL_GetPerformanceCounter();
+			written = 0;
+			for ( int done = 0; done < totalBytes; done += pieceBytes )
+			{
+				written += converter.convert( (Uint8*) source.data() + done, SDL_min( pieceBytes, totalBytes - done ), output.data() + written );
+			}
+			ms = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency();
+
+			char label[ 32 ];
+			SDL_snprintf( label, sizeof( label ), "LResampler %s", QUALITY_NAMES[ quality ] );
+			printf( "%-16s %-18s %10.1f %12.0f\n", "", label, ms, BENCH_SECONDS * 1000.0 / ms );
+		}
+	}
+}
+
+void benchmarkSpectrum()
+{
+	//  48 kHz stereo float, a tone in each channel over a little noise
+	SDL_AudioSpec spec;
+	SDL_zero( spec );
+	spec.freq       = 48000;
+	spec.format     = AUDIO_F32SYS;
+	spec.channels   = 2;
+
+	LSpectrumAnalyzer analyzer;
+	if  ( !analyzer.init( spec ) )
+	{
+		return;
+	}
+
+	int frames = BENCH_SECONDS * spec.freq;
+	std::vector<float> samples( frames * 2 );
+	for ( int i = 0; i < frames; ++i )
+	{
+		float noise = ( rand() / (float) RAND_MAX - 0.5f ) * 0.01f;
+		samples[ i * 2 ]        = 0.5f * (float) sin( 2.0 * M_PI * 1000.0 * i / spec.freq ) + noise;
+		samples[ i * 2 + 1 ]    = 0.5f * (float) sin( 2.0 * M_PI * 5000.0 * i / spec.freq ) + noise;
+	}
+
+	//  A device buffer at a time, as the thread gets it
+	Uint64 start = SDL_GetPerformanceCounter();
+	for ( int done = 0; done < frames; done += BENCH_PIECE_FRAMES )
+	{
+		analyzer.analyze( &samples[ done * 2 ], SDL_min( BENCH_PIECE_FRAMES, frames - done ) );
+	}
+	double ms = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency();
+
+	printf( "Spectrum of %d s of 48 kHz stereo: %.1f ms, %.3f%% of one core\n", BENCH_SECONDS, ms, ms / ( BENCH_SECONDS * 10.0 ) );
+}
+
+void renderSpectrum()
+{
+	LSpectrumFrame frame;
+	if  ( !gSpectrum.getFrame( &frame ) )
+	{
+		return;
+	}
+
+	//  A bar per band from the louder channel
+	int barWidth = ( SCREEN_WIDTH - 2 * SPECTRUM_MARGIN ) / SPECTRUM_BANDS;
+	SDL_SetRenderDrawColor( gRenderer, 0x00, 0x80, 0xFF, 0xFF );
+	for ( int band = 0; band < SPECTRUM_BANDS; ++band )
+	{
+		float level = frame.bands[ 0 ][ band ];
+		for ( int c = 1; c < frame.channels; ++c )
+		{
+			level = SDL_max( level, frame.bands[ c ][ band ] );
+		}
+
+		int height = levelToPixels( level, SPECTRUM_HEIGHT );
+		SDL_Rect fillRect = { SPECTRUM_MARGIN + band * barWidth, SPECTRUM_BOTTOM - height, barWidth - 2, height };
+		SDL_RenderFillRect( gRenderer, &fillRect );
+	}
+
+	//  A meter per channel, RMS filled and the peak as a line, red once anything clipped
+	int width = SCREEN_WIDTH - 2 * SPECTRUM_MARGIN;
+	for ( int c = 0; c < frame.channels; ++c )
+	{
+		int y = METER_TOP + c * ( METER_HEIGHT + 4 );
+
+		SDL_Rect fillRect = { SPECTRUM_MARGIN, y, levelToPixels( frame.rms[ c ], width ), METER_HEIGHT };
+		if  ( frame.clipped > 0 )
+		{
+			SDL_SetRenderDrawColor( gRenderer, 0xFF, 0x00, 0x00, 0xFF );
+		}
+		else
+		{
+			SDL_SetRenderDrawColor( gRenderer, 0x00, 0xC0, 0x00, 0xFF );
+		}
+		SDL_RenderFillRect( gRenderer, &fillRect );
 
-	//  Move along buffer
-	gBufferBytePosition += len;
+		SDL_Rect outlineRect = { SPECTRUM_MARGIN, y, width, METER_HEIGHT };
+		SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0xFF );
+		SDL_RenderDrawRect( gRenderer, &outlineRect );
+
+		int peak = SPECTRUM_MARGIN + levelToPixels( frame.peak[ c ], width );
+		SDL_RenderDrawLine( gRenderer, peak, y, peak, y + METER_HEIGHT - 1 );
+	}
 }
 
-int main( int /*argc*/, char* /*argv*/[] )
+int levelToPixels( float level, int size )
 {
+	return (int)( ( level - SPECTRUM_MIN_DB ) / -SPECTRUM_MIN_DB * size );
+}
+
+int main( int argc, char* args[] )
+{
+	//  Read the options
+	bool latency    = false;
+	bool loopback   = false;
+	bool bench      = false;
+	for ( int i = 1; i < argc; ++i )
+	{
+		std::string option = args[ i ];
+		if  ( option == "--latency" )
+		{
+			latency = true;
+		}
+		else if ( option == "--loopback" )
+		{
+			loopback = true;
+		}
+		else if ( option == "--bench" )
+		{
+			bench = true;
+		}
+		else if ( option == "--samples" && i + 1 < argc )
+		{
+			gBufferSamples = (Uint16) SDL_clamp( SDL_atoi( args[ ++i ] ), 64, 8192 );
+		}
+	}
+
 	//  Start up SDL and create window
 	if  ( !init() )
 	{
@@ -470,6 +1324,17 @@ int main( int /*argc*/, char* /*argv*/[] )
 		{
 			printf( "Failed to load media!\n" );
 		}
+		//  Measure latency instead of running the demo
+		else if ( latency )
+		{
+			measureLatency( loopback );
+		}
+		//  Time conversion instead of running the demo
+		else if ( bench )
+		{
+			benchmarkConversion();
+			benchmarkSpectrum();
+		}
 		else
 		{	
 			//  Main loop flag
@@ -521,7 +1386,7 @@ int main( int /*argc*/, char* /*argv*/[] )
 										desiredRecordingSpec.freq       = 44100;
 										desiredRecordingSpec.format     = AUDIO_F32;
 										desiredRecordingSpec.channels   = 2;
-										desiredRecordingSpec.samples    = 4096;
+										desiredRecordingSpec.samples    = gBufferSamples;
 										desiredRecordingSpec.callback   = audioRecordingCallback;
 
 										//  Open recording device
@@ -531,7 +1396,7 @@ int main( int /*argc*/, char* /*argv*/[] )
                                                 SDL_TRUE                                        ,
                                                   &desiredRecordingSpec                         ,
                                                 &gReceivedRecordingSpec                         ,
-                                                SDL_AUDIO_ALLOW_FORMAT_CHANGE
+                                                SDL_AUDIO_ALLOW_ANY_CHANGE
                                             );
 										
 										//  Device failed to open
@@ -551,7 +1416,7 @@ int main( int /*argc*/, char* /*argv*/[] )
 											desiredPlaybackSpec.freq        = 44100;
 											desiredPlaybackSpec.format      = AUDIO_F32;
 											desiredPlaybackSpec.channels    = 2;
-											desiredPlaybackSpec.samples     = 4096;
+											desiredPlaybackSpec.samples     = gBufferSamples;
 											desiredPlaybackSpec.callback    = audioPlaybackCallback;
 
 											//  Open playback device
@@ -561,7 +1426,7 @@ int main( int /*argc*/, char* /*argv*/[] )
                                                     SDL_FALSE                   ,
                                                       &desiredPlaybackSpec      ,
                                                     &gReceivedPlaybackSpec      ,
-                                                    SDL_AUDIO_ALLOW_FORMAT_CHANGE
+                                                    SDL_AUDIO_ALLOW_ANY_CHANGE
                                                 );
 
 											//  Device failed to open
@@ -585,19 +1450,28 @@ int main( int /*argc*/, char* /*argv*/[] )
                                                     gReceivedRecordingSpec.freq     *
                                                     bytesPerSample;
 
-												//  Calculate buffer size
-												gBufferByteSize = RECORDING_BUFFER_SECONDS * bytesPerSecond;
-
-												//  Calculate max buffer use
-												gBufferByteMaxPosition = MAX_RECORDING_SECONDS * bytesPerSecond;
-
-												//  Allocate and initialize byte buffer
-												gRecordingBuffer = new Uint8[ gBufferByteSize ];
-												memset( gRecordingBuffer, 0, gBufferByteSize );
-
-												//  Go on to next state
-												gPromptTexture.loadFromRenderedText("Press 1 to record for 5 seconds.", gTextColor);
-												currentState = STOPPED;
+												//  Playback goes through the converter, sized by its own spec
+												int playbackBytesPerSecond =
+                                                    gReceivedPlaybackSpec.freq      *
+                                                    gReceivedPlaybackSpec.channels  *
+                                                    ( SDL_AUDIO_BITSIZE( gReceivedPlaybackSpec.format ) / 8 );
+
+												//  Allocate the rings, the recording itself grows as it goes
+												if  (
+                                                        !gRecordingRing.allocate( RING_BUFFER_SECONDS * bytesPerSecond )    ||
+                                                        !gAnalyzerRing.allocate( RING_BUFFER_SECONDS * bytesPerSecond )     ||
+                                                        !gPlaybackRing.allocate( RING_BUFFER_SECONDS * playbackBytesPerSecond )
+                                                    )
+												{
+													gPromptTexture.loadFromRenderedText( "Failed to allocate audio buffers!", gTextColor );
+													currentState = ERROR;
+												}
+												else
+												{
+													//  Go on to next state
+													gPromptTexture.loadFromRenderedText( "Press 1 to start recording.", gTextColor );
+													currentState = STOPPED;
+												}
 											}
 										}
 									}
@@ -614,18 +1488,36 @@ int main( int /*argc*/, char* /*argv*/[] )
 								//  Start recording
 								if  ( e.key.keysym.sym == SDLK_1 )
 								{
-									//  Go back to beginning of buffer
-									gBufferBytePosition = 0;
+									currentState = startRecording( recordingDeviceId );
+								}
+							}
+							break;	
 
-									//  Start recording
-									SDL_PauseAudioDevice( recordingDeviceId, SDL_FALSE );
+						//  User is recording
+						case    RECORDING:
+
+							//  On key press
+							if  ( e.type == SDL_KEYDOWN )
+							{
+								//  Stop recording
+								if  ( e.key.keysym.sym == SDLK_1 )
+								{
+									//  Stop recording audio, the callback is done once this returns
+									SDL_PauseAudioDevice( recordingDeviceId, SDL_TRUE );
+
+									//  Write what is left in the ring and finish the file
+									gWavWriter.stop();
+
+									//  Stop analyzing and report what it cost
+									gSpectrum.stop();
+									printf( "Spectrum analyzer load: %.3f%% of one core\n", gSpectrum.getLoad() * 100.0 );
 
 									//  Go on to next state
-									gPromptTexture.loadFromRenderedText( "Recording...", gTextColor );
-									currentState = RECORDING;
+									gPromptTexture.loadFromRenderedText( "Press 1 to play back. Press 2 to record again.", gTextColor );
+									currentState = RECORDED;
 								}
 							}
-							break;	
+							break;
 
 						//  User has finished recording
 						case    RECORDED:
@@ -636,79 +1528,50 @@ int main( int /*argc*/, char* /*argv*/[] )
 								//  Start playback
 								if  ( e.key.keysym.sym == SDLK_1 )
 								{
-									//  Go back to beginning of buffer
-									gBufferBytePosition = 0;
-
-									//  Start playback
-									SDL_PauseAudioDevice( playbackDeviceId, SDL_FALSE );
+									//  Go back to beginning of recording
+									if  ( !openPlayback() )
+									{
+										gPromptTexture.loadFromRenderedText( "Failed to open recording file!", gTextColor );
+										currentState = ERROR;
+									}
+									else
+									{
+										//  Start playback
+										SDL_PauseAudioDevice( playbackDeviceId, SDL_FALSE );
 
-									//  Go on to next state
-									gPromptTexture.loadFromRenderedText( "Playing...", gTextColor );
-									currentState = PLAYBACK;
+										//  Go on to next state
+										gPromptTexture.loadFromRenderedText( "Playing...", gTextColor );
+										currentState = PLAYBACK;
+									}
 								}
 								//  Record again
 								if  ( e.key.keysym.sym == SDLK_2 )
 								{
-									//  Reset the buffer
-									gBufferBytePosition = 0;
-									memset( gRecordingBuffer, 0, gBufferByteSize );
-
-									//  Start recording
-									SDL_PauseAudioDevice( recordingDeviceId, SDL_FALSE );
-
-									//  Go on to next state
-									gPromptTexture.loadFromRenderedText( "Recording...", gTextColor );
-									currentState = RECORDING;
+									currentState = startRecording( recordingDeviceId );
 								}
 							}
 							break;
 
                         case    PLAYBACK:
-                        case    RECORDING:
                         case    ERROR:
                                 break;
 					}
 				}
 
-				//  Updating recording
-				if  ( currentState == RECORDING )
-				{
-					//  Lock callback
-					SDL_LockAudioDevice( recordingDeviceId );
-
-					//  Finished recording
-					if  ( gBufferBytePosition > gBufferByteMaxPosition )
-					{
-						//  Stop recording audio
-						SDL_PauseAudioDevice( recordingDeviceId, SDL_TRUE );
-
-						//  Go on to next state
-						gPromptTexture.loadFromRenderedText( "Press 1 to play back. Press 2 to record again.", gTextColor );
-						currentState = RECORDED;
-					}
-
-					//  Unlock callback
-					SDL_UnlockAudioDevice( recordingDeviceId );
-				}
-				//  Updating playback
-				else if( currentState == PLAYBACK )
+				//  Updating playback, recording is written out by its own thread
+				if  ( currentState == PLAYBACK )
 				{
-					//  Lock callback
-					SDL_LockAudioDevice( playbackDeviceId );
-
 					//  Finished playback
-					if  ( gBufferBytePosition > gBufferByteMaxPosition )
+					if  ( !feedPlayback() )
 					{
 						//  Stop playing audio
 						SDL_PauseAudioDevice( playbackDeviceId, SDL_TRUE );
+						closePlayback();
 
 						//  Go on to next state
 						gPromptTexture.loadFromRenderedText( "Press 1 to play back. Press 2 to record again.", gTextColor );
 						currentState = RECORDED;
 					}
-
-					//  Unlock callback
-					SDL_UnlockAudioDevice( playbackDeviceId );
 				}
 
 				//  Clear screen
@@ -729,6 +1592,11 @@ int main( int /*argc*/, char* /*argv*/[] )
 						yOffset += gDeviceTextures[ i ].getHeight() + 1;
 					}
 				}
+				//  User is recording
+				else if ( currentState == RECORDING )
+				{
+					renderSpectrum();
+				}
 
 				//  Update screen
 				SDL_RenderPresent( gRenderer );
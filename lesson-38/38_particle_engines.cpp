@@ -1,11 +1,18 @@
 /*  This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.*/
 
-//  Using SDL, SDL_image, standard IO, and strings
+//  Using SDL, SDL_image, standard IO, C strings, math, strings, vectors, and algorithms
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <string>
+#include <vector>
+#include <algorithm>
+
+//  Using the shared quad indices
+#include "../share/LQuadIndices.h"
 
 //  Screen dimension constants
 const int SCREEN_WIDTH  = 640;
@@ -51,6 +58,9 @@ class LTexture
 		int getWidth();
 		int getHeight();
 
+		//  Gets the hardware texture
+		SDL_Texture* getTexture();
+
 	private:
 		//  The actual hardware texture
 		SDL_Texture*    mTexture;
@@ -60,6 +70,63 @@ class LTexture
 		int mHeight;
 };
 
+//  Collects textured quads and submits them with SDL_RenderGeometry
+class LSpriteBatch
+{
+	public:
+		//  Initializes variables
+		LSpriteBatch();
+
+		//  Queues a sprite, same parameters as LTexture::render plus a layer.
+		//  Lower layers are drawn first, inside a layer sprites are grouped
+		//  by blend mode and texture
+		void draw(
+                LTexture*           texture         ,
+                float               x               ,
+                float               y               ,
+                SDL_Rect*           clip    = NULL  ,
+                double              angle   = 0.0   ,
+                SDL_FPoint*         center  = NULL  ,
+                SDL_RendererFlip    flip    = SDL_FLIP_NONE ,
+                int                 layer   = 0
+            );
+
+		//  Sets the color and alpha applied to the following sprites
+		void setColor( Uint8 red, Uint8 green, Uint8 blue, Uint8 alpha = 0xFF );
+
+		//  Sorts the queued sprites and renders them
+		void flush();
+
+		//  Gets the number of geometry calls issued by the last flush
+		int getCallCount();
+
+	private:
+		//  One queued sprite
+		struct Sprite
+		{
+			int             layer;
+			SDL_BlendMode   blend;
+			SDL_Texture*    texture;
+			int             quad;
+		};
+
+		//  Queued sprites and their vertices, four per sprite
+		std::vector<Sprite>     mSprites;
+		std::vector<SDL_Vertex> mVertices;
+
+		//  Vertices reordered for submission
+		std::vector<SDL_Vertex> mSorted;
+
+		//  Two triangles per quad, shared by every submission
+		std::vector<int>        mIndices;
+
+		//  Current sprite color
+		SDL_Color   mColor;
+
+		//  Geometry calls made by the last flush
+		int         mCalls;
+};
+
 class Particle
 {
 	public:
@@ -130,6 +197,9 @@ bool init();
 //  Loads media
 bool loadMedia();
 
+//  Times per-call rendering against the sprite batch
+void benchmark();
+
 //  Frees media and shuts down SDL
 void close();
 
@@ -146,6 +216,9 @@ LTexture    gGreenTexture;
 LTexture    gBlueTexture;
 LTexture    gShimmerTexture;
 
+//  Batch the particles are drawn through
+LSpriteBatch    gSpriteBatch;
+
 LTexture::LTexture()
 {
 	//  Initialize
@@ -297,6 +370,175 @@ int LTexture::getHeight()
 	return mHeight;
 }
 
+SDL_Texture* LTexture::getTexture()
+{
+	return mTexture;
+}
+
+LSpriteBatch::LSpriteBatch()
+{
+	//  Initialize
+	mColor  = { 0xFF, 0xFF, 0xFF, 0xFF };
+	mCalls  = 0;
+}
+
+void LSpriteBatch::draw( LTexture* texture, float x, float y, SDL_Rect* clip, double angle, SDL_FPoint* center, SDL_RendererFlip flip, int layer )
+{
+	SDL_Texture*    hwTexture = texture->getTexture();
+	if  ( hwTexture == NULL )
+	{
+		return;
+	}
+
+	//  Source rectangle in texels
+	SDL_Rect    src = { 0, 0, texture->getWidth(), texture->getHeight() };
+	if  ( clip != NULL )
+	{
+		src = *clip;
+	}
+
+	//  Texture coordinates, swapped when flipped
+	float   u0 = (float) src.x             / texture->getWidth();
+	float   v0 = (float) src.y             / texture->getHeight();
+	float   u1 = (float)( src.x + src.w )  / texture->getWidth();
+	float   v1 = (float)( src.y + src.h )  / texture->getHeight();
+
+	if  ( flip & SDL_FLIP_HORIZONTAL )
+	{
+		std::swap( u0, u1 );
+	}
+	if  ( flip & SDL_FLIP_VERTICAL )
+	{
+		std::swap( v0, v1 );
+	}
+
+	//  Rotation center defaults to the middle of the quad like SDL_RenderCopyEx
+	float   cx = src.w / 2.f;
+	float   cy = src.h / 2.f;
+	if  ( center != NULL )
+	{
+		cx = center->x;
+		cy = center->y;
+	}
+
+	//  Corners relative to the rotation center
+	float   dx[ 4 ] = { -cx, src.w - cx, src.w - cx, -cx };
+	float   dy[ 4 ] = { -cy, -cy, src.h - cy, src.h - cy };
+	float   u [ 4 ] = { u0, u1, u1, u0 };
+	float   v [ 4 ] = { v0, v0, v1, v1 };
+
+	//  Rotate on the CPU, clockwise in degrees like SDL_RenderCopyEx
+	float   c = 1.f, s = 0.f;
+	if  ( angle != 0.0 )
+	{
+		c = (float) cos( angle * M_PI / 180.0 );
+		s = (float) sin( angle * M_PI / 180.0 );
+	}
+
+	//  Bake the texture modulation into the vertex color
+	Uint8           r, g, b, a;
+	SDL_BlendMode   blend;
+	SDL_GetTextureColorMod  ( hwTexture, &r, &g, &b );
+	SDL_GetTextureAlphaMod  ( hwTexture, &a );
+	SDL_GetTextureBlendMode ( hwTexture, &blend );
+
+	SDL_Color   color = {
+                    (Uint8)( r * mColor.r / 255 )   ,
+                    (Uint8)( g * mColor.g / 255 )   ,
+                    (Uint8)( b * mColor.b / 255 )   ,
+                    (Uint8)( a * mColor.a / 255 )
+                };
+
+	//  Queue the sprite
+	Sprite  sprite = { layer, blend, hwTexture, (int) mSprites.size() };
+	mSprites.push_back( sprite );
+
+	for ( int i = 0; i < 4; ++i )
+	{
+		SDL_Vertex  vertex;
+		vertex.position.x   = x + cx + dx[ i ] * c - dy[ i ] * s;
+		vertex.position.y   = y + cy + dx[ i ] * s + dy[ i ] * c;
+		vertex.color        = color;
+		vertex.tex_coord.x  = u[ i ];
+		vertex.tex_coord.y  = v[ i ];
+		mVertices.push_back( vertex );
+	}
+}
+
+void LSpriteBatch::setColor( Uint8 red, Uint8 green, Uint8 blue, Uint8 alpha )
+{
+	mColor = { red, green, blue, alpha };
+}
+
+void LSpriteBatch::flush()
+{
+	mCalls = 0;
+
+	//  Group by layer, blend mode and texture, keeping submission order
+	std::sort(
+        mSprites.begin(),
+        mSprites.end()  ,
+        []( const Sprite& a, const Sprite& b )
+        {
+            if  ( a.layer   != b.layer   ) return a.layer   < b.layer;
+            if  ( a.blend   != b.blend   ) return a.blend   < b.blend;
+            if  ( a.texture != b.texture ) return std::less<SDL_Texture*>()( a.texture, b.texture );
+            return a.quad < b.quad;
+        }
+    );
+
+	//  Gather vertices in sorted order
+	mSorted.resize( mVertices.size() );
+	for ( int i = 0; i < (int) mSprites.size(); ++i )
+	{
+		memcpy(
+            &mSorted[ i * 4 ]                       ,
+            &mVertices[ mSprites[ i ].quad * 4 ]    ,
+            4 * sizeof( SDL_Vertex )
+        );
+	}
+
+	//  Two triangles per quad
+	growQuadIndices( mIndices, (int) mSprites.size() );
+
+	//  Submit one call per run of matching state
+	int first = 0;
+	while   ( first < (int) mSprites.size() )
+	{
+		int last = first + 1;
+		while   (
+                    last < (int) mSprites.size()                            &&
+                    mSprites[ last ].texture == mSprites[ first ].texture   &&
+                    mSprites[ last ].blend   == mSprites[ first ].blend     &&
+                    mSprites[ last ].layer   == mSprites[ first ].layer
+                )
+		{
+			++last;
+		}
+
+		SDL_RenderGeometry(
+            gRenderer                   ,
+            mSprites[ first ].texture   ,
+            &mSorted[ first * 4 ]       ,
+            ( last - first ) * 4        ,
+            &mIndices[ 0 ]              ,
+            ( last - first ) * 6
+        );
+		++mCalls;
+
+		first = last;
+	}
+
+	//  Start the next batch
+	mSprites.clear();
+	mVertices.clear();
+}
+
+int LSpriteBatch::getCallCount()
+{
+	return mCalls;
+}
+
 Particle::Particle( int x, int y )
 {
     //  Set offsets
@@ -317,13 +559,13 @@ Particle::Particle( int x, int y )
 
 void Particle::render()
 {
-    //  Show image
-	mTexture->render( mPosX, mPosY );
+    //  Queue image
+	gSpriteBatch.draw( mTexture, mPosX, mPosY );
 
-    //  Show shimmer
+    //  Queue shimmer above every particle image
     if  ( mFrame % 2 == 0 )
     {
-		gShimmerTexture.render( mPosX, mPosY );
+		gSpriteBatch.draw( &gShimmerTexture, mPosX, mPosY, NULL, 0.0, NULL, SDL_FLIP_NONE, 1 );
     }
 
     //  Animate
@@ -559,6 +801,79 @@ bool loadMedia()
 	return success;
 }
 
+void benchmark()
+{
+	//  Frames are not capped while timing
+	SDL_RenderSetVSync( gRenderer, 0 );
+
+	//  Sprite counts and frames per measure
+	const int   SPRITE_COUNTS[] = { 10000, 25000, 50000, 100000 };
+	const int   BENCH_FRAMES    = 30;
+
+	//  Textures the sprites are picked from
+	LTexture*   textures[ 4 ] = { &gRedTexture, &gGreenTexture, &gBlueTexture, &gShimmerTexture };
+
+	//  A randomly placed, rotated and flipped sprite
+	struct BenchSprite
+	{
+		int                 x, y;
+		double              angle;
+		SDL_RendererFlip    flip;
+		LTexture*           texture;
+	};
+
+	printf( "%8s %14s %14s %8s\n", "sprites", "per-call ms", "batched ms", "calls" );
+
+	for ( int count : SPRITE_COUNTS )
+	{
+		//  Generate the scene
+		std::vector<BenchSprite> sprites( count );
+		for ( BenchSprite& sprite : sprites )
+		{
+			sprite.x        = rand() % SCREEN_WIDTH;
+			sprite.y        = rand() % SCREEN_HEIGHT;
+			sprite.angle    = rand() % 360;
+			sprite.flip     = (SDL_RendererFlip)( rand() % 3 );
+			sprite.texture  = textures[ rand() % 4 ];
+		}
+
+		//  One SDL_RenderCopyEx per sprite
+		Uint64 start = SDL_GetPerformanceCounter();
+		for ( int frame = 0; frame < BENCH_FRAMES; ++frame )
+		{
+			SDL_SetRenderDrawColor  ( gRenderer, 0x22, 0x22, 0x22, 0xFF );
+			SDL_RenderClear         ( gRenderer );
+
+			for ( BenchSprite& sprite : sprites )
+			{
+				sprite.texture->render( sprite.x, sprite.y, NULL, sprite.angle, NULL, sprite.flip );
+			}
+
+			SDL_RenderPresent( gRenderer );
+		}
+		double perCallMs = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency() / BENCH_FRAMES;
+
+		//  Same scene through the batch
+		start = SDL_GetPerformanceCounter();
+		for ( int frame = 0; frame < BENCH_FRAMES; ++frame )
+		{
+			SDL_SetRenderDrawColor  ( gRenderer, 0x22, 0x22, 0x22, 0xFF );
+			SDL_RenderClear         ( gRenderer );
+
+			for ( BenchSprite& sprite : sprites )
+			{
+				gSpriteBatch.draw( sprite.texture, sprite.x, sprite.y, NULL, sprite.angle, NULL, sprite.flip );
+			}
+			gSpriteBatch.flush();
+
+			SDL_RenderPresent( gRenderer );
+		}
+		double batchedMs = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency() / BENCH_FRAMES;
+
+		printf( "%8d %14.3f %14.3f %8d\n", count, perCallMs, batchedMs, gSpriteBatch.getCallCount() );
+	}
+}
+
 void close()
 {
 	//  Free loaded images
@@ -579,7 +894,7 @@ void close()
 	SDL_Quit();
 }
 
-int main( int /*argc*/, char* /*args*/[] )
+int main( int argc, char* args[] )
 {
 	//  Start up SDL and create window
 	if  ( !init() )
@@ -593,6 +908,11 @@ int main( int /*argc*/, char* /*args*/[] )
 		{
 			printf( "Failed to load media!\n" );
 		}
+		//  Time rendering paths instead of running the demo
+		else if ( argc > 1 && std::string( args[ 1 ] ) == "--bench" )
+		{
+			benchmark();
+		}
 		else
 		{	
 			//  Main loop flag
@@ -629,6 +949,7 @@ int main( int /*argc*/, char* /*args*/[] )
 
 				//  Render objects
 				dot.render();
+				gSpriteBatch.flush();
 
 				//  Update screen
 				SDL_RenderPresent( gRenderer );
@@ -7,6 +7,10 @@ and may not be redistributed without written permission.*/
 #include <stdio.h>
 #include <string>
 
+//  Using the shared pixel kernels and pixel views
+#include "../share/LPixelKernels.h"
+#include "../share/LPixelView.h"
+
 //  Screen dimension constants
 const int SCREEN_WIDTH  = 640;
 const int SCREEN_HEIGHT = 480;
@@ -53,6 +57,7 @@ class LTexture
 		bool unlockTexture();
 		void* getPixels();
 		int getPitch();
+		LPixelView getPixelView();
 
 	private:
 		//  The actual hardware texture
@@ -323,6 +328,12 @@ int LTexture::getPitch()
 	return mPitch;
 }
 
+LPixelView LTexture::getPixelView()
+{
+	//  View over the locked pixels
+	return LPixelView( mPixels, mPitch, mWidth, mHeight );
+}
+
 bool init()
 {
 	//  Initialization flag
@@ -418,21 +429,19 @@ bool loadMedia()
 			SDL_PixelFormat* mappingFormat = SDL_AllocFormat( format );
 
 			//  Get pixel data
-			Uint32* pixels = (Uint32*)gFooTexture.getPixels();
-			int pixelCount = ( gFooTexture.getPitch() / 4 ) * gFooTexture.getHeight();
+			LPixelView pixels = gFooTexture.getPixelView();
 
 			//  Map colors
 			Uint32 colorKey     = SDL_MapRGB ( mappingFormat, 0, 0xFF, 0xFF );
 			Uint32 transparent  = SDL_MapRGBA( mappingFormat, 0xFF, 0xFF, 0xFF, 0x00 );
 
 			//  Color key pixels
-			for ( int i = 0; i < pixelCount; ++i )
-			{
-				if  ( pixels[ i ] == colorKey )
-				{
-					pixels[ i ] = transparent;
-				}
-			}
+			pixels.forEachRow(
+                [&]( std::span<Uint32> row, int /*y*/ )
+                {
+                    colorKeyPixels( row.data(), (int) row.size(), colorKey, transparent );
+                }
+            );
 
 			//  Unlock texture
 			gFooTexture.unlockTexture();
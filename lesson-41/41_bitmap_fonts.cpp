@@ -7,6 +7,15 @@ and may not be redistributed without written permission.    */
 #include <SDL_image.h>
 #include <stdio.h>
 #include <string>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+//  Using the shared pixel kernels, pixel views, UTF-8 decoder and quad indices
+#include "../share/LPixelKernels.h"
+#include "../share/LPixelView.h"
+#include "../share/LUTF8.h"
+#include "../share/LQuadIndices.h"
 
 //  Screen dimension constants
 const int SCREEN_WIDTH  = 640;
@@ -59,12 +68,16 @@ class LTexture
 		int getWidth();
 		int getHeight();
 
+		//  Gets the hardware texture
+		SDL_Texture*    getTexture();
+
 		//Pixel manipulators
 		bool    lockTexture();
 		bool    unlockTexture();
 		void*   getPixels();
 		int     getPitch();
 		Uint32  getPixel32( unsigned int x, unsigned int y );
+		LPixelView  getPixelView();
 
 	private:
 		//  The actual hardware texture
@@ -77,6 +90,29 @@ class LTexture
 		int     mHeight;
 };
 
+//  A string laid out as glyph quads, kept while it does not change
+class LTextRun
+{
+    public:
+		//  Initializes variables
+		LTextRun();
+
+		//  Gets the number of glyphs drawn
+		int getGlyphCount();
+
+    private:
+		friend class LBitmapFont;
+
+		//  What the quads were laid out from
+		std::string mText;
+		int         mX, mY;
+		SDL_Color   mColor;
+		bool        mLaidOut;
+
+		//  Four vertices per glyph, one list per font page
+		std::vector< std::vector<SDL_Vertex> >  mVertices;
+};
+
 //  Our bitmap font
 class LBitmapFont
 {
@@ -84,19 +120,96 @@ class LBitmapFont
 		//  The default constructor
 		LBitmapFont();
 
-		//  Generates the font
-		bool buildFont( LTexture *bitmap );
+		//  Frees loaded pages
+		~LBitmapFont();
+
+		//  Generates the font from a 16x16 grid of Latin-1 characters,
+		//	reusing the metrics cached in cachePath when they were computed
+		//	from the same image
+		bool buildFont( LTexture *bitmap, std::string cachePath = "" );
 
-		//  Shows the text
+		//  Loads a font from an AngelCode BMFont text description,
+		//	with any number of characters, pages and kerning pairs
+		bool loadFont( std::string path );
+
+		//  Frees pages loaded by loadFont
+		void free();
+
+		//  Shows the UTF-8 text
 		void renderText( int x, int y, std::string text );
 
+		//  Shows the text, laying it out again only when it changed
+		void renderText( LTextRun& run, int x, int y, std::string text );
+
+		//  Lays out the text as glyph quads
+		void layoutText( LTextRun& run, int x, int y, std::string text );
+
     private:
-		//  The font texture
-		LTexture*   mBitmap;
+		//  One character of the font
+		struct Glyph
+		{
+			Uint32      codepoint;
+			int         page;
+			SDL_Rect    clip;
+			int         xOffset, yOffset;
+			int         advance;
+		};
+
+		//  Extra spacing between two characters
+		struct Kerning
+		{
+			Uint64      pair;
+			int         amount;
+		};
+
+		//  Sorts the glyph and kerning tables for lookup
+		void indexGlyphs();
+
+		//  Finds a glyph, NULL when the font does not have it
+		const Glyph* findGlyph( Uint32 codepoint );
+
+		//  Gets the kerning between two characters
+		int getKerning( Uint32 first, Uint32 second );
+
+		//  Draws laid out glyphs with one geometry call per page
+		void renderRun( LTextRun& run );
+
+		//  Current color and alpha modulation of the first page
+		SDL_Color getColor();
+
+		//  Scratch run for text that is not cached
+		LTextRun    mScratch;
 
-		//  The individual characters in the surface
+		//  Two triangles per glyph, shared by every run
+		std::vector<int>    mIndices;
+
+		//  Hashes the locked bitmap pixels
+		Uint64 hashBitmap( LPixelView pixels );
+
+		//  Reads cached metrics, fails if they are for another image
+		bool loadMetrics( std::string cachePath, Uint64 hash );
+
+		//  Writes the metrics to the cache
+		void saveMetrics( std::string cachePath, Uint64 hash );
+
+		//  The font textures
+		std::vector<LTexture*>  mPages;
+
+		//  Pages created by loadFont, owned by the font
+		std::vector<LTexture*>  mLoadedPages;
+
+		//  The individual characters in the grid bitmap
 		SDL_Rect    mChars[ 256 ];
 
+		//  Every character sorted by codepoint
+		std::vector<Glyph>      mGlyphs;
+
+		//  Glyph index of the first 256 codepoints, -1 when missing
+		int         mLatin1[ 256 ];
+
+		//  Kerning pairs sorted by pair
+		std::vector<Kerning>    mKerning;
+
 		//  Spacing Variables
 		int         mNewLine, mSpace;
 };
@@ -120,6 +233,13 @@ SDL_Renderer*   gRenderer   = NULL;
 LTexture        gBitmapTexture;
 LBitmapFont     gBitmapFont;
 
+//  The same glyphs as a BMFont description over two pages
+LBitmapFont     gPagedFont;
+
+//  The test texts, laid out once
+LTextRun        gTextRun;
+LTextRun        gPagedRun;
+
 LTexture::LTexture()
 {
 	//  Initialize
@@ -215,8 +335,7 @@ bool LTexture::loadFromFile( std::string path )
 				mHeight = formattedSurface->h;
 
 				//  Get pixel data in editable format
-				Uint32*     pixels      = (Uint32*) mPixels;
-				int         pixelCount  = ( mPitch / 4 ) * mHeight;
+				LPixelView  pixels = getPixelView();
 
 				//  Map colors				
 				Uint32      colorKey    =
@@ -236,13 +355,12 @@ bool LTexture::loadFromFile( std::string path )
                     );
 
 				//  Color key pixels
-				for ( int i = 0; i < pixelCount; ++i )
-				{
-					if  ( pixels[ i ] == colorKey )
-					{
-						pixels[ i ] = transparent;
-					}
-				}
+				pixels.forEachRow(
+                    [&]( std::span<Uint32> row, int /*y*/ )
+                    {
+                        colorKeyPixels( row.data(), (int) row.size(), colorKey, transparent );
+                    }
+                );
 
 				//  Unlock texture to update
 				SDL_UnlockTexture( newTexture );
@@ -386,6 +504,11 @@ int     LTexture::getHeight()
 	return mHeight;
 }
 
+SDL_Texture*    LTexture::getTexture()
+{
+	return mTexture;
+}
+
 bool    LTexture::lockTexture()
 {
 	bool success = true;
@@ -442,22 +565,50 @@ int     LTexture::getPitch()
 
 Uint32  LTexture::getPixel32( unsigned int x, unsigned int y )
 {
-    //  Convert the pixels to 32 bit
-    Uint32 *    pixels = (Uint32*)  mPixels;
-
     //  Get the pixel requested
-    return pixels[ ( y * ( mPitch / 4 ) ) + x ];
+    return getPixelView().at( x, y );
+}
+
+LPixelView LTexture::getPixelView()
+{
+    //  View over the locked pixels
+    return LPixelView( mPixels, mPitch, mWidth, mHeight );
 }
 
         LBitmapFont::LBitmapFont()
 {
     //  Initialize variables
-    mBitmap     = NULL;
     mNewLine    = 0;
     mSpace      = 0;
+
+    for ( int i = 0; i < 256; ++i )
+    {
+        mLatin1[ i ] = -1;
+    }
+}
+
+        LBitmapFont::~LBitmapFont()
+{
+    //  Deallocate
+    free();
+}
+
+void    LBitmapFont::free()
+{
+    //  Free the pages we loaded
+    for ( LTexture* page : mLoadedPages )
+    {
+        page->free();
+        delete page;
+    }
+    mLoadedPages.clear();
+    mPages.clear();
+    mGlyphs.clear();
+    mKerning.clear();
+    indexGlyphs();
 }
 
-bool    LBitmapFont::buildFont  ( LTexture* bitmap )
+bool    LBitmapFont::buildFont  ( LTexture* bitmap, std::string cachePath )
 {
 	bool success = true;
 	
@@ -469,203 +620,583 @@ bool    LBitmapFont::buildFont  ( LTexture* bitmap )
 	}
 	else
 	{
-		//  Set the background color
-		Uint32  bgColor = bitmap->getPixel32( 0, 0 );
-
-		//  Set the cell dimensions
-		int cellW = bitmap->getWidth()  / 16;
-		int cellH = bitmap->getHeight() / 16;
-
-		//  New line variables
-		int top     = cellH;
-		int baseA   = cellH;
-
-		//  The current character we're setting
-		int currentChar = 0;
+		//  Get pixel data
+		LPixelView  pixels = bitmap->getPixelView();
 
-		//  Go through the cell rows
-		for ( int rows = 0; rows < 16; ++rows )
+		//  Skip the scan when the metrics of this image are cached
+		Uint64  hash = hashBitmap( pixels );
+		if  ( cachePath.empty() || !loadMetrics( cachePath, hash ) )
 		{
-			//  Go through the cell columns
-			for ( int cols = 0; cols < 16; ++cols )
-			{
-				//  Set the character offset
-				mChars[ currentChar ].x = cellW * cols;
-				mChars[ currentChar ].y = cellH * rows;
+			//  Set the background color
+			Uint32  bgColor = pixels.at( 0, 0 );
 
-				//Set the dimensions of the character
-				mChars[ currentChar ].w = cellW;
-				mChars[ currentChar ].h = cellH;
+			//  Set the cell dimensions
+			int cellW = bitmap->getWidth()  / 16;
+			int cellH = bitmap->getHeight() / 16;
 
-				//  Find Left Side
-				//  Go through pixel columns
-				for ( int pCol = 0; pCol < cellW; ++pCol )
-				{
-					//  Go through pixel rows
-					for ( int pRow = 0; pRow < cellH; ++pRow )
-					{
-						//  Get the pixel offsets
-						int pX = ( cellW * cols ) + pCol;
-						int pY = ( cellH * rows ) + pRow;
+			//  New line variables
+			int top     = cellH;
+			int baseA   = cellH;
 
-						//  If a non colorkey pixel is found
-						if  ( bitmap->getPixel32( pX, pY ) != bgColor )
-						{
-							//  Set the x offset
-							mChars[ currentChar ].x = pX;
+			//  Columns of the current cell holding a non colorkey pixel
+			std::vector<Uint32> columns( cellW );
 
-							//  Break the loops
-							pCol = cellW;
-							pRow = cellH;
-						}
-					}
-				}
+			//  The current character we're setting
+			int currentChar = 0;
 
-				//  Find Right Side
-				//  Go through pixel columns
-				for ( int pColW = cellW - 1; pColW >= 0; --pColW )
+			//  Go through the cell rows
+			for ( int rows = 0; rows < 16; ++rows )
+			{
+				//  Go through the cell columns
+				for ( int cols = 0; cols < 16; ++cols )
 				{
-					//  Go through pixel rows
-					for ( int pRowW = 0; pRowW < cellH; ++pRowW )
-					{
-						//  Get the pixel offsets
-						int pX = ( cellW * cols ) + pColW;
-						int pY = ( cellH * rows ) + pRowW;
+					//  Set the character offset
+					mChars[ currentChar ].x = cellW * cols;
+					mChars[ currentChar ].y = cellH * rows;
 
-						//  If a non colorkey pixel is found
-						if  ( bitmap->getPixel32( pX, pY ) != bgColor )
-						{
-							//  Set the width
-							mChars[ currentChar ].w =
-                                ( pX - mChars[ currentChar ].x ) + 1;
+					//  Set the dimensions of the character
+					mChars[ currentChar ].w = cellW;
+					mChars[ currentChar ].h = cellH;
 
-							//  Break the loops
-							pColW = -1;
-							pRowW = cellH;
-						}
-					}
-				}
+					//  Scan the cell once, row by row, marking the columns
+					//	and remembering the first and last rows with ink
+					std::fill( columns.begin(), columns.end(), 0 );
+					int firstRow    = -1;
+					int lastRow     = -1;
 
-				//  Find Top
-				//  Go through pixel rows
-				for ( int pRow = 0; pRow < cellH; ++pRow )
-				{
-					//  Go through pixel columns
-					for ( int pCol = 0; pCol < cellW; ++pCol )
+					for ( int pRow = 0; pRow < cellH; ++pRow )
 					{
-						//  Get the pixel offsets
-						int pX = ( cellW * cols ) + pCol;
-						int pY = ( cellH * rows ) + pRow;
+						const Uint32*   row = pixels.getRow( ( cellH * rows ) + pRow ) + ( cellW * cols );
 
-						//  If a non colorkey pixel is found
-						if  ( bitmap->getPixel32( pX, pY ) != bgColor )
+						if  ( markPixelsNotEqual( row, cellW, bgColor, &columns[ 0 ] ) )
 						{
-							//  If new top is found
-							if  ( pRow < top )
+							if  ( firstRow < 0 )
 							{
-								top = pRow;
+								firstRow = pRow;
 							}
-
-							//Break the loops
-							pCol = cellW;
-							pRow = cellH;
+							lastRow = pRow;
 						}
 					}
-				}
 
-				//  Find Bottom of A
-				if  ( currentChar == 'A' )
-				{
-					//  Go through pixel rows
-					for ( int pRow = cellH - 1; pRow >= 0; --pRow )
+					//  Empty cells keep the whole cell
+					if  ( firstRow >= 0 )
 					{
-						//  Go through pixel columns
-						for ( int pCol = 0; pCol < cellW; ++pCol )
+						//  Find Left and Right Sides
+						int left    = 0;
+						int right   = cellW - 1;
+						while   ( columns[ left ]  == 0 ) ++left;
+						while   ( columns[ right ] == 0 ) --right;
+
+						//  Set the x offset and width
+						mChars[ currentChar ].x = ( cellW * cols ) + left;
+						mChars[ currentChar ].w = ( right - left ) + 1;
+
+						//  If new top is found
+						if  ( firstRow < top )
 						{
-							//  Get the pixel offsets
-							int pX = ( cellW * cols ) + pCol;
-							int pY = ( cellH * rows ) + pRow;
-
-							//  If a non colorkey pixel is found
-							if  ( bitmap->getPixel32( pX, pY ) != bgColor )
-							{
-								//  Bottom of a is found
-								baseA = pRow;
+							top = firstRow;
+						}
 
-								//  Break the loops
-								pCol = cellW;
-								pRow = -1;
-							}
+						//  Bottom of A is found
+						if  ( currentChar == 'A' )
+						{
+							baseA = lastRow;
 						}
 					}
+
+					//  Go to the next character
+					++currentChar;
 				}
+			}
 
-				//  Go to the next character
-				++currentChar;
+			//  Calculate space
+			mSpace = cellW / 2;
+
+			//  Calculate new line
+			mNewLine = baseA - top;
+
+			//  Lop off excess top pixels
+			for ( int i = 0; i < 256; ++i )
+			{
+				mChars[ i ].y += top;
+				mChars[ i ].h -= top;
 			}
-		}
 
-		//  Calculate space
-		mSpace = cellW / 2;
+			//  Cache the metrics for the next start
+			if  ( !cachePath.empty() )
+			{
+				saveMetrics( cachePath, hash );
+			}
+		}
 
-		//  Calculate new line
-		mNewLine = baseA - top;
+		bitmap->unlockTexture();
 
-		//  Lop off excess top pixels
+		//  The grid is one page holding the first 256 codepoints
+		free();
+		mPages.push_back( bitmap );
 		for ( int i = 0; i < 256; ++i )
 		{
-			mChars[ i ].y += top;
-			mChars[ i ].h -= top;
+			Glyph glyph = { (Uint32) i, 0, mChars[ i ], 0, 0, mChars[ i ].w + 1 };
+			mGlyphs.push_back( glyph );
 		}
+		indexGlyphs();
+	}
 
-		bitmap->unlockTexture();
-		mBitmap = bitmap;
+	return success;
+}
+
+Uint64  LBitmapFont::hashBitmap ( LPixelView pixels )
+{
+	//  FNV-1a over the dimensions and the visible pixels
+	Uint64  hash = 14695981039346656037ull;
+	hash = ( hash ^ (Uint64) pixels.getWidth()  ) * 1099511628211ull;
+	hash = ( hash ^ (Uint64) pixels.getHeight() ) * 1099511628211ull;
+
+	pixels.forEachRow(
+        [&]( std::span<Uint32> row, int /*y*/ )
+        {
+            for ( Uint32 pixel : row )
+            {
+                hash = ( hash ^ pixel ) * 1099511628211ull;
+            }
+        }
+    );
+
+	return hash;
+}
+
+//  Metrics cache file signature
+const Uint32 FONT_METRICS_MAGIC = 0x3146424C;   //  "LBF1"
+
+bool    LBitmapFont::loadMetrics( std::string cachePath, Uint64 hash )
+{
+	bool success = false;
+
+	//  Open file for reading in binary
+	SDL_RWops*  file = SDL_RWFromFile( cachePath.c_str(), "rb" );
+	if  ( file != NULL )
+	{
+		Uint32  magic       = 0;
+		Uint64  cachedHash  = 0;
+		SDL_RWread( file, &magic,       sizeof( Uint32 ), 1 );
+		SDL_RWread( file, &cachedHash,  sizeof( Uint64 ), 1 );
+
+		//  Only use metrics computed from this image
+		if  ( magic == FONT_METRICS_MAGIC && cachedHash == hash )
+		{
+			SDL_Rect    chars[ 256 ];
+			Sint32      spacing[ 2 ];
+
+			if  (
+                    SDL_RWread( file, chars,   sizeof( chars ),   1 ) == 1 &&
+                    SDL_RWread( file, spacing, sizeof( spacing ), 1 ) == 1
+                )
+			{
+				memcpy( mChars, chars, sizeof( chars ) );
+				mNewLine    = spacing[ 0 ];
+				mSpace      = spacing[ 1 ];
+				success     = true;
+			}
+		}
+
+		//  Close file handler
+		SDL_RWclose( file );
 	}
 
 	return success;
 }
 
+void    LBitmapFont::saveMetrics( std::string cachePath, Uint64 hash )
+{
+	//  Open file for writing in binary
+	SDL_RWops*  file = SDL_RWFromFile( cachePath.c_str(), "wb" );
+	if  ( file == NULL )
+	{
+		printf( "Warning: Unable to save font metrics! SDL Error: %s\n", SDL_GetError() );
+	}
+	else
+	{
+		Sint32  spacing[ 2 ] = { mNewLine, mSpace };
+
+		SDL_RWwrite( file, &FONT_METRICS_MAGIC, sizeof( Uint32 ),   1 );
+		SDL_RWwrite( file, &hash,               sizeof( Uint64 ),   1 );
+		SDL_RWwrite( file, mChars,              sizeof( mChars ),   1 );
+		SDL_RWwrite( file, spacing,             sizeof( spacing ),  1 );
+
+		//  Close file handler
+		SDL_RWclose( file );
+	}
+}
+
+//  Gets the value of key=value in a BMFont line, quotes removed
+static std::string getFontField( const std::string& line, std::string key )
+{
+	size_t start = line.find( " " + key + "=" );
+	if  ( start == std::string::npos )
+	{
+		return "";
+	}
+	start += key.length() + 2;
+
+	//  Quoted values may hold spaces
+	if  ( start < line.length() && line[ start ] == '"' )
+	{
+		size_t end = line.find( '"', start + 1 );
+		return line.substr( start + 1, end == std::string::npos ? std::string::npos : end - start - 1 );
+	}
+
+	return line.substr( start, line.find_first_of( " \r", start ) - start );
+}
+
+bool    LBitmapFont::loadFont   ( std::string path )
+{
+	//  Get rid of the current font
+	free();
+
+	//  Open the description
+	std::ifstream file( path );
+	if  ( file.fail() )
+	{
+		printf( "Unable to load font description %s!\n", path.c_str() );
+		return false;
+	}
+
+	//  Pages are relative to the description
+	std::string folder  = path.substr( 0, path.find_last_of( "/\\" ) + 1 );
+	bool        success = true;
+	std::string line;
+
+	while   ( std::getline( file, line ) )
+	{
+		std::string tag = line.substr( 0, line.find( ' ' ) );
+
+		if  ( tag == "common" )
+		{
+			mNewLine = atoi( getFontField( line, "lineHeight" ).c_str() );
+		}
+		else if ( tag == "page" )
+		{
+			int         id      = atoi( getFontField( line, "id" ).c_str() );
+			LTexture*   page    = new LTexture();
+			mLoadedPages.push_back( page );
+
+			if  ( id < 0 || !page->loadFromFile( folder + getFontField( line, "file" ) ) )
+			{
+				printf( "Unable to load font page %d!\n", id );
+				success = false;
+			}
+			else
+			{
+				if  ( id >= (int) mPages.size() )
+				{
+					mPages.resize( id + 1, NULL );
+				}
+				mPages[ id ] = page;
+			}
+		}
+		else if ( tag == "char" )
+		{
+			Glyph glyph;
+			glyph.codepoint = (Uint32) atol( getFontField( line, "id" ).c_str() );
+			glyph.page      = atoi( getFontField( line, "page"      ).c_str() );
+			glyph.clip.x    = atoi( getFontField( line, "x"         ).c_str() );
+			glyph.clip.y    = atoi( getFontField( line, "y"         ).c_str() );
+			glyph.clip.w    = atoi( getFontField( line, "width"     ).c_str() );
+			glyph.clip.h    = atoi( getFontField( line, "height"    ).c_str() );
+			glyph.xOffset   = atoi( getFontField( line, "xoffset"   ).c_str() );
+			glyph.yOffset   = atoi( getFontField( line, "yoffset"   ).c_str() );
+			glyph.advance   = atoi( getFontField( line, "xadvance"  ).c_str() );
+			mGlyphs.push_back( glyph );
+		}
+		else if ( tag == "kerning" )
+		{
+			Uint64  first   = (Uint32) atol( getFontField( line, "first"  ).c_str() );
+			Uint64  second  = (Uint32) atol( getFontField( line, "second" ).c_str() );
+			Kerning kerning = { ( first << 32 ) | second, atoi( getFontField( line, "amount" ).c_str() ) };
+			mKerning.push_back( kerning );
+		}
+	}
+
+	//  Every glyph needs its page
+	for ( Glyph& glyph : mGlyphs )
+	{
+		if  ( glyph.page < 0 || glyph.page >= (int) mPages.size() || mPages[ glyph.page ] == NULL )
+		{
+			printf( "Font character %u uses a missing page!\n", (unsigned) glyph.codepoint );
+			success = false;
+			break;
+		}
+	}
+
+	if  ( !success || mPages.empty() )
+	{
+		free();
+		return false;
+	}
+
+	indexGlyphs();
+
+	//  Space comes from the font when it has one
+	const Glyph*    space = findGlyph( ' ' );
+	mSpace = space != NULL ? space->advance : mNewLine / 4;
+
+	return true;
+}
+
+void    LBitmapFont::indexGlyphs()
+{
+	//  Sort for binary search
+	std::sort(
+        mGlyphs.begin() ,
+        mGlyphs.end()   ,
+        []( const Glyph& a, const Glyph& b ) { return a.codepoint < b.codepoint; }
+    );
+	std::sort(
+        mKerning.begin(),
+        mKerning.end()  ,
+        []( const Kerning& a, const Kerning& b ) { return a.pair < b.pair; }
+    );
+
+	//  Direct lookup for the first 256 codepoints
+	for ( int i = 0; i < 256; ++i )
+	{
+		mLatin1[ i ] = -1;
+	}
+	for ( int i = 0; i < (int) mGlyphs.size() && mGlyphs[ i ].codepoint < 256; ++i )
+	{
+		mLatin1[ mGlyphs[ i ].codepoint ] = i;
+	}
+}
+
+const LBitmapFont::Glyph*   LBitmapFont::findGlyph  ( Uint32 codepoint )
+{
+	//  Latin-1 is a table lookup
+	if  ( codepoint < 256 )
+	{
+		return mLatin1[ codepoint ] < 0 ? NULL : &mGlyphs[ mLatin1[ codepoint ] ];
+	}
+
+	//  Everything else is a binary search
+	std::vector<Glyph>::iterator glyph =
+        std::lower_bound(
+            mGlyphs.begin() ,
+            mGlyphs.end()   ,
+            codepoint       ,
+            []( const Glyph& g, Uint32 c ) { return g.codepoint < c; }
+        );
+
+	return glyph != mGlyphs.end() && glyph->codepoint == codepoint ? &*glyph : NULL;
+}
+
+int     LBitmapFont::getKerning ( Uint32 first, Uint32 second )
+{
+	if  ( mKerning.empty() )
+	{
+		return 0;
+	}
+
+	Uint64  pair = ( (Uint64) first << 32 ) | second;
+	std::vector<Kerning>::iterator kerning =
+        std::lower_bound(
+            mKerning.begin(),
+            mKerning.end()  ,
+            pair            ,
+            []( const Kerning& k, Uint64 p ) { return k.pair < p; }
+        );
+
+	return kerning != mKerning.end() && kerning->pair == pair ? kerning->amount : 0;
+}
+
 void    LBitmapFont::renderText ( int x, int y, std::string text )
+{
+    //  Lay out every call
+    layoutText( mScratch, x, y, text );
+    renderRun( mScratch );
+}
+
+void    LBitmapFont::renderText ( LTextRun& run, int x, int y, std::string text )
 {
     //  If the font has been built
-    if  ( mBitmap != NULL )
+    if  ( !mPages.empty() )
     {
+        //  Only lay out again if anything changed
+        SDL_Color color = getColor();
+        if  (
+                !run.mLaidOut           ||
+                run.mX != x             ||
+                run.mY != y             ||
+                run.mColor.r != color.r ||
+                run.mColor.g != color.g ||
+                run.mColor.b != color.b ||
+                run.mColor.a != color.a ||
+                run.mText != text
+            )
+        {
+            layoutText( run, x, y, text );
+        }
+
+        renderRun( run );
+    }
+}
+
+void    LBitmapFont::layoutText ( LTextRun& run, int x, int y, std::string text )
+{
+    run.mText   = text;
+    run.mX      = x;
+    run.mY      = y;
+    run.mLaidOut= true;
+
+    //  One vertex list per page
+    run.mVertices.resize( mPages.size() );
+    for ( std::vector<SDL_Vertex>& vertices : run.mVertices )
+    {
+        vertices.clear();
+    }
+
+    //  If the font has been built
+    if  ( !mPages.empty() )
+    {
+		//  Glyphs take the bitmap modulation
+		SDL_Color   color = getColor();
+		run.mColor  = color;
+
 		//  Temp offsets
 		int curX = x, curY = y;
 
+		//  Previous character for kerning
+		Uint32  previous = 0;
+
         //  Go through the text
-        for ( int i = 0; i < (int) text.length(); ++i )
+        for ( int i = 0; i < (int) text.length(); )
         {
+            Uint32 codepoint = nextCodepoint( text, i );
+
             //  If the current character is a space
-            if  ( text[ i ] == ' ' )
+            if  ( codepoint == ' ' )
             {
                 //  Move over
                 curX += mSpace;
+                previous = 0;
+                continue;
             }
             //  If the current character is a newline
-            else if ( text[ i ] == '\n' )
+            else if ( codepoint == '\n' )
             {
                 //  Move down
                 curY += mNewLine;
 
                 //  Move back
                 curX = x;
+                previous = 0;
+                continue;
             }
-            else
-            {
-                //  Get the ASCII value of the character
-                int ascii = (unsigned char) text[ i ];
 
-                //  Show the character
-				mBitmap->render( curX, curY, &mChars[ ascii ] );
+            //  Missing characters show as the replacement character or '?'
+            const Glyph* glyph = findGlyph( codepoint );
+            if  ( glyph == NULL ) glyph = findGlyph( 0xFFFD );
+            if  ( glyph == NULL ) glyph = findGlyph( '?' );
+            if  ( glyph == NULL )
+            {
+                continue;
+            }
 
-                //  Move over the width of the character with one pixel of padding
-                curX += mChars[ ascii ].w + 1;
+            //  Pull the pair together or apart
+            if  ( previous != 0 )
+            {
+                curX += getKerning( previous, glyph->codepoint );
             }
+            previous = glyph->codepoint;
+
+            //  Texel to texture coordinate scale
+            LTexture*   page    = mPages[ glyph->page ];
+            float       scaleU  = 1.f / page->getWidth();
+            float       scaleV  = 1.f / page->getHeight();
+
+            //  Add the character quad, clockwise from the top left
+            const SDL_Rect& clip = glyph->clip;
+            float   x0 = (float)( curX + glyph->xOffset ), x1 = x0 + clip.w;
+            float   y0 = (float)( curY + glyph->yOffset ), y1 = y0 + clip.h;
+            float   u0 = clip.x * scaleU, u1 = ( clip.x + clip.w ) * scaleU;
+            float   v0 = clip.y * scaleV, v1 = ( clip.y + clip.h ) * scaleV;
+
+            SDL_Vertex  quad[ 4 ] = {
+                { { x0, y0 }, color, { u0, v0 } },
+                { { x1, y0 }, color, { u1, v0 } },
+                { { x1, y1 }, color, { u1, v1 } },
+                { { x0, y1 }, color, { u0, v1 } }
+            };
+            run.mVertices[ glyph->page ].insert( run.mVertices[ glyph->page ].end(), quad, quad + 4 );
+
+            //  Move over the character
+            curX += glyph->advance;
+        }
+    }
+}
+
+void    LBitmapFont::renderRun  ( LTextRun& run )
+{
+    //  Draw each page with one call
+    for ( int page = 0; page < (int) run.mVertices.size() && page < (int) mPages.size(); ++page )
+    {
+        std::vector<SDL_Vertex>& vertices = run.mVertices[ page ];
+        int glyphs = (int) vertices.size() / 4;
+        if  ( glyphs == 0 )
+        {
+            continue;
         }
+
+        //  Two triangles per quad
+        growQuadIndices( mIndices, glyphs );
+
+        SDL_RenderGeometry(
+            gRenderer                   ,
+            mPages[ page ]->getTexture(),
+            &vertices[ 0 ]              ,
+            glyphs * 4                  ,
+            &mIndices[ 0 ]              ,
+            glyphs * 6
+        );
     }
 }
 
+SDL_Color   LBitmapFont::getColor()
+{
+    SDL_Color color = { 0xFF, 0xFF, 0xFF, 0xFF };
+
+    //  Page ids may leave gaps, read the first page that loaded
+    for ( LTexture* page : mPages )
+    {
+        if  ( page != NULL )
+        {
+            SDL_GetTextureColorMod( page->getTexture(), &color.r, &color.g, &color.b );
+            SDL_GetTextureAlphaMod( page->getTexture(), &color.a );
+            break;
+        }
+    }
+
+    return color;
+}
+
+        LTextRun::LTextRun()
+{
+    //  Initialize variables
+    mX      = 0;
+    mY      = 0;
+    mColor  = { 0xFF, 0xFF, 0xFF, 0xFF };
+    mLaidOut= false;
+}
+
+int     LTextRun::getGlyphCount()
+{
+    int glyphs = 0;
+    for ( std::vector<SDL_Vertex>& vertices : mVertices )
+    {
+        glyphs += (int) vertices.size() / 4;
+    }
+
+    return glyphs;
+}
+
 bool init()
 {
 	//  Initialization flag
@@ -761,7 +1292,14 @@ bool loadMedia()
 	else
 	{
 		//  Build font from texture
-		gBitmapFont.buildFont( &gBitmapTexture );
+		gBitmapFont.buildFont( &gBitmapTexture, "./lazyfont.metrics" );
+	}
+
+	//  Load the paged font with its Unicode characters and kerning
+	if  ( !gPagedFont.loadFont( "./lazyfont.fnt" ) )
+	{
+		printf( "Failed to load paged font!\n" );
+		success = false;
 	}
 
 	return success;
@@ -770,6 +1308,8 @@ bool loadMedia()
 void close()
 {
 	//  Free loaded images
+	gPagedFont.free();
+	gBitmapFont.free();
 	gBitmapTexture.free();
 
 	//  Destroy window	
@@ -824,6 +1364,7 @@ int main    ( int   /*argc*/, char*   /*args*/[] )
 
 				//  Render test text
 				gBitmapFont.renderText(
+                    gTextRun        ,
                     0               ,
                     0               ,
                     "Bitmap Font:\n"
@@ -832,6 +1373,16 @@ int main    ( int   /*argc*/, char*   /*args*/[] )
                     "0123456789"
                 );
 
+				//  Render characters past Latin-1 from the second page
+				gPagedFont.renderText(
+                    gPagedRun       ,
+                    0               ,
+                    200             ,
+                    "BMFont, two pages:\n"
+                    "“AVATAR” – Tomato €5…\n"
+                    "Œuvre élève ™"
+                );
+
 				//  Update screen
 				SDL_RenderPresent   ( gRenderer );
 			}
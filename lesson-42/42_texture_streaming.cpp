@@ -1,16 +1,38 @@
 /*  This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.    */
 
-//  Using SDL, SDL_image, standard IO, and strings
+//  Using SDL, SDL_image, SDL threads, standard IO, file times, strings, and vectors
 #include <SDL.h>
 #include <SDL_image.h>
+#include <SDL_thread.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <string>
+#include <vector>
+
+//  Using the shared pixel kernels, pixel views, and dirty regions
+#include "../share/LPixelKernels.h"
+#include "../share/LPixelView.h"
+#include "../share/LDirtyRegion.h"
 
 //  Screen dimension constants
 const int SCREEN_WIDTH  = 640;
 const int SCREEN_HEIGHT = 480;
 
+//  Animation frame rate of the stream
+const Uint32 FRAME_TICKS = 1000 / 15;
+
+//  Marks the middle stream buffer as newer than the front one
+const int FRESH_FRAME = 4;
+
+//  Frame file tag and the flag of frames stored whole
+const Uint32 FRAME_FILE_MAGIC   = 0x4D52464C;   //  "LFRM"
+const Uint32 FRAME_KEY          = 1;
+
+//  Largest frame side and frame count a frame file may claim
+const Uint32 FRAME_MAX_SIZE     = 4096;
+const Uint32 FRAME_MAX_COUNT    = 65536;
+
 //  Texture wrapper class
 class LTexture
 {
@@ -52,12 +74,15 @@ class LTexture
 		int getHeight();
 
 		//  Pixel manipulators
-		bool    lockTexture();
+		bool    lockTexture( const SDL_Rect* rect = NULL );
 		bool    unlockTexture();
 		void*   getPixels();
 		void    copyPixels( void* pixels );
+		bool    updateTexture( const void* pixels, int pitch );
+		int     updateTexture( const void* pixels, int pitch, LDirtyRegion& dirty );
 		int     getPitch();
 		Uint32  getPixel32( unsigned int x, unsigned int y );
+		LPixelView  getPixelView();
 
 	private:
 		//  The actual hardware texture
@@ -65,32 +90,158 @@ class LTexture
 		void*   mPixels;
 		int     mPitch;
 
+		//  Locked area
+		SDL_Rect        mLockRect;
+
 		//  Image dimensions
 		int mWidth;
 		int mHeight;
 };
 
-//  A test animation stream
+//  Somewhere frames come from, decoded on demand
+class LFrameSource
+{
+	public:
+		virtual ~LFrameSource() {}
+
+		//  Gets frame dimensions and count
+		virtual int getWidth() = 0;
+		virtual int getHeight() = 0;
+		virtual int getFrameCount() = 0;
+
+		//  Decodes a frame into RGBA8888 pixels, called from the stream thread
+		virtual bool decodeFrame( int frame, LPixelView pixels ) = 0;
+};
+
+//  Numbered image files, loaded one at a time
+class LImageSequence : public LFrameSource
+{
+	public:
+		//  Initializes internals
+		LImageSequence();
+
+		//  Checks the files, pattern is a printf format for the frame number
+		bool open( std::string pattern, int frameCount );
+
+		int getWidth();
+		int getHeight();
+		int getFrameCount();
+		bool decodeFrame( int frame, LPixelView pixels );
+
+		//  Gets when the newest file was written, -1 if one is missing
+		Sint64 getModifiedTime();
+
+	private:
+		//  Gets the path of a frame
+		std::string getPath( int frame );
+
+		//  Loads a frame as RGBA8888
+		SDL_Surface* loadFrame( int frame );
+
+		std::string mPattern;
+		int     mFrameCount;
+		int     mWidth, mHeight;
+};
+
+//  Compressed frame sequence file, read one frame at a time.
+//	A header, an index of frames, then each frame run-length encoded,
+//	either whole or XORed with the frame before it
+class LFrameContainer : public LFrameSource
+{
+	public:
+		//  Initializes internals
+		LFrameContainer();
+
+		//  Closes the file
+		~LFrameContainer();
+
+		//  Encodes every frame of the source into a file, with a whole
+		//	frame every keyInterval frames so decoding can start there
+		static bool write( std::string path, LFrameSource& source, int keyInterval = 30 );
+
+		//  Opens a file and reads its index
+		bool open( std::string path );
+
+		//  Closes the file
+		void close();
+
+		int getWidth();
+		int getHeight();
+		int getFrameCount();
+		bool decodeFrame( int frame, LPixelView pixels );
+
+		//  Gets the size of the compressed frames
+		Uint64 getCompressedBytes();
+
+	private:
+		//  Where a frame is and how it is stored
+		struct Entry
+		{
+			Uint32  offset;
+			Uint32  size;
+			Uint32  flags;
+		};
+
+		//  Run-length encodes pixels, a count byte with the top bit set
+		//	repeats the next pixel, otherwise that many pixels follow
+		static void encode( const Uint32* pixels, int count, std::vector<Uint8>& data );
+
+		//  Decodes into pixels, XORing for delta frames
+		static bool decode( const std::vector<Uint8>& data, Uint32* pixels, int count, bool delta );
+
+		//  Decodes a frame into mLast
+		bool decodeNext( int frame );
+
+		SDL_RWops*          mFile;
+		int                 mWidth, mHeight;
+		std::vector<Entry>  mIndex;
+
+		//  The last decoded frame, delta frames build on it
+		std::vector<Uint32> mLast;
+		int                 mLastFrame;
+
+		//  Read buffer for compressed frames
+		std::vector<Uint8>  mData;
+};
+
+//  A test animation stream, frames are decoded on a producer thread into
+//	a pool of three buffers so the main thread always has a whole frame
 class DataStream
 {
 	public:
 		//  Initializes internals
 		DataStream();
 
-		//  Loads initial data
-		bool loadMedia();
+		//  Starts decoding frames from the source, one every frameTicks
+		bool start( LFrameSource* source, Uint32 frameTicks );
 
-		//  Deallocator
+		//  Stops the producer and deallocates
 		void free();
 
-		//  Gets current frame data
-		void* getBuffer();
+		//  Gets the newest frame, false if nothing new was decoded since
+		//	the last call, the frame stays valid until the next call
+		bool getFrame( LPixelView* frame );
 
 	private:
-		//  Internal data
-		SDL_Surface* mImages[ 4 ];
-		int     mCurrentImage;
-		int     mDelayFrames;
+		//  Decodes frames until stopped
+		static int producer( void* data );
+
+		//  The frame pool
+		LFrameSource*           mSource;
+		std::vector<Uint32>     mFrames[ 3 ];
+
+		//  Buffer the producer writes and the one the consumer reads
+		int     mBack;
+		int     mFront;
+
+		//  Buffer between them, with FRESH_FRAME set when it is newer
+		//	than the front one
+		SDL_atomic_t    mMiddle;
+
+		//  Producer thread and pacing
+		SDL_Thread*     mThread;
+		SDL_atomic_t    mQuit;
+		Uint32          mFrameTicks;
 };
 
 //  Starts up SDL and creates window
@@ -102,6 +253,9 @@ bool loadMedia();
 //  Frees media and shuts down SDL
 void close();
 
+//  Gets when a file was last written, -1 if it can't be found
+Sint64 getModifiedTime( std::string path );
+
 //  The window we'll be rendering to
 SDL_Window*     gWindow     = NULL;
 
@@ -111,8 +265,19 @@ SDL_Renderer*   gRenderer   = NULL;
 //  Scene textures
 LTexture gStreamingTexture;
 
-//  Animation stream
-DataStream gDataStream;
+//  What the streaming texture holds, and the tiles that differ from the
+//	next frame
+std::vector<Uint32> gShownPixels;
+LDirtyRegion        gDirtyTiles;
+
+//  Bytes uploaded and bytes whole frames would have needed
+Uint64  gUploadedBytes  = 0;
+Uint64  gFrameBytes     = 0;
+
+//  Animation frames and their stream
+LImageSequence  gFrames;
+LFrameContainer gFrameFile;
+DataStream      gDataStream;
 
 LTexture::LTexture()
 {
@@ -122,6 +287,7 @@ LTexture::LTexture()
 	mHeight = 0;
 	mPixels = NULL;
 	mPitch  = 0;
+	mLockRect = { 0, 0, 0, 0 };
 }
 
 LTexture::~LTexture()
@@ -205,8 +371,8 @@ bool LTexture::loadFromFile( std::string path )
 				mHeight = formattedSurface->h;
 
 				//  Get pixel data in editable format
-				Uint32*     pixels = (Uint32*)  mPixels;
-				int pixelCount = ( mPitch / 4 ) * mHeight;
+				mLockRect = { 0, 0, mWidth, mHeight };
+				LPixelView  pixels = getPixelView();
 
 				//  Map colors				
 				Uint32 colorKey     = SDL_MapRGB (
@@ -224,13 +390,12 @@ bool LTexture::loadFromFile( std::string path )
                 );
 
 				//  Color key pixels
-				for ( int i = 0; i < pixelCount; ++i )
-				{
-					if  ( pixels[ i ] == colorKey )
-					{
-						pixels[ i ] = transparent;
-					}
-				}
+				pixels.forEachRow(
+                    [&]( std::span<Uint32> row, int /*y*/ )
+                    {
+                        colorKeyPixels( row.data(), (int) row.size(), colorKey, transparent );
+                    }
+                );
 
 				//  Unlock texture to update
 				SDL_UnlockTexture( newTexture );
@@ -377,7 +542,7 @@ int LTexture::getHeight()
 	return mHeight;
 }
 
-bool LTexture::lockTexture()
+bool LTexture::lockTexture( const SDL_Rect* rect )
 {
 	bool success = true;
 
@@ -390,11 +555,16 @@ bool LTexture::lockTexture()
 	//  Lock texture
 	else
 	{
-		if  ( SDL_LockTexture( mTexture, NULL, &mPixels, &mPitch ) != 0 )
+		//  Only the given area, or everything
+		if  ( SDL_LockTexture( mTexture, rect, &mPixels, &mPitch ) != 0 )
 		{
 			printf( "Unable to lock texture! %s\n", SDL_GetError() );
 			success = false;
 		}
+		else
+		{
+			mLockRect = rect != NULL ? *rect : SDL_Rect{ 0, 0, mWidth, mHeight };
+		}
 	}
 
 	return success;
@@ -432,8 +602,39 @@ void LTexture::copyPixels( void* pixels )
 	if  ( mPixels != NULL )
 	{
 		//  Copy to locked pixels
-		memcpy( mPixels, pixels, mPitch * mHeight );
+		memcpy( mPixels, pixels, mPitch * mLockRect.h );
+	}
+}
+
+int LTexture::updateTexture( const void* pixels, int pitch, LDirtyRegion& dirty )
+{
+	//  Upload the dirty rectangles of the pixels, nothing else
+	int bytes = 0;
+	for ( const SDL_Rect& rect : dirty.getRects() )
+	{
+		const Uint8* start = (const Uint8*) pixels + rect.y * pitch + rect.x * 4;
+		if  ( SDL_UpdateTexture( mTexture, &rect, start, pitch ) != 0 )
+		{
+			printf( "Unable to update texture! %s\n", SDL_GetError() );
+			break;
+		}
+		bytes += rect.w * rect.h * 4;
+	}
+	dirty.clear();
+
+	return bytes;
+}
+
+bool LTexture::updateTexture( const void* pixels, int pitch )
+{
+	//  Upload straight from the pixels, without locking
+	if  ( SDL_UpdateTexture( mTexture, NULL, pixels, pitch ) != 0 )
+	{
+		printf( "Unable to update texture! %s\n", SDL_GetError() );
+		return false;
 	}
+
+	return true;
 }
 
 int LTexture::getPitch()
@@ -443,73 +644,533 @@ int LTexture::getPitch()
 
 Uint32 LTexture::getPixel32( unsigned int x, unsigned int y )
 {
-    //  Convert the pixels to 32 bit
-    Uint32 *    pixels = (Uint32*)  mPixels;
-
     //  Get the pixel requested
-    return pixels[ ( y * ( mPitch / 4 ) ) + x ];
+    return getPixelView().at( x, y );
 }
 
-DataStream::DataStream()
+LPixelView LTexture::getPixelView()
 {
-	mImages[ 0 ] = NULL;
-	mImages[ 1 ] = NULL;
-	mImages[ 2 ] = NULL;
-	mImages[ 3 ] = NULL;
+    //  View over the locked pixels
+    return LPixelView( mPixels, mPitch, mLockRect.w, mLockRect.h );
+}
 
-	mCurrentImage   = 0;
-	mDelayFrames    = 4;
+LImageSequence::LImageSequence()
+{
+	mFrameCount = 0;
+	mWidth      = 0;
+	mHeight     = 0;
 }
 
-bool DataStream::loadMedia()
+bool LImageSequence::open( std::string pattern, int frameCount )
 {
-	bool success = true;
-	
-	for ( int i = 0; i < 4; ++i )
+	mPattern    = pattern;
+	mFrameCount = frameCount;
+
+	//  Frame size from the first frame
+	SDL_Surface* first = loadFrame( 0 );
+	if  ( first == NULL )
+	{
+		return false;
+	}
+
+	mWidth  = first->w;
+	mHeight = first->h;
+	SDL_FreeSurface( first );
+
+	return true;
+}
+
+int LImageSequence::getWidth()
+{
+	return mWidth;
+}
+
+int LImageSequence::getHeight()
+{
+	return mHeight;
+}
+
+int LImageSequence::getFrameCount()
+{
+	return mFrameCount;
+}
+
+bool LImageSequence::decodeFrame( int frame, LPixelView pixels )
+{
+	SDL_Surface* surface = loadFrame( frame );
+	if  ( surface == NULL )
+	{
+		return false;
+	}
+
+	//  Frames must all be the same size
+	bool success = surface->w == pixels.getWidth() && surface->h == pixels.getHeight();
+	if  ( success )
+	{
+		LPixelView source( surface->pixels, surface->pitch, surface->w, surface->h );
+		pixels.forEachRow(
+            [&]( std::span<Uint32> row, int y )
+            {
+                memcpy( row.data(), source.getRow( y ), row.size_bytes() );
+            }
+        );
+	}
+	else
+	{
+		printf( "Frame %d is not %dx%d!\n", frame, pixels.getWidth(), pixels.getHeight() );
+	}
+
+	SDL_FreeSurface( surface );
+	return success;
+}
+
+Sint64 LImageSequence::getModifiedTime()
+{
+	Sint64 newest = -1;
+	for ( int frame = 0; frame < mFrameCount; ++frame )
+	{
+		Sint64 time = ::getModifiedTime( getPath( frame ) );
+		if  ( time < 0 )
+		{
+			return -1;
+		}
+		newest = SDL_max( newest, time );
+	}
+
+	return newest;
+}
+
+std::string LImageSequence::getPath( int frame )
+{
+	char path[ 256 ] = "";
+	SDL_snprintf( path, sizeof( path ), mPattern.c_str(), frame );
+
+	return path;
+}
+
+SDL_Surface* LImageSequence::loadFrame( int frame )
+{
+	std::string path = getPath( frame );
+
+	SDL_Surface* loadedSurface = IMG_Load( path.c_str() );
+	if  ( loadedSurface == NULL )
+	{
+		printf( "Unable to load %s! SDL_image error: %s\n", path.c_str(), IMG_GetError() );
+		return NULL;
+	}
+
+	SDL_Surface* formattedSurface = SDL_ConvertSurfaceFormat( loadedSurface, SDL_PIXELFORMAT_RGBA8888, 0 );
+	SDL_FreeSurface( loadedSurface );
+
+	return formattedSurface;
+}
+
+LFrameContainer::LFrameContainer()
+{
+	mFile       = NULL;
+	mWidth      = 0;
+	mHeight     = 0;
+	mLastFrame  = -1;
+}
+
+LFrameContainer::~LFrameContainer()
+{
+	close();
+}
+
+bool LFrameContainer::write( std::string path, LFrameSource& source, int keyInterval )
+{
+	int width   = source.getWidth();
+	int height  = source.getHeight();
+	int frames  = source.getFrameCount();
+	int count   = width * height;
+
+	//  Encode every frame, delta frames against the one before
+	std::vector<Uint32> previous( count ), current( count ), delta( count );
+	std::vector<Uint8>  data;
+	std::vector<Entry>  index( frames );
+	Uint32 offset = sizeof( Uint32 ) * 4 + sizeof( Entry ) * frames;
+
+	for ( int frame = 0; frame < frames; ++frame )
 	{
-		char path[ 64 ] = "";
-		sprintf( path, "./foo_walk_%d.png", i );
+		LPixelView pixels( &current[ 0 ], width * 4, width, height );
+		if  ( !source.decodeFrame( frame, pixels ) )
+		{
+			return false;
+		}
 
-		SDL_Surface* loadedSurface = IMG_Load( path );
-		if  ( loadedSurface == NULL )
+		size_t  start   = data.size();
+		bool    key     = frame % keyInterval == 0;
+		if  ( key )
 		{
-			printf( "Unable to load %s! SDL_image error: %s\n", path, IMG_GetError() );
-			success = false;
+			encode( &current[ 0 ], count, data );
 		}
 		else
 		{
-			mImages[ i ] = SDL_ConvertSurfaceFormat( loadedSurface, SDL_PIXELFORMAT_RGBA8888, 0 );
+			for ( int i = 0; i < count; ++i )
+			{
+				delta[ i ] = current[ i ] ^ previous[ i ];
+			}
+			encode( &delta[ 0 ], count, data );
 		}
 
-		SDL_FreeSurface( loadedSurface );
+		index[ frame ].offset   = offset + (Uint32) start;
+		index[ frame ].size     = (Uint32)( data.size() - start );
+		index[ frame ].flags    = key ? FRAME_KEY : 0;
+		previous.swap( current );
+	}
+
+	//  Open file for writing in binary
+	SDL_RWops* file = SDL_RWFromFile( path.c_str(), "wb" );
+	if  ( file == NULL )
+	{
+		printf( "Unable to write %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+		return false;
 	}
 
+	Uint32  header[ 4 ] = { FRAME_FILE_MAGIC, (Uint32) width, (Uint32) height, (Uint32) frames };
+	bool    success     =
+        SDL_RWwrite( file, header, sizeof( header ), 1 ) == 1                   &&
+        SDL_RWwrite( file, &index[ 0 ], sizeof( Entry ), frames ) == (size_t) frames &&
+        SDL_RWwrite( file, &data[ 0 ], data.size(), 1 ) == 1;
+
+	//  Close file handler
+	SDL_RWclose( file );
+
 	return success;
 }
 
+bool LFrameContainer::open( std::string path )
+{
+	//  Get rid of preexisting file
+	close();
+
+	//  Open file for reading in binary
+	mFile = SDL_RWFromFile( path.c_str(), "rb" );
+	if  ( mFile == NULL )
+	{
+		return false;
+	}
+
+	Uint32 header[ 4 ] = { 0, 0, 0, 0 };
+	if  ( SDL_RWread( mFile, header, sizeof( header ), 1 ) != 1 || header[ 0 ] != FRAME_FILE_MAGIC )
+	{
+		printf( "%s is not a frame file!\n", path.c_str() );
+		close();
+		return false;
+	}
+
+	//  Don't trust the header until it fits the limits and the file
+	Sint64 fileBytes    = SDL_RWsize( mFile );
+	Uint64 dataStart    = sizeof( header ) + (Uint64) sizeof( Entry ) * header[ 3 ];
+	if  (
+            header[ 1 ] == 0 || header[ 1 ] > FRAME_MAX_SIZE    ||
+            header[ 2 ] == 0 || header[ 2 ] > FRAME_MAX_SIZE    ||
+            header[ 3 ] == 0 || header[ 3 ] > FRAME_MAX_COUNT   ||
+            fileBytes < 0 || (Uint64) fileBytes < dataStart
+        )
+	{
+		printf( "%s has a bad header!\n", path.c_str() );
+		close();
+		return false;
+	}
+
+	mWidth  = header[ 1 ];
+	mHeight = header[ 2 ];
+	mIndex.resize( header[ 3 ] );
+	if  (
+            SDL_RWread( mFile, &mIndex[ 0 ], sizeof( Entry ), mIndex.size() ) != mIndex.size() ||
+            !( mIndex[ 0 ].flags & FRAME_KEY )
+        )
+	{
+		printf( "Unable to read the index of %s!\n", path.c_str() );
+		close();
+		return false;
+	}
+
+	//  Every frame must lie within the file, after the index
+	for ( const Entry& entry : mIndex )
+	{
+		if  ( entry.offset < dataStart || (Uint64) entry.offset + entry.size > (Uint64) fileBytes )
+		{
+			printf( "%s has a frame outside the file!\n", path.c_str() );
+			close();
+			return false;
+		}
+	}
+
+	mLast.assign( mWidth * mHeight, 0 );
+	mLastFrame = -1;
+
+	return true;
+}
+
+void LFrameContainer::close()
+{
+	if  ( mFile != NULL )
+	{
+		SDL_RWclose( mFile );
+		mFile = NULL;
+	}
+	mIndex.clear();
+	mLast.clear();
+	mLastFrame = -1;
+}
+
+int LFrameContainer::getWidth()
+{
+	return mWidth;
+}
+
+int LFrameContainer::getHeight()
+{
+	return mHeight;
+}
+
+int LFrameContainer::getFrameCount()
+{
+	return (int) mIndex.size();
+}
+
+bool LFrameContainer::decodeFrame( int frame, LPixelView pixels )
+{
+	if  (
+            mFile == NULL || frame < 0 || frame >= getFrameCount()      ||
+            pixels.getWidth() != mWidth || pixels.getHeight() != mHeight
+        )
+	{
+		return false;
+	}
+
+	//  Playing in order only decodes the next frame, otherwise start
+	//	from the key frame before it
+	if  ( frame != mLastFrame + 1 && frame != mLastFrame )
+	{
+		mLastFrame = frame;
+		while   ( !( mIndex[ mLastFrame ].flags & FRAME_KEY ) )
+		{
+			--mLastFrame;
+		}
+		--mLastFrame;
+	}
+	while   ( mLastFrame < frame )
+	{
+		if  ( !decodeNext( mLastFrame + 1 ) )
+		{
+			mLastFrame = -1;
+			return false;
+		}
+	}
+
+	//  Copy out the decoded frame
+	LPixelView last( &mLast[ 0 ], mWidth * 4, mWidth, mHeight );
+	pixels.forEachRow(
+        [&]( std::span<Uint32> row, int y )
+        {
+            memcpy( row.data(), last.getRow( y ), row.size_bytes() );
+        }
+    );
+
+	return true;
+}
+
+Uint64 LFrameContainer::getCompressedBytes()
+{
+	Uint64 bytes = 0;
+	for ( const Entry& entry : mIndex )
+	{
+		bytes += entry.size;
+	}
+
+	return bytes;
+}
+
+bool LFrameContainer::decodeNext( int frame )
+{
+	//  Read just this frame
+	const Entry& entry = mIndex[ frame ];
+	mData.resize( entry.size );
+	if  (
+            SDL_RWseek( mFile, entry.offset, RW_SEEK_SET ) < 0 ||
+            ( entry.size > 0 && SDL_RWread( mFile, &mData[ 0 ], entry.size, 1 ) != 1 )
+        )
+	{
+		printf( "Unable to read frame %d!\n", frame );
+		return false;
+	}
+
+	if  ( !decode( mData, &mLast[ 0 ], (int) mLast.size(), !( entry.flags & FRAME_KEY ) ) )
+	{
+		printf( "Frame %d is corrupt!\n", frame );
+		return false;
+	}
+
+	mLastFrame = frame;
+	return true;
+}
+
+void LFrameContainer::encode( const Uint32* pixels, int count, std::vector<Uint8>& data )
+{
+	int i = 0;
+	while   ( i < count )
+	{
+		//  Length of the run starting here
+		int run = 1;
+		while   ( i + run < count && run < 128 && pixels[ i + run ] == pixels[ i ] )
+		{
+			++run;
+		}
+
+		if  ( run >= 2 )
+		{
+			data.push_back( (Uint8)( 0x80 | ( run - 1 ) ) );
+			data.insert( data.end(), (const Uint8*) &pixels[ i ], (const Uint8*) &pixels[ i + 1 ] );
+			i += run;
+			continue;
+		}
+
+		//  Literal pixels until the next run of two
+		int literal = 1;
+		while   (
+                    i + literal < count && literal < 128 &&
+                    !( i + literal + 1 < count && pixels[ i + literal ] == pixels[ i + literal + 1 ] )
+                )
+		{
+			++literal;
+		}
+		data.push_back( (Uint8)( literal - 1 ) );
+		data.insert( data.end(), (const Uint8*) &pixels[ i ], (const Uint8*) &pixels[ i + literal ] );
+		i += literal;
+	}
+}
+
+bool LFrameContainer::decode( const std::vector<Uint8>& data, Uint32* pixels, int count, bool delta )
+{
+	size_t  in  = 0;
+	int     out = 0;
+	while   ( in < data.size() )
+	{
+		Uint8   packet  = data[ in++ ];
+		int     length  = ( packet & 0x7F ) + 1;
+		bool    repeat  = packet & 0x80;
+		size_t  bytes   = repeat ? 4 : length * 4;
+
+		//  Never read or write past the ends
+		if  ( in + bytes > data.size() || out + length > count )
+		{
+			return false;
+		}
+
+		for ( int i = 0; i < length; ++i )
+		{
+			Uint32 value;
+			memcpy( &value, &data[ in + ( repeat ? 0 : i * 4 ) ], 4 );
+			pixels[ out + i ] = delta ? pixels[ out + i ] ^ value : value;
+		}
+		in  += bytes;
+		out += length;
+	}
+
+	return out == count;
+}
+
+DataStream::DataStream()
+{
+	mSource     = NULL;
+	mBack       = 0;
+	mFront      = 1;
+	mThread     = NULL;
+	mFrameTicks = 0;
+	SDL_AtomicSet( &mMiddle, 2 );
+	SDL_AtomicSet( &mQuit, 0 );
+}
+
+bool DataStream::start( LFrameSource* source, Uint32 frameTicks )
+{
+	//  Get rid of preexisting stream
+	free();
+
+	mSource     = source;
+	mFrameTicks = frameTicks;
+	for ( int i = 0; i < 3; ++i )
+	{
+		mFrames[ i ].assign( source->getWidth() * source->getHeight(), 0 );
+	}
+	mBack   = 0;
+	mFront  = 1;
+	SDL_AtomicSet( &mMiddle, 2 );
+	SDL_AtomicSet( &mQuit, 0 );
+
+	mThread = SDL_CreateThread( producer, "DataStream", this );
+	if  ( mThread == NULL )
+	{
+		printf( "Unable to create stream thread! SDL Error: %s\n", SDL_GetError() );
+	}
+
+	return mThread != NULL;
+}
+
 void DataStream::free()
 {
-	for ( int i = 0; i < 4; ++i )
+	//  Stop the producer
+	if  ( mThread != NULL )
+	{
+		SDL_AtomicSet( &mQuit, 1 );
+		SDL_WaitThread( mThread, NULL );
+		mThread = NULL;
+	}
+
+	for ( int i = 0; i < 3; ++i )
 	{
-		SDL_FreeSurface( mImages[ i ] );
+		mFrames[ i ].clear();
+		mFrames[ i ].shrink_to_fit();
 	}
+	mSource = NULL;
 }
 
-void* DataStream::getBuffer()
+bool DataStream::getFrame( LPixelView* frame )
 {
-	--mDelayFrames;
-	if  ( mDelayFrames == 0 )
+	//  Nothing new
+	if  ( mSource == NULL || !( SDL_AtomicGet( &mMiddle ) & FRESH_FRAME ) )
 	{
-		++mCurrentImage;
-		mDelayFrames = 4;
+		return false;
 	}
 
-	if  ( mCurrentImage == 4 )
+	//  Swap the front buffer for the fresh one
+	mFront = SDL_AtomicSet( &mMiddle, mFront ) & ~FRESH_FRAME;
+
+	int width = mSource->getWidth();
+	*frame = LPixelView( &mFrames[ mFront ][ 0 ], width * 4, width, mSource->getHeight() );
+	return true;
+}
+
+int DataStream::producer( void* data )
+{
+	DataStream* stream  = (DataStream*) data;
+	int         width   = stream->mSource->getWidth();
+	int         height  = stream->mSource->getHeight();
+	int         frame   = 0;
+	Uint32      next    = SDL_GetTicks();
+
+	while   ( !SDL_AtomicGet( &stream->mQuit ) )
 	{
-		mCurrentImage = 0;
+		//  Decode into the back buffer and publish it
+		LPixelView pixels( &stream->mFrames[ stream->mBack ][ 0 ], width * 4, width, height );
+		if  ( stream->mSource->decodeFrame( frame, pixels ) )
+		{
+			stream->mBack = SDL_AtomicSet( &stream->mMiddle, stream->mBack | FRESH_FRAME ) & ~FRESH_FRAME;
+		}
+		frame = ( frame + 1 ) % stream->mSource->getFrameCount();
+
+		//  Wait for the next frame time, checking for quit now and then
+		next += stream->mFrameTicks;
+		while   ( !SDL_AtomicGet( &stream->mQuit ) && !SDL_TICKS_PASSED( SDL_GetTicks(), next ) )
+		{
+			SDL_Delay( SDL_min( next - SDL_GetTicks(), (Uint32) 10 ) );
+		}
 	}
 
-	return mImages[ mCurrentImage ]->pixels;
+	return 0;
 }
 
 bool init()
@@ -590,28 +1251,90 @@ bool loadMedia()
 	//  Loading success flag
 	bool success = true;
 
-	//  Load blank texture
-	if  ( !gStreamingTexture.createBlank( 64, 205 ) )
+	//  The frame file is current when it matches the images and is newer
+	//	than all of them, images that can't be found leave it as it is
+	std::string framePath   = "./foo_walk.frames";
+	bool        haveImages  = gFrames.open( "./foo_walk_%d.png", 4 );
+	bool        current     =
+        gFrameFile.open( framePath )                                        &&
+        (
+            !haveImages                                                     ||
+            (
+                gFrameFile.getWidth()       == gFrames.getWidth()           &&
+                gFrameFile.getHeight()      == gFrames.getHeight()          &&
+                gFrameFile.getFrameCount()  == gFrames.getFrameCount()      &&
+                getModifiedTime( framePath ) >= gFrames.getModifiedTime()
+            )
+        );
+
+	//  Pack the images into a frame file the first time and whenever they change
+	if  ( !current && haveImages )
+	{
+		gFrameFile.close();
+		current = LFrameContainer::write( framePath, gFrames ) && gFrameFile.open( framePath );
+	}
+
+	if  ( !current )
+	{
+		printf( "Unable to load frame file!\n" );
+		success = false;
+	}
+	//  Load blank texture the size of the frames
+	else if ( !gStreamingTexture.createBlank( gFrameFile.getWidth(), gFrameFile.getHeight() ) )
 	{
 		printf( "Failed to create streaming texture!\n" );
 		success = false;
 	}
-
-	//  Load data stream
-	if  ( !gDataStream.loadMedia() )
+	//  Start the data stream
+	else if ( !gDataStream.start( &gFrameFile, FRAME_TICKS ) )
 	{		
 		printf( "Unable to load data stream!\n" );
 		success = false;
 	}
+	else
+	{
+		//  The texture starts undefined, so the first frame goes up whole
+		int width   = gStreamingTexture.getWidth();
+		int height  = gStreamingTexture.getHeight();
+		gShownPixels.assign( width * height, 0 );
+		gDirtyTiles.resize( width, height, 16 );
+		gDirtyTiles.markAll();
+
+		printf(
+            "Streaming %d frames, %llu bytes compressed from %llu\n"                ,
+            gFrameFile.getFrameCount()                                              ,
+            (unsigned long long) gFrameFile.getCompressedBytes()                    ,
+            (unsigned long long) gFrameFile.getFrameCount() * gFrameFile.getWidth() * gFrameFile.getHeight() * 4
+        );
+	}
 
 	return success;
 }
 
+Sint64 getModifiedTime( std::string path )
+{
+	struct stat info;
+	if  ( stat( path.c_str(), &info ) != 0 )
+	{
+		return -1;
+	}
+
+	return (Sint64) info.st_mtime;
+}
+
 void close()
 {
+	//  Report what partial uploads saved
+	printf(
+        "Uploaded %llu of %llu frame bytes\n"  ,
+        (unsigned long long) gUploadedBytes     ,
+        (unsigned long long) gFrameBytes
+    );
+
 	//  Free loaded images
 	gStreamingTexture.free();
 	gDataStream.free();
+	gFrameFile.close();
 
 	//  Destroy window	
 	SDL_DestroyRenderer ( gRenderer );
@@ -663,10 +1386,21 @@ int main( int /*argc*/, char* /*args*/[] )
 				SDL_SetRenderDrawColor  ( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 				SDL_RenderClear         ( gRenderer );
 
-				//  Copy frame from buffer
-				gStreamingTexture.lockTexture();
-				gStreamingTexture.copyPixels( gDataStream.getBuffer() );
-				gStreamingTexture.unlockTexture();
+				//  Upload the tiles that changed, only when a new frame was decoded
+				LPixelView frame;
+				if  (
+                        gDataStream.getFrame( &frame )                          &&
+                        frame.getWidth()    == gStreamingTexture.getWidth()     &&
+                        frame.getHeight()   == gStreamingTexture.getHeight()
+                    )
+				{
+					int         width   = gStreamingTexture.getWidth();
+					LPixelView  shown( &gShownPixels[ 0 ], width * 4, width, gStreamingTexture.getHeight() );
+
+					gDirtyTiles.markChanged( shown, frame );
+					gUploadedBytes  += gStreamingTexture.updateTexture( shown.getRow( 0 ), width * 4, gDirtyTiles );
+					gFrameBytes     += gShownPixels.size() * 4;
+				}
 
 				//  Render frame
 				gStreamingTexture.render( ( SCREEN_WIDTH - gStreamingTexture.getWidth() ) / 2, ( SCREEN_HEIGHT - gStreamingTexture.getHeight() ) / 2 );
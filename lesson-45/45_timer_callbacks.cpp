@@ -1,16 +1,32 @@
 /*  This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.    */
 
-//  Using SDL, SDL_image, standard IO, and, strings
+//  Using SDL, SDL_image, standard IO, strings, and, vectors
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
 #include <string>
+#include <vector>
+
+//  Using the shared pixel kernels, pixel views and timer wheel
+#include "../share/LPixelKernels.h"
+#include "../share/LPixelView.h"
+#include "../share/LTimerWheel.h"
 
 //Screen dimension constants
 const int SCREEN_WIDTH  = 640;
 const int SCREEN_HEIGHT = 480;
 
+//  Timers the benchmark schedules and the longest delay it gives them
+const int BENCH_TIMERS      = 1000000;
+const int BENCH_MAX_DELAY   = 60 * 1000;
+
+//  Milliseconds between benchmark frames
+const int BENCH_FRAME_MS    = 16;
+
+//  SDL timers the benchmark adds and removes to compare
+const int BENCH_SDL_TIMERS  = 10000;
+
 //  Texture wrapper class
 class LTexture
 {
@@ -61,6 +77,7 @@ class LTexture
 		void    copyPixels( void* pixels );
 		int     getPitch();
 		Uint32  getPixel32( unsigned int x, unsigned int y );
+		LPixelView  getPixelView();
 
 	private:
 		//  The actual hardware texture
@@ -85,6 +102,9 @@ void close();
 //  Our test callback function
 Uint32 callback( Uint32 interval, void* param );
 
+//  Times a million timers through the wheel, and SDL_AddTimer for scale
+void benchmark();
+
 //  The window we'll be rendering to
 SDL_Window*     gWindow     = NULL;
 
@@ -94,6 +114,9 @@ SDL_Renderer*   gRenderer   = NULL;
 //  Scene textures
 LTexture gSplashTexture;
 
+//  Timers fired on the game thread
+LTimerWheel gTimers;
+
 LTexture::LTexture()
 {
 	//  Initialize
@@ -187,8 +210,7 @@ bool LTexture::loadFromFile( std::string path )
 				mHeight = formattedSurface->h;
 
 				//  Get pixel data in editable format
-				Uint32* pixels = (Uint32*)  mPixels;
-				int pixelCount = ( mPitch / 4 ) * mHeight;
+				LPixelView  pixels = getPixelView();
 
 				//  Map colors				
 				Uint32 colorKey     =
@@ -208,13 +230,12 @@ bool LTexture::loadFromFile( std::string path )
                     );
 
 				//  Color key pixels
-				for ( int i = 0; i < pixelCount; ++i )
-				{
-					if  ( pixels[ i ] == colorKey )
-					{
-						pixels[ i ] = transparent;
-					}
-				}
+				pixels.forEachRow(
+                    [&]( std::span<Uint32> row, int /*y*/ )
+                    {
+                        colorKeyPixels( row.data(), (int) row.size(), colorKey, transparent );
+                    }
+                );
 
 				//  Unlock texture to update
 				SDL_UnlockTexture( newTexture );
@@ -455,11 +476,14 @@ int LTexture::getPitch()
 
 Uint32 LTexture::getPixel32( unsigned int x, unsigned int y )
 {
-    //  Convert the pixels to 32 bit
-    Uint32 *pixels = (Uint32*)  mPixels;
-
     //  Get the pixel requested
-    return pixels[ ( y * ( mPitch / 4 ) ) + x ];
+    return getPixelView().at( x, y );
+}
+
+LPixelView LTexture::getPixelView()
+{
+    //  View over the locked pixels
+    return LPixelView( mPixels, mPitch, mWidth, mHeight );
 }
 
 bool init()
@@ -581,7 +605,106 @@ Uint32 callback( Uint32 /*interval*/, void* param )
 	return 0;
 }
 
-int main( int /*argc*/, char* /*args*/[] )
+//  When each benchmark timer is due and how many fired at another time
+std::vector<Uint32> gBenchDue;
+int                 gBenchMissed = 0;
+
+//  Checks a benchmark timer fired when it was due
+Uint32 benchCallback( Uint32 /*interval*/, void* param )
+{
+	if  ( gBenchDue[ (size_t) param ] != gTimers.getTime() )
+	{
+		++gBenchMissed;
+	}
+
+	return 0;
+}
+
+//  Does nothing, the SDL timers are removed before they fire
+Uint32 benchSDLCallback( Uint32 /*interval*/, void* /*param*/ )
+{
+	return 0;
+}
+
+//  Nanoseconds since start for count operations
+double nsPer( Uint64 start, int count )
+{
+	return ( SDL_GetPerformanceCounter() - start ) * 1e9 / SDL_GetPerformanceFrequency() / count;
+}
+
+void benchmark()
+{
+	std::vector<LTimerID> ids( BENCH_TIMERS );
+	gBenchDue.resize( BENCH_TIMERS );
+	gBenchMissed = 0;
+	gTimers.clear();
+	gTimers.reserve( BENCH_TIMERS );
+
+	//  Schedule a million cooldowns and despawns up to a minute away
+	Uint32 random = 0x2545F491;
+	Uint64 start  = SDL_GetPerformanceCounter();
+	for ( int i = 0; i < BENCH_TIMERS; ++i )
+	{
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		Uint32 delay    = 1 + random % BENCH_MAX_DELAY;
+		gBenchDue[ i ]  = delay;
+		ids[ i ]        = gTimers.add( delay, benchCallback, (void*)(size_t) i );
+	}
+	double addNs = nsPer( start, BENCH_TIMERS );
+
+	//  Cancel every fourth one
+	start = SDL_GetPerformanceCounter();
+	for ( int i = 0; i < BENCH_TIMERS; i += 4 )
+	{
+		gTimers.cancel( ids[ i ] );
+	}
+	double cancelNs = nsPer( start, BENCH_TIMERS / 4 );
+
+	//  Run frames until everything fired
+	int     fired       = 0;
+	double  worstFrame  = 0.0;
+	start = SDL_GetPerformanceCounter();
+	for ( Uint64 time = BENCH_FRAME_MS; gTimers.getCount() > 0; time += BENCH_FRAME_MS )
+	{
+		Uint64 frameStart = SDL_GetPerformanceCounter();
+		fired += gTimers.advanceTo( time );
+
+		double frameMs = ( SDL_GetPerformanceCounter() - frameStart ) * 1000.0 / SDL_GetPerformanceFrequency();
+		worstFrame = frameMs > worstFrame ? frameMs : worstFrame;
+	}
+	double fireNs = fired > 0 ? nsPer( start, fired ) : 0.0;
+
+	printf( "Timer wheel, %d timers up to %d ms away, %d ms frames\n", BENCH_TIMERS, BENCH_MAX_DELAY, BENCH_FRAME_MS );
+	printf( "    add     %8.1f ns per timer\n", addNs );
+	printf( "    cancel  %8.1f ns per timer\n", cancelNs );
+	printf( "    fire    %8.1f ns per timer, %d fired, %d not on time, worst frame %.2f ms\n", fireNs, fired, gBenchMissed, worstFrame );
+
+	//  SDL timers, added and removed before any can fire
+	std::vector<SDL_TimerID> sdlIds( BENCH_SDL_TIMERS );
+	start = SDL_GetPerformanceCounter();
+	for ( int i = 0; i < BENCH_SDL_TIMERS; ++i )
+	{
+		sdlIds[ i ] = SDL_AddTimer( BENCH_MAX_DELAY, benchSDLCallback, NULL );
+	}
+	addNs = nsPer( start, BENCH_SDL_TIMERS );
+
+	start = SDL_GetPerformanceCounter();
+	for ( int i = 0; i < BENCH_SDL_TIMERS; ++i )
+	{
+		SDL_RemoveTimer( sdlIds[ i ] );
+	}
+	cancelNs = nsPer( start, BENCH_SDL_TIMERS );
+
+	printf( "SDL_AddTimer, %d timers\n", BENCH_SDL_TIMERS );
+	printf( "    add     %8.1f ns per timer\n", addNs );
+	printf( "    remove  %8.1f ns per timer\n", cancelNs );
+
+	gTimers.clear();
+}
+
+int main( int argc, char* args[] )
 {
 	//  Start up SDL and create window
 	if  ( !init() )
@@ -595,6 +718,11 @@ int main( int /*argc*/, char* /*args*/[] )
 		{
 			printf( "Failed to load media!\n" );
 		}
+		//  Time the timers instead of running the demo
+		else if ( argc > 1 && std::string( args[ 1 ] ) == "--bench" )
+		{
+			benchmark();
+		}
 		else
 		{	
 			//  Main loop flag
@@ -603,9 +731,10 @@ int main( int /*argc*/, char* /*args*/[] )
 			//  Event handler
 			SDL_Event e;
 
-			//  Set callback
-			SDL_TimerID timerID =
-                SDL_AddTimer(
+			//  Set callback, the frame loop will fire it
+			gTimers.start();
+			LTimerID timerID =
+                gTimers.add(
                     3 * 1000        ,
                     callback        ,
                     (void*) "3 seconds waited!"
@@ -624,6 +753,9 @@ int main( int /*argc*/, char* /*args*/[] )
 					}
 				}
 
+				//  Fire the timers that came due since last frame
+				gTimers.update();
+
 				//  Clear screen
 				SDL_SetRenderDrawColor( gRenderer, 0x22, 0x22, 0x22, 0xFF );
 				SDL_RenderClear( gRenderer );
@@ -636,7 +768,7 @@ int main( int /*argc*/, char* /*args*/[] )
 			}
 
 			//  Remove timer in case the call back was not called
-			SDL_RemoveTimer( timerID );
+			gTimers.cancel( timerID );
 		}
 	}
 
@@ -1,12 +1,19 @@
 /*  This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.*/
 
-//  Using SDL, SDL Threads, SDL_image, standard IO, and, strings
+//  Using SDL, SDL Threads, SDL_image, standard IO, strings, and deques
 #include <SDL.h>
 #include <SDL_thread.h>
 #include <SDL_image.h>
 #include <stdio.h>
 #include <string>
+#include <deque>
+#include <vector>
+
+//  Using the shared pixel kernels, pixel views and job system
+#include "../share/LPixelKernels.h"
+#include "../share/LPixelView.h"
+#include "../share/LJobSystem.h"
 
 //  Screen dimension constants
 const int SCREEN_WIDTH  = 640;
@@ -24,6 +31,9 @@ class LTexture
 
 		//  Loads image at specified path
 		bool loadFromFile( std::string path );
+
+		//  Uploads a surface made by decodeImage
+		bool loadFromSurface( SDL_Surface* surface );
 		
 		#if defined(SDL_TTF_MAJOR_VERSION)
 		//  Creates image from font string
@@ -76,6 +86,7 @@ class LTexture
 		void    copyPixels( void* pixels );
 		int     getPitch();
 		Uint32  getPixel32( unsigned int x, unsigned int y );
+		LPixelView  getPixelView();
 
 	private:
 		//  The actual hardware texture
@@ -88,6 +99,88 @@ class LTexture
 		int mHeight;
 };
 
+//  Called on the main thread once an image is uploaded
+typedef void ( *LImageCallback )( LTexture* texture, bool success, void* data );
+
+//  Decodes images on worker threads and uploads them on the main thread
+class LImageLoader
+{
+	public:
+		//  Initializes variables
+		LImageLoader();
+
+		//  Stops the workers
+		~LImageLoader();
+
+		//  Starts the workers, one per core by default
+		bool start( int workerCount = 0 );
+
+		//  Stops the workers and drops unfinished images
+		void stop();
+
+		//  Queues an image to be loaded into the texture
+		void load(
+                LTexture*       texture             ,
+                std::string     path                ,
+                LImageCallback  callback    = NULL  ,
+                void*           data        = NULL
+            );
+
+		//  Uploads decoded images, call from the main thread every frame.
+		//  Returns the number of images uploaded
+		int upload( int maxUploads = -1 );
+
+		//  Uploads until every queued image is done
+		void finish();
+
+		//  Gets the number of images not uploaded yet
+		int getPending();
+
+		//  Gets the texture if it is loaded, the placeholder otherwise
+		LTexture* ready( LTexture* texture );
+
+	private:
+		//  One queued image
+		struct Job
+		{
+			LTexture*       texture;
+			std::string     path;
+			LImageCallback  callback;
+			void*           data;
+			SDL_Surface*    surface;
+		};
+
+		//  Worker thread entry point
+		static int workerFunction( void* loader );
+
+		//  Worker threads
+		std::vector<SDL_Thread*>    mWorkers;
+
+		//  Images waiting to be decoded and images waiting to be uploaded
+		std::deque<Job>     mDecodeQueue;
+		std::deque<Job>     mUploadQueue;
+
+		//  Protects both queues and the quit flag
+		SDL_mutex*  mLock;
+
+		//  Signaled when images are queued or the workers must quit
+		SDL_cond*   mCanDecode;
+
+		//  Signaled when an image is decoded
+		SDL_cond*   mCanUpload;
+
+		//  Images not uploaded yet
+		int         mPending;
+		bool        mQuit;
+
+		//  Shown until the real texture is ready
+		LTexture    mPlaceholder;
+};
+
+//  Decodes an image into a color keyed RGBA8888 surface,
+//	safe to call from any thread
+SDL_Surface* decodeImage( std::string path );
+
 //  Starts up SDL and creates window
 bool init();
 
@@ -97,8 +190,15 @@ bool loadMedia();
 //  Frees media and shuts down SDL
 void close();
 
-//  Our test thread function
-int threadFunction( void* data );
+//  Our test job
+void threadJob( void* data, int begin, int end );
+
+//  Times a pixel kernel on one thread and across the job system,
+//	and how long jobs take to run
+void benchmark();
+
+//  Reports the splash texture once it is uploaded
+void splashLoaded( LTexture* texture, bool success, void* data );
 
 //  The window we'll be rendering to
 SDL_Window*     gWindow     = NULL;
@@ -109,6 +209,12 @@ SDL_Renderer*   gRenderer   = NULL;
 //  Scene textures
 LTexture gSplashTexture;
 
+//  Loads scene textures in the background
+LImageLoader gImageLoader;
+
+//  Runs work on every core
+LJobSystem gJobs;
+
 LTexture::LTexture()
 {
 	//  Initialize
@@ -130,120 +236,68 @@ bool LTexture::loadFromFile( std::string path )
 	//  Get rid of preexisting texture
 	free();
 
+	//  Decode and upload on this thread
+	SDL_Surface*    formattedSurface = decodeImage( path );
+	if  ( formattedSurface != NULL )
+	{
+		loadFromSurface( formattedSurface );
+
+		//  Get rid of old formatted surface
+		SDL_FreeSurface( formattedSurface );
+	}
+
+	//  Return success
+	return mTexture != NULL;
+}
+
+bool LTexture::loadFromSurface( SDL_Surface* surface )
+{
+	//  Get rid of preexisting texture
+	free();
+
 	//  The final texture
-	SDL_Texture*    newTexture = NULL;
+	SDL_Texture*    newTexture =
+        SDL_CreateTexture(
+            gRenderer                   ,
+            SDL_PIXELFORMAT_RGBA8888    ,
+            SDL_TEXTUREACCESS_STREAMING ,
+            surface->w                  ,
+            surface->h
+        );
 
-	//  Load image at specified path
-	SDL_Surface*    loadedSurface = IMG_Load( path.c_str() );
-	if  ( loadedSurface == NULL )
+	if  ( newTexture == NULL )
 	{
 		printf(
-            "Unable to load image %s! SDL_image Error: %s\n"    ,
-            path.c_str()                                        ,
-            IMG_GetError()
+            "Unable to create blank texture! SDL Error: %s\n"   ,
+            SDL_GetError()
         );
 	}
 	else
 	{
-		//  Convert surface to display format
-		SDL_Surface*    formattedSurface =
-            SDL_ConvertSurfaceFormat(
-                loadedSurface               ,
-                SDL_PIXELFORMAT_RGBA8888    ,
-                0
-            );
+		//  Enable blending on texture
+		SDL_SetTextureBlendMode( newTexture, SDL_BLENDMODE_BLEND );
 
-		if  ( formattedSurface == NULL )
+		//  Lock texture for manipulation
+		SDL_LockTexture( newTexture, NULL, &mPixels, &mPitch );
+
+		//  Copy surface pixels row by row, the pitches may differ
+		for ( int y = 0; y < surface->h; ++y )
 		{
-			printf(
-                "Unable to convert loaded surface to display format! %s\n"  ,
-                SDL_GetError()
+			memcpy(
+                (Uint8*) mPixels            + y * mPitch            ,
+                (Uint8*) surface->pixels    + y * surface->pitch    ,
+                surface->w * 4
             );
 		}
-		else
-		{
-			//  Create blank streamable texture
-			newTexture =
-                SDL_CreateTexture(
-                    gRenderer                   ,
-                    SDL_PIXELFORMAT_RGBA8888    ,
-                    SDL_TEXTUREACCESS_STREAMING ,
-                    formattedSurface->w         ,
-                    formattedSurface->h
-                );
-
-			if  ( newTexture == NULL )
-			{
-				printf(
-                    "Unable to create blank texture! SDL Error: %s\n"   ,
-                    SDL_GetError()
-                );
-			}
-			else
-			{
-				//  Enable blending on texture
-				SDL_SetTextureBlendMode( newTexture, SDL_BLENDMODE_BLEND );
-
-				//  Lock texture for manipulation
-				SDL_LockTexture(
-                    newTexture                      ,
-                    &formattedSurface->clip_rect    ,
-                    &mPixels                        ,
-                    &mPitch
-                );
-
-				//  Copy loaded/formatted surface pixels
-				memcpy(
-                    mPixels                         ,
-                    formattedSurface->pixels        ,
-                    formattedSurface->pitch * formattedSurface->h
-                );
 
-				//  Get image dimensions
-				mWidth  = formattedSurface->w;
-				mHeight = formattedSurface->h;
-
-				//  Get pixel data in editable format
-				Uint32* pixels = (Uint32*) mPixels;
-				int pixelCount = ( mPitch / 4 ) * mHeight;
-
-				//  Map colors				
-				Uint32  colorKey    =
-                    SDL_MapRGB (
-                        formattedSurface->format    ,
-                        0                           ,
-                        0xFF                        ,
-                        0xFF
-                    );
-				Uint32  transparent =
-                    SDL_MapRGBA(
-                        formattedSurface->format    ,
-                        0x00                        ,
-                        0xFF                        ,
-                        0xFF                        ,
-                        0x00
-                    );
-
-				//  Color key pixels
-				for ( int i = 0; i < pixelCount; ++i )
-				{
-					if  ( pixels[ i ] == colorKey )
-					{
-						pixels[ i ] = transparent;
-					}
-				}
-
-				//  Unlock texture to update
-				SDL_UnlockTexture( newTexture );
-				mPixels = NULL;
-			}
+		//  Unlock texture to update
+		SDL_UnlockTexture( newTexture );
+		mPixels = NULL;
+		mPitch  = 0;
 
-			//  Get rid of old formatted surface
-			SDL_FreeSurface( formattedSurface );
-		}	
-		
-		//  Get rid of old loaded surface
-		SDL_FreeSurface( loadedSurface );
+		//  Get image dimensions
+		mWidth  = surface->w;
+		mHeight = surface->h;
 	}
 
 	//  Return success
@@ -477,11 +531,310 @@ int LTexture::getPitch()
 
 Uint32 LTexture::getPixel32( unsigned int x, unsigned int y )
 {
-    //  Convert the pixels to 32 bit
-    Uint32 *    pixels = (Uint32*) mPixels;
-
     //  Get the pixel requested
-    return pixels[ ( y * ( mPitch / 4 ) ) + x ];
+    return getPixelView().at( x, y );
+}
+
+LPixelView LTexture::getPixelView()
+{
+    //  View over the locked pixels
+    return LPixelView( mPixels, mPitch, mWidth, mHeight );
+}
+
+SDL_Surface* decodeImage( std::string path )
+{
+	//  The final surface
+	SDL_Surface*    formattedSurface = NULL;
+
+	//  Load image at specified path
+	SDL_Surface*    loadedSurface = IMG_Load( path.c_str() );
+	if  ( loadedSurface == NULL )
+	{
+		printf(
+            "Unable to load image %s! SDL_image Error: %s\n"    ,
+            path.c_str()                                        ,
+            IMG_GetError()
+        );
+	}
+	else
+	{
+		//  Convert surface to display format
+		formattedSurface =
+            SDL_ConvertSurfaceFormat(
+                loadedSurface               ,
+                SDL_PIXELFORMAT_RGBA8888    ,
+                0
+            );
+
+		if  ( formattedSurface == NULL )
+		{
+			printf(
+                "Unable to convert loaded surface to display format! %s\n"  ,
+                SDL_GetError()
+            );
+		}
+		else
+		{
+			//  Map colors
+			Uint32  colorKey    =
+                SDL_MapRGB (
+                    formattedSurface->format    ,
+                    0                           ,
+                    0xFF                        ,
+                    0xFF
+                );
+			Uint32  transparent =
+                SDL_MapRGBA(
+                    formattedSurface->format    ,
+                    0x00                        ,
+                    0xFF                        ,
+                    0xFF                        ,
+                    0x00
+                );
+
+			//  Get pixel data in editable format
+			LPixelView  pixels(
+                            formattedSurface->pixels    ,
+                            formattedSurface->pitch     ,
+                            formattedSurface->w         ,
+                            formattedSurface->h
+                        );
+
+			//  Color key pixels
+			pixels.forEachRow(
+                [&]( std::span<Uint32> row, int /*y*/ )
+                {
+                    colorKeyPixels( row.data(), (int) row.size(), colorKey, transparent );
+                }
+            );
+		}
+
+		//  Get rid of old loaded surface
+		SDL_FreeSurface( loadedSurface );
+	}
+
+	return formattedSurface;
+}
+
+LImageLoader::LImageLoader()
+{
+	//  Initialize
+	mLock       = NULL;
+	mCanDecode  = NULL;
+	mCanUpload  = NULL;
+	mPending    = 0;
+	mQuit       = false;
+}
+
+LImageLoader::~LImageLoader()
+{
+	//  Deallocate
+	stop();
+}
+
+bool LImageLoader::start( int workerCount )
+{
+	//  One worker per core by default
+	if  ( workerCount <= 0 )
+	{
+		workerCount = SDL_GetCPUCount();
+	}
+
+	//  Create the synchronization objects
+	mLock       = SDL_CreateMutex();
+	mCanDecode  = SDL_CreateCond();
+	mCanUpload  = SDL_CreateCond();
+	mQuit       = false;
+
+	if  ( mLock == NULL || mCanDecode == NULL || mCanUpload == NULL )
+	{
+		printf( "Unable to create loader locks! SDL Error: %s\n", SDL_GetError() );
+		return false;
+	}
+
+	//  Magenta and grey checkerboard placeholder
+	if  ( mPlaceholder.createBlank( 32, 32 ) && mPlaceholder.lockTexture() )
+	{
+		mPlaceholder.getPixelView().forEachRow(
+            []( std::span<Uint32> row, int y )
+            {
+                for ( int x = 0; x < (int) row.size(); ++x )
+                {
+                    row[ x ] = ( ( x / 8 + y / 8 ) % 2 ) ? 0xFF00FFFF : 0x808080FF;
+                }
+            }
+        );
+		mPlaceholder.unlockTexture();
+	}
+
+	//  Start the workers
+	for ( int i = 0; i < workerCount; ++i )
+	{
+		SDL_Thread* worker = SDL_CreateThread( workerFunction, "LazyLoader", this );
+		if  ( worker == NULL )
+		{
+			printf( "Unable to create loader thread! SDL Error: %s\n", SDL_GetError() );
+			break;
+		}
+		mWorkers.push_back( worker );
+	}
+
+	return !mWorkers.empty();
+}
+
+void LImageLoader::stop()
+{
+	if  ( mLock == NULL )
+	{
+		return;
+	}
+
+	//  Tell the workers to quit
+	SDL_LockMutex( mLock );
+	mQuit = true;
+	SDL_CondBroadcast( mCanDecode );
+	SDL_UnlockMutex( mLock );
+
+	for ( SDL_Thread* worker : mWorkers )
+	{
+		SDL_WaitThread( worker, NULL );
+	}
+	mWorkers.clear();
+
+	//  Drop unfinished images
+	for ( Job& job : mUploadQueue )
+	{
+		SDL_FreeSurface( job.surface );
+	}
+	mDecodeQueue.clear();
+	mUploadQueue.clear();
+	mPending = 0;
+
+	mPlaceholder.free();
+
+	SDL_DestroyCond ( mCanUpload );
+	SDL_DestroyCond ( mCanDecode );
+	SDL_DestroyMutex( mLock );
+	mCanUpload  = NULL;
+	mCanDecode  = NULL;
+	mLock       = NULL;
+}
+
+void LImageLoader::load( LTexture* texture, std::string path, LImageCallback callback, void* data )
+{
+	Job job = { texture, path, callback, data, NULL };
+
+	//  Hand the image to a worker
+	SDL_LockMutex( mLock );
+	mDecodeQueue.push_back( job );
+	++mPending;
+	SDL_CondSignal( mCanDecode );
+	SDL_UnlockMutex( mLock );
+}
+
+int LImageLoader::upload( int maxUploads )
+{
+	int uploaded = 0;
+
+	while   ( maxUploads < 0 || uploaded < maxUploads )
+	{
+		//  Take the next decoded image
+		SDL_LockMutex( mLock );
+		if  ( mUploadQueue.empty() )
+		{
+			SDL_UnlockMutex( mLock );
+			break;
+		}
+		Job job = mUploadQueue.front();
+		mUploadQueue.pop_front();
+		SDL_UnlockMutex( mLock );
+
+		//  Create the texture, the renderer only works on this thread
+		bool success = false;
+		if  ( job.surface != NULL )
+		{
+			success = job.texture->loadFromSurface( job.surface );
+			SDL_FreeSurface( job.surface );
+		}
+
+		SDL_LockMutex( mLock );
+		--mPending;
+		SDL_UnlockMutex( mLock );
+
+		if  ( job.callback != NULL )
+		{
+			job.callback( job.texture, success, job.data );
+		}
+
+		++uploaded;
+	}
+
+	return uploaded;
+}
+
+void LImageLoader::finish()
+{
+	while   ( getPending() > 0 )
+	{
+		//  Sleep until a worker has something to upload
+		SDL_LockMutex( mLock );
+		while   ( mUploadQueue.empty() && mPending > 0 )
+		{
+			SDL_CondWait( mCanUpload, mLock );
+		}
+		SDL_UnlockMutex( mLock );
+
+		upload();
+	}
+}
+
+int LImageLoader::getPending()
+{
+	SDL_LockMutex( mLock );
+	int pending = mPending;
+	SDL_UnlockMutex( mLock );
+
+	return pending;
+}
+
+LTexture* LImageLoader::ready( LTexture* texture )
+{
+	return texture->getWidth() > 0 ? texture : &mPlaceholder;
+}
+
+int LImageLoader::workerFunction( void* loader )
+{
+	LImageLoader*   self = (LImageLoader*) loader;
+
+	SDL_LockMutex( self->mLock );
+	while   ( true )
+	{
+		//  Wait for work
+		while   ( self->mDecodeQueue.empty() && !self->mQuit )
+		{
+			SDL_CondWait( self->mCanDecode, self->mLock );
+		}
+
+		if  ( self->mQuit )
+		{
+			break;
+		}
+
+		Job job = self->mDecodeQueue.front();
+		self->mDecodeQueue.pop_front();
+
+		//  Decode without holding the lock
+		SDL_UnlockMutex( self->mLock );
+		job.surface = decodeImage( job.path );
+		SDL_LockMutex( self->mLock );
+
+		//  Pass it back to the main thread
+		self->mUploadQueue.push_back( job );
+		SDL_CondSignal( self->mCanUpload );
+	}
+	SDL_UnlockMutex( self->mLock );
+
+	return 0;
 }
 
 bool init()
@@ -570,18 +923,33 @@ bool loadMedia()
 	//  Loading success flag
 	bool success = true;
 	
-	//  Load splash texture
-	if  ( !gSplashTexture.loadFromFile( "./splash.png" ) )
+	//  Start the image workers
+	if  ( !gImageLoader.start() )
 	{
-		printf( "Failed to load splash texture!\n" );
+		printf( "Failed to start image loader!\n" );
+		success = false;
+	}
+	//  Start the job workers
+	else if ( !gJobs.start() )
+	{
+		printf( "Failed to start job system!\n" );
 		success = false;
 	}
+	else
+	{
+		//  Load splash texture in the background
+		gImageLoader.load( &gSplashTexture, "./splash.png", splashLoaded );
+	}
 
 	return success;
 }
 
 void close()
 {
+	//  Stop loading images and running jobs
+	gImageLoader.stop();
+	gJobs.stop();
+
 	//  Free loaded images
 	gSplashTexture.free();
 
@@ -596,15 +964,92 @@ void close()
 	SDL_Quit();
 }
 
-int threadFunction( void* data )
+void threadJob( void* data, int /*begin*/, int /*end*/ )
 {
 	//  Print incoming data
-	printf( "Running thread with value = %d\n", * (int*) data );
+	printf( "Running job with value = %d\n", * (int*) data );
+}
 
-	return 0;
+//  Pixels and alpha mask the benchmark kernel runs over
+struct BenchPixels
+{
+	Uint32* pixels;
+	int     width;
+	Uint32  alphaMask;
+};
+
+//  Premultiplies rows begin to end
+void premultiplyRows( void* data, int begin, int end )
+{
+	BenchPixels* bench = (BenchPixels*) data;
+	premultiplyPixels( bench->pixels + begin * bench->width, ( end - begin ) * bench->width, bench->alphaMask );
+}
+
+//  Does nothing, to time the jobs themselves
+void emptyJob( void* /*data*/, int /*begin*/, int /*end*/ )
+{
+}
+
+void benchmark()
+{
+	const int   WIDTH       = 2048;
+	const int   HEIGHT      = 2048;
+	const int   PASSES      = 20;
+	const int   JOBS        = 100000;
+
+	//  A 2048 x 2048 RGBA8888 frame
+	std::vector<Uint32> pixels( WIDTH * HEIGHT );
+	for ( size_t i = 0; i < pixels.size(); ++i )
+	{
+		pixels[ i ] = (Uint32) rand();
+	}
+	BenchPixels bench = { pixels.data(), WIDTH, 0x000000FF };
+
+	printf( "%d workers\n", gJobs.getWorkerCount() );
+
+	//  The whole frame on this thread
+	Uint64 start = SDL_GetPerformanceCounter();
+	for ( int pass = 0; pass < PASSES; ++pass )
+	{
+		premultiplyRows( &bench, 0, HEIGHT );
+	}
+	double single = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency() / PASSES;
+
+	//  Rows of it across the workers
+	start = SDL_GetPerformanceCounter();
+	for ( int pass = 0; pass < PASSES; ++pass )
+	{
+		gJobs.parallelFor( 0, HEIGHT, 32, premultiplyRows, &bench );
+	}
+	double parallel = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency() / PASSES;
+
+	printf( "Premultiply %dx%d: %.2f ms on one thread, %.2f ms with parallelFor, %.1fx\n", WIDTH, HEIGHT, single, parallel, single / parallel );
+
+	//  Many empty jobs, queued in batches the deque can hold
+	LJobCounter counter;
+	start = SDL_GetPerformanceCounter();
+	for ( int done = 0; done < JOBS; done += JOB_QUEUE_SIZE / 2 )
+	{
+		for ( int i = done; i < SDL_min( done + JOB_QUEUE_SIZE / 2, JOBS ); ++i )
+		{
+			gJobs.run( emptyJob, NULL, &counter );
+		}
+		gJobs.wait( &counter );
+	}
+	double ns = ( SDL_GetPerformanceCounter() - start ) * 1e9 / SDL_GetPerformanceFrequency() / JOBS;
+
+	printf( "Empty jobs: %.0f ns each\n", ns );
 }
 
-int main( int /*argc*/, char* /*args*/[] )
+void splashLoaded( LTexture* /*texture*/, bool success, void* /*data*/ )
+{
+	if  ( !success )
+	{
+		printf( "Failed to load splash texture!\n" );
+	}
+}
+
+int main( int argc, char* args[] )
 {
 	//  Start up SDL and create window
 	if  ( !init() )
@@ -618,6 +1063,11 @@ int main( int /*argc*/, char* /*args*/[] )
 		{
 			printf( "Failed to load media!\n" );
 		}
+		//  Time the job system instead of running the demo
+		else if ( argc > 1 && std::string( args[ 1 ] ) == "--bench" )
+		{
+			benchmark();
+		}
 		else
 		{	
 			//  Main loop flag
@@ -626,14 +1076,10 @@ int main( int /*argc*/, char* /*args*/[] )
 			//  Event handler
 			SDL_Event e;
 
-			//  Run the thread
+			//  Run the job on whichever worker is free
 			int             data    = 101;
-			SDL_Thread*     threadID=
-                SDL_CreateThread(
-                    threadFunction  ,
-                    "LazyThread"    ,
-                    (void*) &data
-                );
+			LJobCounter     threadJobs;
+			gJobs.run( threadJob, &data, &threadJobs );
 
 			//  While application is running
 			while   ( !quit )
@@ -652,15 +1098,18 @@ int main( int /*argc*/, char* /*args*/[] )
 				SDL_SetRenderDrawColor  ( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 				SDL_RenderClear         ( gRenderer );
 
-				//  Render prompt
-				gSplashTexture.render( 0, 0 );
+				//  Upload images decoded since last frame
+				gImageLoader.upload();
+
+				//  Render prompt, or the placeholder until it is loaded
+				gImageLoader.ready( &gSplashTexture )->render( 0, 0 );
 
 				//  Update screen
 				SDL_RenderPresent( gRenderer );
 			}
 
-			//  Remove timer in case the call back was not called
-			SDL_WaitThread( threadID, NULL );
+			//  Make sure the job is done before its data goes
+			gJobs.wait( &threadJobs );
 		}
 	}
 
@@ -8,6 +8,10 @@ and may not be redistributed without written permission.    */
 #include <stdio.h>
 #include <string>
 
+//  Using the shared pixel kernels and pixel views
+#include "../share/LPixelKernels.h"
+#include "../share/LPixelView.h"
+
 //  Screen dimension constants
 const int SCREEN_WIDTH  = 640;
 const int SCREEN_HEIGHT = 480;
@@ -76,6 +80,7 @@ class LTexture
 		void    copyPixels( void* pixels );
 		int     getPitch();
 		Uint32  getPixel32( unsigned int x, unsigned int y );
+		LPixelView  getPixelView();
 
 	private:
 		//  The actual hardware texture
@@ -210,8 +215,7 @@ bool LTexture::loadFromFile( std::string path )
 				mHeight = formattedSurface->h;
 
 				//  Get pixel data in editable format
-				Uint32* pixels = (Uint32*) mPixels;
-				int pixelCount = ( mPitch / 4 ) * mHeight;
+				LPixelView  pixels = getPixelView();
 
 				//  Map colors				
 				Uint32 colorKey     =
@@ -231,13 +235,12 @@ bool LTexture::loadFromFile( std::string path )
                     );
 
 				//  Color key pixels
-				for ( int i = 0; i < pixelCount; ++i )
-				{
-					if  ( pixels[ i ] == colorKey )
-					{
-						pixels[ i ] = transparent;
-					}
-				}
+				pixels.forEachRow(
+                    [&]( std::span<Uint32> row, int /*y*/ )
+                    {
+                        colorKeyPixels( row.data(), (int) row.size(), colorKey, transparent );
+                    }
+                );
 
 				//  Unlock texture to update
 				SDL_UnlockTexture( newTexture );
@@ -467,11 +470,14 @@ int LTexture::getPitch()
 
 Uint32 LTexture::getPixel32( unsigned int x, unsigned int y )
 {
-    //  Convert the pixels to 32 bit
-    Uint32 *pixels = (Uint32*)  mPixels;
-
     //  Get the pixel requested
-    return pixels[ ( y * ( mPitch / 4 ) ) + x ];
+    return getPixelView().at( x, y );
+}
+
+LPixelView LTexture::getPixelView()
+{
+    //  View over the locked pixels
+    return LPixelView( mPixels, mPitch, mWidth, mHeight );
 }
 
 bool init()
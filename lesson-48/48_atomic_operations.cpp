@@ -1,17 +1,31 @@
 /*  This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.    */
 
-//  Using SDL, SDL Threads, SDL_image, standard IO, and, strings
+//  Using SDL, SDL Threads, SDL_image, standard IO, strings, and, vectors
 #include <SDL.h>
 #include <SDL_thread.h>
 #include <SDL_image.h>
 #include <stdio.h>
 #include <string>
+#include <vector>
+
+//  Using the shared pixel kernels, pixel views, spin locks and SDL locks
+#include "../share/LPixelKernels.h"
+#include "../share/LPixelView.h"
+#include "../share/LSpinLock.h"
+#include "../share/LSDLLocks.h"
 
 //  Screen dimension constants
 const int SCREEN_WIDTH  = 640;
 const int SCREEN_HEIGHT = 480;
 
+//  Lock and unlock pairs each benchmark run makes, and the thread counts it tries
+const int BENCH_LOCKS       = 1 << 20;
+const int BENCH_THREADS[]   = { 1, 2, 4, 8 };
+
+//  Steps of "work" done while holding the lock
+const int BENCH_WORK        = 16;
+
 //  Texture wrapper class
 class LTexture
 {
@@ -79,6 +93,7 @@ class LTexture
                     unsigned int    x   ,
                     unsigned int    y
                 );
+		LPixelView  getPixelView();
 
 	private:
 		//  The actual hardware texture
@@ -103,6 +118,9 @@ void close();
 //  Our worker function
 int worker  ( void* data );
 
+//  Times each lock with 1 to 8 threads taking it in turn
+void benchmark();
+
 //  The window we'll be rendering to
 SDL_Window*     gWindow     =   NULL;
 
@@ -113,7 +131,7 @@ SDL_Renderer*   gRenderer   =   NULL;
 LTexture gSplashTexture;
 
 //  Data access spin lock
-SDL_SpinLock    gDataLock   =   0;
+LSpinLock       gDataLock;
 
 //  The "data buffer"
 int             gData       =   -1;
@@ -218,8 +236,7 @@ bool LTexture::loadFromFile( std::string path )
 				mHeight = formattedSurface->h;
 
 				//  Get pixel data in editable format
-				Uint32* pixels = (Uint32*)  mPixels;
-				int pixelCount = ( mPitch / 4 ) * mHeight;
+				LPixelView  pixels = getPixelView();
 
 				//  Map colors				
 				Uint32 colorKey     =
@@ -240,13 +257,12 @@ bool LTexture::loadFromFile( std::string path )
                     );
 
 				//  Color key pixels
-				for ( int i = 0; i < pixelCount; ++i )
-				{
-					if  ( pixels[ i ] == colorKey )
-					{
-						pixels[ i ] = transparent;
-					}
-				}
+				pixels.forEachRow(
+                    [&]( std::span<Uint32> row, int /*y*/ )
+                    {
+                        colorKeyPixels( row.data(), (int) row.size(), colorKey, transparent );
+                    }
+                );
 
 				//  Unlock texture to update
 				SDL_UnlockTexture( newTexture );
@@ -492,11 +508,14 @@ int     LTexture::getPitch()
 
 Uint32  LTexture::getPixel32    ( unsigned int  x, unsigned int     y )
 {
-    //  Convert the pixels to 32 bit
-    Uint32 *pixels = (Uint32*)  mPixels;
-
     //  Get the pixel requested
-    return pixels[ ( y * ( mPitch / 4 ) ) + x ];
+    return getPixelView().at( x, y );
+}
+
+LPixelView LTexture::getPixelView()
+{
+    //  View over the locked pixels
+    return LPixelView( mPixels, mPitch, mWidth, mHeight );
 }
 
 bool init()
@@ -624,7 +643,7 @@ int worker( void* data )
 		SDL_Delay( 16 + rand() % 32 );
 		
 		//  Lock
-		SDL_AtomicLock( &gDataLock );
+		gDataLock.lock();
 
 		//  Print pre work data
 		printf( "%s gets %d\n"  , (const char*) data, gData );
@@ -636,7 +655,7 @@ int worker( void* data )
 		printf( "%s sets %d\n\n", (const char*) data, gData );
 		
 		//  Unlock
-		SDL_AtomicUnlock( &gDataLock );
+		gDataLock.unlock();
 
 		//  Wait randomly
 		SDL_Delay( 16 + rand() % 640 );
@@ -647,8 +666,95 @@ int worker( void* data )
 	return 0;
 }
 
+//  A lock shared by the benchmark threads and the data it guards
+template<typename Lock>
+struct BenchShared
+{
+	Lock    lock;
+	Uint32  data;
+	int     locksPerThread;
+};
+
+//  Takes the lock over and over, doing a little work each time
+template<typename Lock>
+int benchWorker( void* data )
+{
+	BenchShared<Lock>* shared = (BenchShared<Lock>*) data;
+	for ( int i = 0; i < shared->locksPerThread; ++i )
+	{
+		shared->lock.lock();
+		for ( int step = 0; step < BENCH_WORK; ++step )
+		{
+			shared->data = shared->data * 1664525u + 1013904223u;
+		}
+		shared->lock.unlock();
+	}
+
+	return 0;
+}
 
-int main( int /*argc*/, char* /*args*/[] )
+//  Runs threads workers on shared, returns the nanoseconds per lock and unlock
+template<typename Lock>
+double timeLock( BenchShared<Lock>* shared, int threads )
+{
+	shared->data            = 0;
+	shared->locksPerThread  = BENCH_LOCKS / threads;
+
+	std::vector<SDL_Thread*> running;
+	Uint64 start = SDL_GetPerformanceCounter();
+	for ( int i = 0; i < threads; ++i )
+	{
+		running.push_back( SDL_CreateThread( benchWorker<Lock>, "Bench", shared ) );
+	}
+	for ( SDL_Thread* thread : running )
+	{
+		SDL_WaitThread( thread, NULL );
+	}
+	double seconds = (double)( SDL_GetPerformanceCounter() - start ) / SDL_GetPerformanceFrequency();
+
+	return seconds * 1e9 / ( shared->locksPerThread * threads );
+}
+
+//  Prints what a lock's counts say about how it was taken
+void printStats( const char* name, const LLockStats& stats )
+{
+	printf(
+        "        %-8s %5.1f%% contended, %6.1f pauses and %5.3f sleeps per contended lock\n"   ,
+        name                                                                                    ,
+        stats.acquisitions > 0 ? 100.0 * stats.contended / stats.acquisitions : 0.0             ,
+        stats.contended > 0 ? (double) stats.spins / stats.contended : 0.0                      ,
+        stats.contended > 0 ? (double) stats.parks / stats.contended : 0.0
+    );
+}
+
+void benchmark()
+{
+	printf( "%d lock and unlock pairs with %d steps of work each, ns per pair\n", BENCH_LOCKS, BENCH_WORK );
+	printf( "%7s %10s %10s %10s %10s %10s\n", "threads", "SDL spin", "spin", "ticket", "SDL mutex", "SDL sem" );
+	for ( int threads : BENCH_THREADS )
+	{
+		BenchShared<LSDLSpinLock>   sdlSpin;
+		BenchShared<LSpinLock>      spin;
+		BenchShared<LTicketLock>    ticket;
+		BenchShared<LSDLMutex>      mutex;
+		BenchShared<LSDLSemaphore>  semaphore;
+
+		printf(
+            "%7d %10.1f %10.1f %10.1f %10.1f %10.1f\n"   ,
+            threads                                     ,
+            timeLock( &sdlSpin, threads )               ,
+            timeLock( &spin, threads )                  ,
+            timeLock( &ticket, threads )                ,
+            timeLock( &mutex, threads )                 ,
+            timeLock( &semaphore, threads )
+        );
+		printStats( "spin"  , spin.lock.getStats() );
+		printStats( "ticket", ticket.lock.getStats() );
+	}
+}
+
+
+int main( int argc, char* args[] )
 {
 	//  Start up SDL and create window
 	if  ( !init() )
@@ -662,6 +768,11 @@ int main( int /*argc*/, char* /*args*/[] )
 		{
 			printf( "Failed to load media!\n" );
 		}
+		//  Time the locks instead of running the demo
+		else if ( argc > 1 && std::string( args[ 1 ] ) == "--bench" )
+		{
+			benchmark();
+		}
 		else
 		{	
 			//  Main loop flag
@@ -716,6 +827,9 @@ int main( int /*argc*/, char* /*args*/[] )
 			//  Wait for threads to finish
 			SDL_WaitThread( threadA, NULL );
 			SDL_WaitThread( threadB, NULL );
+
+			//  Say how often the threads got in each other's way
+			printStats( "gDataLock", gDataLock.getStats() );
 		}
 	}
 
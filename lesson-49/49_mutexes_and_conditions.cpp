@@ -1,18 +1,32 @@
 /*  This source code copyrighted by Lazy Foo' Productions (2004-2020)
 and may not be redistributed without written permission.    */
 
-//  Using SDL, SDL Threads, SDL_image, standard IO, and, strings
+//  Using SDL, SDL Threads, SDL_image, standard IO, strings, and, vectors
 #include <SDL.h>
 #include <SDL_thread.h>
 #include <SDL_image.h>
 #include <stdio.h>
 #include <string>
+#include <vector>
+
+//  Using the shared pixel kernels, pixel views and queues
+#include "../share/LPixelKernels.h"
+#include "../share/LPixelView.h"
+#include "../share/LMPMCQueue.h"
 
 //  Screen dimension constants
 const int SCREEN_WIDTH  = 640;
 const int SCREEN_HEIGHT = 480;
 const int SCREEN_FPS    = 60;
 
+//  Items the producer can get ahead of the consumer
+const int DATA_QUEUE_SIZE = 2;
+
+//  Items each benchmark run exchanges and the thread counts it tries
+const int BENCH_ITEMS           = 200000;
+const int BENCH_THREADS[]       = { 1, 2, 4, 8, 16 };
+const int BENCH_QUEUE_SIZE      = 1024;
+
 //  Texture wrapper class
 class LTexture
 {
@@ -77,6 +91,7 @@ class LTexture
 		void    copyPixels      ( void* pixels );
 		int     getPitch        ();
 		Uint32  getPixel32      ( unsigned int x, unsigned int y );
+		LPixelView  getPixelView();
 
 	private:
 		//  The actual hardware texture
@@ -89,6 +104,34 @@ class LTexture
 		int mHeight;
 };
 
+//  One item under a mutex with two conditions, the way this lesson
+//	first exchanged data, kept to compare against
+class LLockedSlot
+{
+	public:
+		//  Initializes an empty slot
+		LLockedSlot();
+
+		//  Frees the mutex and conditions
+		~LLockedSlot();
+
+		//  Fills the slot, waiting for it to be empty
+		void push( int item );
+
+		//  Empties the slot, waiting for it to be full
+		void pop( int* item );
+
+	private:
+		//  The protective mutex and the conditions
+		SDL_mutex*  mLock;
+		SDL_cond*   mCanPush;
+		SDL_cond*   mCanPop;
+
+		//  The "data buffer"
+		int         mData;
+		bool        mFull;
+};
+
 //  Starts up SDL and creates window
 bool init();
 
@@ -104,6 +147,10 @@ int     consumer( void* data );
 void    produce ();
 void    consume ();
 
+//  Times the slot and the queue passing items between 1 to 16
+//	producers and as many consumers
+void benchmark();
+
 //  The window we'll be rendering to
 SDL_Window*     gWindow     = NULL;
 
@@ -113,15 +160,8 @@ SDL_Renderer*   gRenderer   = NULL;
 //  Scene textures
 LTexture        gSplashTexture;
 
-//  The protective mutex
-SDL_mutex*      gBufferLock = NULL;
-
-//  The conditions
-SDL_cond*       gCanProduce = NULL;
-SDL_cond*       gCanConsume = NULL;
-
-//  The "data buffer"
-int             gData       = -1;
+//  The "data buffer", a lock free queue
+LMPMCQueue<int> gQueue;
 
 LTexture::LTexture()
 {
@@ -214,8 +254,7 @@ bool LTexture::loadFromFile( std::string path )
 				mHeight = formattedSurface->h;
 
 				//  Get pixel data in editable format
-				Uint32* pixels = (Uint32*)  mPixels;
-				int pixelCount = ( mPitch / 4 ) * mHeight;
+				LPixelView  pixels = getPixelView();
 
 				//  Map colors				
 				Uint32 colorKey     =
@@ -235,13 +274,12 @@ bool LTexture::loadFromFile( std::string path )
                     );
 
 				//  Color key pixels
-				for ( int i = 0; i < pixelCount; ++i )
-				{
-					if  ( pixels[ i ] == colorKey )
-					{
-						pixels[ i ] = transparent;
-					}
-				}
+				pixels.forEachRow(
+                    [&]( std::span<Uint32> row, int /*y*/ )
+                    {
+                        colorKeyPixels( row.data(), (int) row.size(), colorKey, transparent );
+                    }
+                );
 
 				//  Unlock texture to update
 				SDL_UnlockTexture( newTexture );
@@ -488,11 +526,14 @@ int LTexture::getPitch()
 
 Uint32 LTexture::getPixel32( unsigned int x, unsigned int y )
 {
-    //  Convert the pixels to 32 bit
-    Uint32 *    pixels = (Uint32*)  mPixels;
-
     //  Get the pixel requested
-    return pixels[ ( y * ( mPitch / 4 ) ) + x ];
+    return getPixelView().at( x, y );
+}
+
+LPixelView LTexture::getPixelView()
+{
+    //  View over the locked pixels
+    return LPixelView( mPixels, mPitch, mWidth, mHeight );
 }
 
 bool init()
@@ -581,15 +622,15 @@ bool init()
 
 bool loadMedia()
 {
-	//  Create the mutex
-	gBufferLock = SDL_CreateMutex();
-			
-	//  Create conditions
-	gCanProduce = SDL_CreateCond();
-	gCanConsume = SDL_CreateCond();
-
 	//  Loading success flag
 	bool success = true;
+
+	//  Create the queue
+	if  ( !gQueue.allocate( DATA_QUEUE_SIZE ) )
+	{
+		printf( "Failed to create data queue!\n" );
+		success = false;
+	}
 	
 	//  Load splash texture
 	if  ( !gSplashTexture.loadFromFile( "./splash.png" ) )
@@ -606,15 +647,8 @@ void close()
 	//  Free loaded images
 	gSplashTexture.free();
 
-	//  Destroy the mutex
-	SDL_DestroyMutex( gBufferLock );
-	gBufferLock = NULL;
-			
-	//  Destroy conditions
-	SDL_DestroyCond( gCanProduce );
-	SDL_DestroyCond( gCanConsume );
-	gCanProduce = NULL;
-	gCanConsume = NULL;
+	//  Destroy the queue
+	gQueue.free();
 
 	//  Destroy window	
 	SDL_DestroyRenderer ( gRenderer );
@@ -673,59 +707,182 @@ int consumer    ( void *    /*data*/ )
 
 void produce()
 {
-	//  Lock
-	SDL_LockMutex( gBufferLock );
-	
-	//  If the buffer is full
-	if  ( gData != -1 )
+	//  Fill and show buffer, only waiting when the consumer is behind
+	int data = rand() % 255;
+	if  ( !gQueue.tryPush( data ) )
 	{
-		//  Wait for buffer to be cleared
 		printf(
             "\nProducer encountered full buffer, "
             "waiting for consumer to empty buffer...\n"
         );
-		SDL_CondWait( gCanProduce, gBufferLock );
+		gQueue.push( data );
 	}
-
-	//  Fill and show buffer
-	gData = rand() % 255;
-	printf( "\nProduced %d\n"   , gData );
-	
-	//  Unlock
-	SDL_UnlockMutex ( gBufferLock );
-	
-	//  Signal consumer
-	SDL_CondSignal  ( gCanConsume );
+	printf( "\nProduced %d\n"   , data );
 }
 
 void consume()
 {
-	//  Lock
-	SDL_LockMutex( gBufferLock );
-	
-	//  If the buffer is empty
-	if  ( gData == -1 )
+	//  Show and empty buffer, only waiting when the producer is behind
+	int data;
+	if  ( !gQueue.tryPop( &data ) )
 	{
-		//  Wait for buffer to be filled
 		printf(
             "\nConsumer encountered empty buffer, "
             "waiting for producer to fill buffer...\n"
         );
-		SDL_CondWait( gCanConsume, gBufferLock );
+		gQueue.pop( &data );
+	}
+	printf( "\nConsumed %d\n"   , data );
+}
+
+LLockedSlot::LLockedSlot()
+{
+	mLock       = SDL_CreateMutex();
+	mCanPush    = SDL_CreateCond();
+	mCanPop     = SDL_CreateCond();
+	mData       = -1;
+	mFull       = false;
+}
+
+LLockedSlot::~LLockedSlot()
+{
+	SDL_DestroyMutex( mLock );
+	SDL_DestroyCond( mCanPush );
+	SDL_DestroyCond( mCanPop );
+}
+
+void LLockedSlot::push( int item )
+{
+	//  Lock, and wait for the slot to be emptied
+	SDL_LockMutex( mLock );
+	while   ( mFull )
+	{
+		SDL_CondWait( mCanPush, mLock );
 	}
 
-	//  Show and empty buffer
-	printf( "\nConsumed %d\n"   , gData );
-	gData = -1;
-	
-	//  Unlock
-	SDL_UnlockMutex ( gBufferLock );
-	
-	//  Signal producer
-	SDL_CondSignal  ( gCanProduce );
+	//  Fill
+	mData = item;
+	mFull = true;
+
+	//  Unlock and signal a consumer
+	SDL_UnlockMutex ( mLock );
+	SDL_CondSignal  ( mCanPop );
+}
+
+void LLockedSlot::pop( int* item )
+{
+	//  Lock, and wait for the slot to be filled
+	SDL_LockMutex( mLock );
+	while   ( !mFull )
+	{
+		SDL_CondWait( mCanPop, mLock );
+	}
+
+	//  Empty
+	*item = mData;
+	mFull = false;
+
+	//  Unlock and signal a producer
+	SDL_UnlockMutex ( mLock );
+	SDL_CondSignal  ( mCanPush );
+}
+
+//  One benchmark thread's share of the items and what it saw
+template<typename Queue>
+struct BenchWork
+{
+	Queue*  queue;
+	int     first;
+	int     count;
+	Sint64  sum;
+};
+
+//  Pushes its share of the items
+template<typename Queue>
+int benchProducer( void* data )
+{
+	BenchWork<Queue>* work = (BenchWork<Queue>*) data;
+	for ( int i = work->first; i < work->first + work->count; ++i )
+	{
+		work->queue->push( i );
+	}
+
+	return 0;
+}
+
+//  Pops its share of the items and adds them up
+template<typename Queue>
+int benchConsumer( void* data )
+{
+	BenchWork<Queue>* work = (BenchWork<Queue>*) data;
+	for ( int i = 0; i < work->count; ++i )
+	{
+		int item;
+		work->queue->pop( &item );
+		work->sum += item;
+	}
+
+	return 0;
 }
 
-int main( int /*argc*/, char* /*args*/[] )
+//  Passes BENCH_ITEMS through queue between threads producers and as
+//	many consumers, returns the milliseconds taken or -1 if items went missing
+template<typename Queue>
+double timeExchange( Queue* queue, int threads )
+{
+	std::vector< BenchWork<Queue> > producers( threads ), consumers( threads );
+	std::vector<SDL_Thread*>        running;
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	for ( int i = 0; i < threads; ++i )
+	{
+		int first   = BENCH_ITEMS / threads * i;
+		int count   = i == threads - 1 ? BENCH_ITEMS - first : BENCH_ITEMS / threads;
+		producers[ i ] = { queue, first, count, 0 };
+		consumers[ i ] = { queue, 0, count, 0 };
+		running.push_back( SDL_CreateThread( benchConsumer<Queue>, "Consumer", &consumers[ i ] ) );
+		running.push_back( SDL_CreateThread( benchProducer<Queue>, "Producer", &producers[ i ] ) );
+	}
+	for ( SDL_Thread* thread : running )
+	{
+		SDL_WaitThread( thread, NULL );
+	}
+	double ms = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency();
+
+	//  Every item must come out once
+	Sint64 sum = 0;
+	for ( const BenchWork<Queue>& consumer : consumers )
+	{
+		sum += consumer.sum;
+	}
+
+	return sum == (Sint64) BENCH_ITEMS * ( BENCH_ITEMS - 1 ) / 2 ? ms : -1.0;
+}
+
+void benchmark()
+{
+	printf( "%7s %16s %16s %16s\n", "threads", "mutex slot ms", "queue(2) ms", "queue(1024) ms" );
+	for ( int threads : BENCH_THREADS )
+	{
+		LLockedSlot     slot;
+		LMPMCQueue<int> small, large;
+		if  ( !small.allocate( DATA_QUEUE_SIZE ) || !large.allocate( BENCH_QUEUE_SIZE ) )
+		{
+			return;
+		}
+
+		printf(
+            "%7d %16.1f %16.1f %16.1f\n"       ,
+            threads                             ,
+            timeExchange( &slot, threads )      ,
+            timeExchange( &small, threads )     ,
+            timeExchange( &large, threads )
+        );
+	}
+	printf( "%d items each, x producers and x consumers, -1 means items went missing\n", BENCH_ITEMS );
+}
+
+int main( int argc, char* args[] )
 {
 	//  Start up SDL and create window
 	if  ( !init() )
@@ -739,6 +896,11 @@ int main( int /*argc*/, char* /*args*/[] )
 		{
 			printf( "Failed to load media!\n" );
 		}
+		//  Time the exchanges instead of running the demo
+		else if ( argc > 1 && std::string( args[ 1 ] ) == "--bench" )
+		{
+			benchmark();
+		}
 		else
 		{	
 			//  Main loop flag
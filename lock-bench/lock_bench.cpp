@@ -0,0 +1,417 @@
+/*  Contention benchmark for the locks used by the threading lessons.
+
+    Every SDL primitive that can guard data, the shared locks and their
+    standard C++ equivalents are run through the same sweep of thread
+    counts, critical section lengths and read percentages. For each run
+    it reports throughput, lock wait percentiles and how evenly the
+    threads shared the lock.
+
+    Usage: lock_bench [--csv] [--ms N]
+        --csv   prints comma separated values instead of a table
+        --ms N  runs each combination for N milliseconds         */
+
+//  Using SDL, SDL Threads, standard IO, strings, vectors, algorithms,
+//	atomics, mutexes and semaphores
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <semaphore>
+
+//  Using the shared spin locks and SDL locks
+#include "../share/LSpinLock.h"
+#include "../share/LSDLLocks.h"
+
+//  What the sweep tries
+const int BENCH_THREADS[]       = { 1, 2, 4, 8, 16 };
+const int BENCH_CRITICAL[]      = { 0, 16, 256 };
+const int BENCH_READ_PERCENT[]  = { 0, 90, 99 };
+
+//  Steps of work between two locks, so threads don't just hammer the lock
+const int BENCH_OUTSIDE_WORK    = 64;
+
+//  Words of shared data the critical sections touch
+const int BENCH_DATA_WORDS      = 64;
+
+//  Default milliseconds per combination
+const int BENCH_DEFAULT_MS      = 100;
+
+//  Most waits each thread keeps for the percentiles
+const size_t BENCH_MAX_SAMPLES  = 1 << 20;
+
+//  std::atomic_flag spun on, the standard SDL_AtomicLock
+class LStdSpinLock
+{
+	public:
+		void lock       ()  { while ( mLock.test_and_set( std::memory_order_acquire ) ) {} }
+		void unlock     ()  { mLock.clear( std::memory_order_release ); }
+
+	private:
+		std::atomic_flag mLock;
+};
+
+//  std::binary_semaphore, the standard SDL_sem
+class LStdSemaphore
+{
+	public:
+		LStdSemaphore   ()  : mLock( 1 ) {}
+		void lock       ()  { mLock.acquire(); }
+		void unlock     ()  { mLock.release(); }
+
+	private:
+		std::binary_semaphore mLock;
+};
+
+//  What one run measured
+struct BenchResult
+{
+	//  Operations done and seconds taken
+	Uint64  operations;
+	double  seconds;
+
+	//  Nanoseconds spent waiting for the lock
+	double  p50;
+	double  p99;
+	double  p999;
+	double  max;
+
+	//  Jain's index of the threads' shares, 1 when perfectly even,
+	//	and the smallest and largest share
+	double  fairness;
+	double  minShare;
+	double  maxShare;
+};
+
+//  State shared by one run's threads
+template<typename Lock>
+struct BenchShared
+{
+	Lock                lock;
+	Uint32              data[ BENCH_DATA_WORDS ];
+	int                 criticalWork;
+	int                 readPercent;
+	std::atomic<bool>   go;
+	std::atomic<bool>   stop;
+};
+
+//  One thread's view of a run
+template<typename Lock>
+struct BenchThread
+{
+	BenchShared<Lock>*  shared;
+	Uint32              seed;
+	Uint64              operations;
+	std::vector<Uint32> waits;
+};
+
+//  Takes the lock to read, shared when the lock allows it
+template<typename Lock>
+void lockRead( Lock& lock )
+{
+	if  constexpr ( requires { lock.lock_shared(); } )
+	{
+		lock.lock_shared();
+	}
+	else
+	{
+		lock.lock();
+	}
+}
+
+//  Releases a lock taken with lockRead
+template<typename Lock>
+void unlockRead( Lock& lock )
+{
+	if  constexpr ( requires { lock.unlock_shared(); } )
+	{
+		lock.unlock_shared();
+	}
+	else
+	{
+		lock.unlock();
+	}
+}
+
+//  Next number from a thread's xorshift generator
+inline Uint32 nextRandom( Uint32* state )
+{
+	Uint32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+//  Reads or writes the shared data under the lock until told to stop
+template<typename Lock>
+int benchWorker( void* data )
+{
+	BenchThread<Lock>*  thread  = (BenchThread<Lock>*) data;
+	BenchShared<Lock>*  shared  = thread->shared;
+	Uint32              local   = thread->seed;
+	Uint32              sink    = 0;
+
+	while   ( !shared->go.load( std::memory_order_acquire ) )
+	{
+		cpuPause();
+	}
+
+	while   ( !shared->stop.load( std::memory_order_relaxed ) )
+	{
+		bool    read    = (int)( nextRandom( &thread->seed ) % 100 ) < shared->readPercent;
+		Uint64  start   = SDL_GetPerformanceCounter();
+		if  ( read )
+		{
+			lockRead( shared->lock );
+		}
+		else
+		{
+			shared->lock.lock();
+		}
+		Uint64  waited  = SDL_GetPerformanceCounter() - start;
+
+		//  "Work" on the shared data
+		if  ( read )
+		{
+			for ( int step = 0; step < shared->criticalWork; ++step )
+			{
+				sink += shared->data[ step % BENCH_DATA_WORDS ];
+			}
+			unlockRead( shared->lock );
+		}
+		else
+		{
+			for ( int step = 0; step < shared->criticalWork; ++step )
+			{
+				Uint32& word = shared->data[ step % BENCH_DATA_WORDS ];
+				word = word * 1664525u + 1013904223u;
+			}
+			shared->lock.unlock();
+		}
+
+		if  ( thread->waits.size() < BENCH_MAX_SAMPLES )
+		{
+			thread->waits.push_back( waited < 0xFFFFFFFF ? (Uint32) waited : 0xFFFFFFFF );
+		}
+		++thread->operations;
+
+		//  "Work" on our own
+		for ( int step = 0; step < BENCH_OUTSIDE_WORK; ++step )
+		{
+			local = local * 1664525u + 1013904223u;
+		}
+	}
+
+	//  Keep the work from being optimized away
+	thread->seed ^= local ^ sink;
+
+	return 0;
+}
+
+//  Value at fraction of the way through sorted, in nanoseconds
+double percentile( const std::vector<Uint32>& sorted, double fraction, double nsPerTick )
+{
+	if  ( sorted.empty() )
+	{
+		return 0.0;
+	}
+
+	size_t index = (size_t)( fraction * ( sorted.size() - 1 ) );
+	return sorted[ index ] * nsPerTick;
+}
+
+//  Runs threads threads on a fresh Lock for ms milliseconds
+template<typename Lock>
+BenchResult runLock( int threads, int criticalWork, int readPercent, int ms )
+{
+	BenchShared<Lock>* shared = new BenchShared<Lock>;
+	for ( int i = 0; i < BENCH_DATA_WORDS; ++i )
+	{
+		shared->data[ i ] = i;
+	}
+	shared->criticalWork    = criticalWork;
+	shared->readPercent     = readPercent;
+	shared->go              = false;
+	shared->stop            = false;
+
+	std::vector< BenchThread<Lock> >    workers( threads );
+	std::vector<SDL_Thread*>            running;
+	for ( int i = 0; i < threads; ++i )
+	{
+		workers[ i ].shared     = shared;
+		workers[ i ].seed       = 0x9E3779B9u * ( i + 1 );
+		workers[ i ].operations = 0;
+		workers[ i ].waits.reserve( BENCH_MAX_SAMPLES );
+		running.push_back( SDL_CreateThread( benchWorker<Lock>, "Bench", &workers[ i ] ) );
+	}
+
+	//  Start everyone at once and stop them after ms
+	Uint64 start = SDL_GetPerformanceCounter();
+	shared->go.store( true, std::memory_order_release );
+	SDL_Delay( ms );
+	shared->stop.store( true, std::memory_order_relaxed );
+	for ( SDL_Thread* thread : running )
+	{
+		SDL_WaitThread( thread, NULL );
+	}
+	double seconds = (double)( SDL_GetPerformanceCounter() - start ) / SDL_GetPerformanceFrequency();
+
+	//  Gather every thread's operations and waits
+	BenchResult         result  = BenchResult();
+	std::vector<Uint32> waits;
+	double              squares = 0.0;
+	Uint64              least   = workers[ 0 ].operations;
+	Uint64              most    = workers[ 0 ].operations;
+	for ( const BenchThread<Lock>& worker : workers )
+	{
+		result.operations   += worker.operations;
+		squares             += (double) worker.operations * worker.operations;
+		least                = std::min( least, worker.operations );
+		most                 = std::max( most, worker.operations );
+		waits.insert( waits.end(), worker.waits.begin(), worker.waits.end() );
+	}
+	std::sort( waits.begin(), waits.end() );
+
+	double nsPerTick    = 1e9 / SDL_GetPerformanceFrequency();
+	result.seconds      = seconds;
+	result.p50          = percentile( waits, 0.50, nsPerTick );
+	result.p99          = percentile( waits, 0.99, nsPerTick );
+	result.p999         = percentile( waits, 0.999, nsPerTick );
+	result.max          = percentile( waits, 1.0, nsPerTick );
+	if  ( result.operations > 0 )
+	{
+		double total    = (double) result.operations;
+		result.fairness = total * total / ( threads * squares );
+		result.minShare = least / total;
+		result.maxShare = most / total;
+	}
+
+	delete shared;
+
+	return result;
+}
+
+//  Prints the header for csv or the table
+void printHeader( bool csv )
+{
+	if  ( csv )
+	{
+		printf(
+            "primitive,threads,critical_steps,read_percent,operations,seconds,"
+            "ops_per_second,p50_ns,p99_ns,p999_ns,max_ns,fairness,min_share,max_share\n"
+        );
+	}
+	else
+	{
+		printf(
+            "%-18s %7s %8s %5s %10s %9s %9s %9s %10s %8s\n"                     ,
+            "primitive", "threads", "critical", "read%", "Mops/s"               ,
+            "p50 ns", "p99 ns", "p99.9 ns", "max ns", "fairness"
+        );
+	}
+}
+
+//  Prints one run as csv or a table row
+void printResult( bool csv, const char* name, int threads, int criticalWork, int readPercent, const BenchResult& result )
+{
+	double opsPerSecond = result.seconds > 0.0 ? result.operations / result.seconds : 0.0;
+	if  ( csv )
+	{
+		printf(
+            "%s,%d,%d,%d,%llu,%.6f,%.0f,%.1f,%.1f,%.1f,%.1f,%.4f,%.4f,%.4f\n"   ,
+            name, threads, criticalWork, readPercent                            ,
+            (unsigned long long) result.operations, result.seconds, opsPerSecond,
+            result.p50, result.p99, result.p999, result.max                     ,
+            result.fairness, result.minShare, result.maxShare
+        );
+	}
+	else
+	{
+		printf(
+            "%-18s %7d %8d %5d %10.2f %9.0f %9.0f %9.0f %10.0f %8.3f\n"         ,
+            name, threads, criticalWork, readPercent, opsPerSecond / 1e6        ,
+            result.p50, result.p99, result.p999, result.max, result.fairness
+        );
+	}
+	fflush( stdout );
+}
+
+//  Sweeps every combination for one lock
+template<typename Lock>
+void sweep( bool csv, const char* name, int ms )
+{
+	for ( int threads : BENCH_THREADS )
+	{
+		for ( int criticalWork : BENCH_CRITICAL )
+		{
+			for ( int readPercent : BENCH_READ_PERCENT )
+			{
+				BenchResult result = runLock<Lock>( threads, criticalWork, readPercent, ms );
+				printResult( csv, name, threads, criticalWork, readPercent, result );
+			}
+		}
+	}
+}
+
+int main( int argc, char* args[] )
+{
+	//  Read the options
+	bool    csv = false;
+	int     ms  = BENCH_DEFAULT_MS;
+	for ( int i = 1; i < argc; ++i )
+	{
+		std::string option = args[ i ];
+		if  ( option == "--csv" )
+		{
+			csv = true;
+		}
+		else if ( option == "--ms" && i + 1 < argc && atoi( args[ i + 1 ] ) > 0 )
+		{
+			ms = atoi( args[ ++i ] );
+		}
+		else
+		{
+			printf( "Usage: %s [--csv] [--ms N]\n", args[ 0 ] );
+			return 1;
+		}
+	}
+
+	//  Only the timer is needed
+	if  ( SDL_Init( SDL_INIT_TIMER ) < 0 )
+	{
+		printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
+		return 1;
+	}
+
+	if  ( !csv )
+	{
+		printf( "%d CPUs, %d ms per combination\n", SDL_GetCPUCount(), ms );
+	}
+	printHeader( csv );
+
+	//  SDL primitives that can guard data, SDL_cond needs one of them
+	sweep<LSDLSpinLock>         ( csv, "SDL_SpinLock"       , ms );
+	sweep<LSDLMutex>            ( csv, "SDL_mutex"          , ms );
+	sweep<LSDLSemaphore>        ( csv, "SDL_sem"            , ms );
+
+	//  The shared locks
+	sweep<LSpinLock>            ( csv, "LSpinLock"          , ms );
+	sweep<LTicketLock>          ( csv, "LTicketLock"        , ms );
+
+	//  Standard equivalents
+	sweep<LStdSpinLock>         ( csv, "std::atomic_flag"   , ms );
+	sweep<std::mutex>           ( csv, "std::mutex"         , ms );
+	sweep<std::shared_mutex>    ( csv, "std::shared_mutex"  , ms );
+	sweep<LStdSemaphore>        ( csv, "std::binary_sem"    , ms );
+
+	SDL_Quit();
+
+	return 0;
+}
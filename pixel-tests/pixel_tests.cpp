@@ -0,0 +1,268 @@
+/*  Checks every pixel kernel set this CPU can run against the scalar
+    reference kernels in LPixelKernels.h.
+
+    Every kernel is run over each length up to TEST_SHORT_LENGTHS and a
+    few longer ones, starting up to 28 bytes past an aligned address, so
+    the vector loops, their scalar tails and unaligned loads are all
+    covered. Premultiply runs with each alpha byte and a mask with no
+    alpha, swizzle with all 256 byte orders. Guard pixels on both sides
+    catch writes past the run.
+
+    Usage: pixel_tests
+        prints the first mismatch of each kernel and exits with 1 if
+        any set differs from the scalar kernels                     */
+
+//  Using SDL, standard IO, strings and vectors
+#include <SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+//  Using the shared pixel kernels
+#include "../share/LPixelKernels.h"
+
+//  Every length below this is tried, then the longer ones
+const int TEST_SHORT_LENGTHS    = 72;
+const int TEST_LONG_LENGTHS[]   = { 127, 128, 129, 255, 1000, 1027 };
+const int TEST_MAX_LENGTH       = 1027;
+
+//  Pixels the run starts past an aligned address, up to 28 bytes
+const int TEST_MAX_OFFSET       = 8;
+
+//  Pixels on either side of the run that must not change
+const int TEST_GUARD            = 8;
+const Uint32 TEST_GUARD_PIXEL   = 0xA5C3F00D;
+
+//  Pixels in each buffer
+const int TEST_BUFFER           = TEST_GUARD + TEST_MAX_OFFSET + TEST_MAX_LENGTH + TEST_GUARD;
+
+//  Alpha masks tried, the last has no alpha byte and must change nothing
+const Uint32 TEST_ALPHA_MASKS[] = { 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000, 0x00000000 };
+
+//  Runs and failures of one kernel
+struct LKernelResult
+{
+	const char* name;
+	int         runs;
+	int         failed;
+};
+
+//  Source pixels, what the scalar kernel made and what the tested one made
+alignas( 64 ) Uint32    gSource[ TEST_BUFFER ];
+alignas( 64 ) Uint32    gExpected[ TEST_BUFFER ];
+alignas( 64 ) Uint32    gActual[ TEST_BUFFER ];
+
+//  Marks for the scalar and the tested markNotEqual
+alignas( 64 ) Uint32    gExpectedMarks[ TEST_BUFFER ];
+alignas( 64 ) Uint32    gActualMarks[ TEST_BUFFER ];
+
+//  Xorshift state, the same pixels every run
+Uint32  gSeed = 0x12345678;
+
+//  Gets the next pseudo random number
+Uint32 nextRandom()
+{
+	gSeed ^= gSeed << 13;
+	gSeed ^= gSeed >> 17;
+	gSeed ^= gSeed << 5;
+	return gSeed;
+}
+
+//  Fills a buffer with guard pixels around count pixels at offset. About
+//	a third of them equal key and some have a byte at 0 or 255
+void fillPixels( Uint32* pixels, int offset, int count, Uint32 key )
+{
+	for ( int i = 0; i < TEST_BUFFER; ++i )
+	{
+		pixels[ i ] = TEST_GUARD_PIXEL;
+	}
+
+	Uint32* run = pixels + TEST_GUARD + offset;
+	for ( int i = 0; i < count; ++i )
+	{
+		Uint32  random  = nextRandom();
+		Uint32  byte    = 0xFFu << ( ( ( random >> 8 ) & 3 ) * 8 );
+		switch  ( random % 6 )
+		{
+			case 0:
+			case 1: run[ i ] = key;             break;
+			case 2: run[ i ] = random | byte;   break;
+			case 3: run[ i ] = random & ~byte;  break;
+			default: run[ i ] = random;         break;
+		}
+	}
+}
+
+//  Copies the source into the expected and actual buffers
+void copySource()
+{
+	memcpy( gExpected,  gSource, sizeof( gSource ) );
+	memcpy( gActual,    gSource, sizeof( gSource ) );
+}
+
+//  Compares two whole buffers guards included, prints the first difference
+bool checkPixels(
+        const LPixelKernelSet&  set     ,
+        LKernelResult&          result  ,
+        const Uint32*           expected,
+        const Uint32*           actual  ,
+        int                     offset  ,
+        int                     count   ,
+        const char*             detail
+    )
+{
+	++result.runs;
+	for ( int i = 0; i < TEST_BUFFER; ++i )
+	{
+		if  ( expected[ i ] != actual[ i ] )
+		{
+			if  ( result.failed == 0 )
+			{
+				printf(
+                    "%s %s: length %d, offset %d, %s: pixel %d is %08X, expected %08X\n",
+                    set.name                ,
+                    result.name             ,
+                    count                   ,
+                    offset                  ,
+                    detail                  ,
+                    i - TEST_GUARD - offset ,
+                    (unsigned) actual[ i ]  ,
+                    (unsigned) expected[ i ]
+                );
+			}
+			++result.failed;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//  Runs every kernel of one set over one run, against the scalar set
+void testRun( const LPixelKernelSet& scalar, const LPixelKernelSet& set, LKernelResult results[ 4 ], int offset, int count )
+{
+	char    detail[ 64 ];
+	int     start   = TEST_GUARD + offset;
+	Uint32  key     = nextRandom();
+
+	//  Color key
+	Uint32 replacement = nextRandom();
+	fillPixels( gSource, offset, count, key );
+	copySource();
+	scalar.colorKey ( gExpected + start,    count, key, replacement );
+	set.colorKey    ( gActual + start,      count, key, replacement );
+	snprintf( detail, sizeof( detail ), "key %08X", (unsigned) key );
+	checkPixels( set, results[ 0 ], gExpected, gActual, offset, count, detail );
+
+	//  Premultiply with each alpha byte
+	for ( Uint32 alphaMask : TEST_ALPHA_MASKS )
+	{
+		fillPixels( gSource, offset, count, key );
+		copySource();
+		scalar.premultiply  ( gExpected + start,    count, alphaMask );
+		set.premultiply     ( gActual + start,      count, alphaMask );
+		snprintf( detail, sizeof( detail ), "alpha mask %08X", (unsigned) alphaMask );
+		checkPixels( set, results[ 1 ], gExpected, gActual, offset, count, detail );
+	}
+
+	//  Swizzle with every byte order, permutations and repeats alike
+	fillPixels( gSource, offset, count, key );
+	for ( int orders = 0; orders < 256; ++orders )
+	{
+		Uint8 order[ 4 ] = { (Uint8)( orders & 3 ), (Uint8)( ( orders >> 2 ) & 3 ), (Uint8)( ( orders >> 4 ) & 3 ), (Uint8)( orders >> 6 ) };
+		copySource();
+		scalar.swizzle  ( gExpected + start,    count, order );
+		set.swizzle     ( gActual + start,      count, order );
+		snprintf( detail, sizeof( detail ), "order %d%d%d%d", order[ 0 ], order[ 1 ], order[ 2 ], order[ 3 ] );
+		checkPixels( set, results[ 2 ], gExpected, gActual, offset, count, detail );
+	}
+
+	//  Marks over mixed pixels, then over pixels that all match
+	for ( int same = 0; same < 2; ++same )
+	{
+		fillPixels( gSource, offset, count, key );
+		if  ( same )
+		{
+			for ( int i = 0; i < count; ++i )
+			{
+				gSource[ start + i ] = key;
+			}
+		}
+		for ( int i = 0; i < TEST_BUFFER; ++i )
+		{
+			Uint32 random = nextRandom();
+			gExpectedMarks[ i ] = random % 3 == 0 ? 0 : random;
+		}
+		memcpy( gActualMarks, gExpectedMarks, sizeof( gExpectedMarks ) );
+
+		bool expectedAny    = scalar.markNotEqual   ( gSource + start, count, key, gExpectedMarks + start );
+		bool actualAny      = set.markNotEqual      ( gSource + start, count, key, gActualMarks + start );
+		snprintf( detail, sizeof( detail ), same ? "all equal to %08X" : "value %08X", (unsigned) key );
+		if  ( checkPixels( set, results[ 3 ], gExpectedMarks, gActualMarks, offset, count, detail ) && expectedAny != actualAny )
+		{
+			if  ( results[ 3 ].failed == 0 )
+			{
+				printf( "%s %s: length %d, offset %d, %s: returned %d, expected %d\n",
+                        set.name, results[ 3 ].name, count, offset, detail, actualAny, expectedAny );
+			}
+			++results[ 3 ].failed;
+		}
+	}
+}
+
+int main( int /*argc*/, char* /*args*/[] )
+{
+	//  Lengths to try
+	std::vector<int> lengths;
+	for ( int length = 0; length < TEST_SHORT_LENGTHS; ++length )
+	{
+		lengths.push_back( length );
+	}
+	for ( int length : TEST_LONG_LENGTHS )
+	{
+		lengths.push_back( length );
+	}
+
+	//  The scalar set comes first and is the reference
+	const LPixelKernelSet*  sets[ 4 ];
+	int                     setCount    = getPixelKernelSets( sets );
+	bool                    passed      = true;
+
+	printf( "%s: reference\n", sets[ 0 ]->name );
+	for ( int s = 1; s < setCount; ++s )
+	{
+		LKernelResult results[ 4 ] =
+        {
+            { "colorKey",       0, 0 },
+            { "premultiply",    0, 0 },
+            { "swizzle",        0, 0 },
+            { "markNotEqual",   0, 0 }
+        };
+
+		for ( int length : lengths )
+		{
+			for ( int offset = 0; offset < TEST_MAX_OFFSET; ++offset )
+			{
+				testRun( *sets[ 0 ], *sets[ s ], results, offset, length );
+			}
+		}
+
+		for ( const LKernelResult& result : results )
+		{
+			printf( "%s %s: %d runs, %d failed\n", sets[ s ]->name, result.name, result.runs, result.failed );
+			if  ( result.failed > 0 )
+			{
+				passed = false;
+			}
+		}
+	}
+
+	if  ( setCount == 1 )
+	{
+		printf( "No vector kernels on this CPU, nothing to compare\n" );
+	}
+
+	printf( passed ? "All kernel sets match\n" : "Kernel sets differ from scalar!\n" );
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+/*  Dirty tile tracking for partial texture uploads, shared by the texture
+    streaming lessons.
+
+    The texture is split into square tiles. Changed tiles are marked, either
+    by rectangle or by comparing a frame with the pixels last uploaded, and
+    come back as a few rectangles, runs of tiles merged along rows and then
+    down columns, to be uploaded with rect-scoped updates.             */
+
+#ifndef LDIRTYREGION_H
+#define LDIRTYREGION_H
+
+//  Using SDL, pixel views, strings and vectors
+#include <SDL.h>
+#include <string.h>
+#include <vector>
+#include "LPixelView.h"
+
+//  Changed tiles of a texture
+class LDirtyRegion
+{
+	public:
+		//  Initializes an empty region
+		LDirtyRegion()
+		{
+			mWidth      = 0;
+			mHeight     = 0;
+			mTileSize   = 0;
+			mColumns    = 0;
+			mRows       = 0;
+		}
+
+		//  Covers a width x height texture, clean
+		void resize( int width, int height, int tileSize = 32 )
+		{
+			mWidth      = width;
+			mHeight     = height;
+			mTileSize   = tileSize;
+			mColumns    = ( width  + tileSize - 1 ) / tileSize;
+			mRows       = ( height + tileSize - 1 ) / tileSize;
+			mTiles.assign( mColumns * mRows, false );
+		}
+
+		//  Marks the tiles a rectangle touches
+		void markDirty( const SDL_Rect& rect )
+		{
+			SDL_Rect bounds = { 0, 0, mWidth, mHeight }, clipped;
+			if  ( mTileSize == 0 || !SDL_IntersectRect( &rect, &bounds, &clipped ) )
+			{
+				return;
+			}
+
+			for ( int row = clipped.y / mTileSize; row <= ( clipped.y + clipped.h - 1 ) / mTileSize; ++row )
+			{
+				for ( int column = clipped.x / mTileSize; column <= ( clipped.x + clipped.w - 1 ) / mTileSize; ++column )
+				{
+					mTiles[ row * mColumns + column ] = true;
+				}
+			}
+		}
+
+		//  Marks everything
+		void markAll()
+		{
+			mTiles.assign( mColumns * mRows, true );
+		}
+
+		//  Marks the tiles where frame differs from shown and copies them
+		//	into shown, which then mirrors what the texture will hold.
+		//	Returns the number of changed tiles
+		int markChanged( LPixelView shown, LPixelView frame )
+		{
+			int changed = 0;
+
+			//  Both must cover the region exactly, or the tiles would run off them
+			if  (
+                    shown.getWidth() != mWidth || shown.getHeight() != mHeight ||
+                    frame.getWidth() != mWidth || frame.getHeight() != mHeight
+                )
+			{
+				return changed;
+			}
+
+			for ( int row = 0; row < mRows; ++row )
+			{
+				int top     = row * mTileSize;
+				int bottom  = SDL_min( top + mTileSize, mHeight );
+
+				for ( int column = 0; column < mColumns; ++column )
+				{
+					int left    = column * mTileSize;
+					int bytes   = ( SDL_min( left + mTileSize, mWidth ) - left ) * 4;
+
+					//  Compare line by line, stop at the first difference
+					int y = top;
+					while   ( y < bottom && memcmp( &shown.at( left, y ), &frame.at( left, y ), bytes ) == 0 )
+					{
+						++y;
+					}
+					if  ( y == bottom )
+					{
+						continue;
+					}
+
+					//  Bring the rest of the tile up to date
+					for ( ; y < bottom; ++y )
+					{
+						memcpy( &shown.at( left, y ), &frame.at( left, y ), bytes );
+					}
+					mTiles[ row * mColumns + column ] = true;
+					++changed;
+				}
+			}
+
+			return changed;
+		}
+
+		//  Gets the dirty area as rectangles
+		const std::vector<SDL_Rect>& getRects()
+		{
+			mRects.clear();
+
+			for ( int row = 0; row < mRows; ++row )
+			{
+				int column = 0;
+				while   ( column < mColumns )
+				{
+					//  Find a run of dirty tiles
+					if  ( !mTiles[ row * mColumns + column ] )
+					{
+						++column;
+						continue;
+					}
+					int start = column;
+					while   ( column < mColumns && mTiles[ row * mColumns + column ] )
+					{
+						++column;
+					}
+
+					SDL_Rect rect = {
+                        start * mTileSize                                           ,
+                        row * mTileSize                                             ,
+                        SDL_min( column * mTileSize, mWidth  ) - start * mTileSize  ,
+                        SDL_min( ( row + 1 ) * mTileSize, mHeight ) - row * mTileSize
+                    };
+
+					//  Extend the same run on the row above
+					bool merged = false;
+					for ( SDL_Rect& above : mRects )
+					{
+						if  ( above.x == rect.x && above.w == rect.w && above.y + above.h == rect.y )
+						{
+							above.h += rect.h;
+							merged = true;
+							break;
+						}
+					}
+					if  ( !merged )
+					{
+						mRects.push_back( rect );
+					}
+				}
+			}
+
+			return mRects;
+		}
+
+		//  Gets whether anything is dirty
+		bool isDirty() const
+		{
+			for ( bool tile : mTiles )
+			{
+				if  ( tile )
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		//  Marks everything clean
+		void clear()
+		{
+			mTiles.assign( mColumns * mRows, false );
+		}
+
+	private:
+		//  Texture and tile dimensions
+		int     mWidth, mHeight;
+		int     mTileSize;
+		int     mColumns, mRows;
+
+		//  Dirty flag per tile, row by row
+		std::vector<bool>   mTiles;
+
+		//  Rectangles from the last getRects
+		std::vector<SDL_Rect>   mRects;
+};
+
+#endif
@@ -0,0 +1,400 @@
+/*  Glyph cache for SDL_ttf text, shared by the true type font lessons.
+
+    Each glyph is rasterized once per font, size and style, in white, into
+    an atlas texture. Strings are then composed from the cached glyphs with
+    one SDL_RenderGeometry call and tinted through the vertex colors, so
+    changing text costs no rasterization and no texture creation.
+
+    The atlas is packed in shelves. When it is full it is cleared and the
+    glyphs in use are rasterized again. A string whose glyphs alone fill
+    the atlas doubles it, up to the largest texture the renderer takes,
+    and is not drawn if even that is too small.                     */
+
+#ifndef LGLYPHATLAS_H
+#define LGLYPHATLAS_H
+
+//  Using SDL, SDL_ttf, standard IO, strings, vectors and hash maps
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+//  Using the shared UTF-8 decoder and quad indices
+#include "LUTF8.h"
+#include "LQuadIndices.h"
+
+//  Atlas of rasterized glyphs for one font
+class LGlyphAtlas
+{
+	public:
+		//  Initializes variables
+		LGlyphAtlas()
+		{
+			mRenderer   = NULL;
+			mFont       = NULL;
+			mAtlas      = NULL;
+			mSize       = 0;
+			mShelfX     = 0;
+			mShelfY     = 0;
+			mShelfHeight= 0;
+			mRasterized = 0;
+			mResets     = 0;
+		}
+
+		//  Deallocates memory
+		~LGlyphAtlas()
+		{
+			free();
+		}
+
+		//  Creates a size x size atlas for the font
+		bool init( SDL_Renderer* renderer, TTF_Font* font, int size = 512 )
+		{
+			//  Get rid of preexisting atlas
+			free();
+
+			mAtlas = SDL_CreateTexture( renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, size, size );
+			if  ( mAtlas == NULL )
+			{
+				printf( "Unable to create glyph atlas! SDL Error: %s\n", SDL_GetError() );
+				return false;
+			}
+			SDL_SetTextureBlendMode( mAtlas, SDL_BLENDMODE_BLEND );
+
+			mRenderer   = renderer;
+			mFont       = font;
+			mSize       = size;
+			clear();
+
+			return true;
+		}
+
+		//  Deallocates the atlas
+		void free()
+		{
+			if  ( mAtlas != NULL )
+			{
+				SDL_DestroyTexture( mAtlas );
+				mAtlas = NULL;
+			}
+			mRenderer   = NULL;
+			mFont       = NULL;
+			mSize       = 0;
+			mGlyphs.clear();
+			mAdvances.clear();
+		}
+
+		//  Shows the UTF-8 text with its top left corner at x, y
+		void renderText( int x, int y, std::string text, SDL_Color color )
+		{
+			if  ( mAtlas == NULL )
+			{
+				return;
+			}
+
+			//  A full atlas is cleared in the middle of a string, which
+			//	invalidates the quads before it, so lay out once more
+			int resets = mResets;
+			layoutText( x, y, text, color );
+			if  ( mResets != resets )
+			{
+				resets = mResets;
+				layoutText( x, y, text, color );
+			}
+
+			//  Cleared again, the string alone needs more than the atlas
+			while   ( mResets != resets )
+			{
+				if  ( !grow() )
+				{
+					printf( "Text does not fit in the glyph atlas!\n" );
+					mVertices.clear();
+					return;
+				}
+				resets = mResets;
+				layoutText( x, y, text, color );
+			}
+
+			int glyphs = (int) mVertices.size() / 4;
+			if  ( glyphs == 0 )
+			{
+				return;
+			}
+
+			//  Two triangles per quad
+			growQuadIndices( mIndices, glyphs );
+
+			SDL_RenderGeometry( mRenderer, mAtlas, &mVertices[ 0 ], glyphs * 4, &mIndices[ 0 ], glyphs * 6 );
+		}
+
+		//  Gets the size the text would take without rasterizing anything
+		void getTextSize( std::string text, int* w, int* h )
+		{
+			int width = 0, lineWidth = 0, lines = 1;
+			Uint16 previous = 0;
+
+			for ( int i = 0; i < (int) text.length(); )
+			{
+				Uint16 ch = nextCharacter( text, i );
+				if  ( ch == '\n' )
+				{
+					lineWidth = 0;
+					previous = 0;
+					++lines;
+					continue;
+				}
+
+				int advance = getAdvance( ch );
+				if  ( advance == 0 )
+				{
+					continue;
+				}
+				lineWidth += getKerning( previous, ch ) + advance;
+				previous = ch;
+				width = SDL_max( width, lineWidth );
+			}
+
+			if  ( w != NULL ) *w = width;
+			if  ( h != NULL ) *h = mFont == NULL ? 0 : TTF_FontHeight( mFont ) + ( lines - 1 ) * TTF_FontLineSkip( mFont );
+		}
+
+		//  Gets how far a character moves the pen, 0 if the font lacks it,
+		//	from the metrics alone so nothing is rasterized
+		int getAdvance( Uint16 ch )
+		{
+			if  ( mFont == NULL )
+			{
+				return 0;
+			}
+
+			Uint64 key = getKey( ch );
+			std::unordered_map<Uint64, int>::iterator cached = mAdvances.find( key );
+			if  ( cached != mAdvances.end() )
+			{
+				return cached->second;
+			}
+
+			int advance = 0;
+			if  ( !TTF_GlyphIsProvided( mFont, ch ) || TTF_GlyphMetrics( mFont, ch, NULL, NULL, NULL, NULL, &advance ) != 0 )
+			{
+				advance = 0;
+			}
+
+			return mAdvances[ key ] = advance;
+		}
+
+		//  Gets the kerning between two characters, 0 after the start of a line
+		int getKerning( Uint16 previous, Uint16 ch )
+		{
+			return mFont == NULL || previous == 0 ? 0 : TTF_GetFontKerningSizeGlyphs( mFont, previous, ch );
+		}
+
+		//  Gets the height of a line of text
+		int getLineHeight()
+		{
+			return mFont == NULL ? 0 : TTF_FontHeight( mFont );
+		}
+
+		//  Gets how many glyphs were rasterized and how often the atlas filled up
+		int getRasterized() const { return mRasterized; }
+		int getResets()     const { return mResets; }
+
+	private:
+		//  A cached glyph, the clip is the whole glyph surface
+		struct Glyph
+		{
+			SDL_Rect    clip;
+			int         xOffset;
+			int         advance;
+		};
+
+		//  The cache key, glyphs differ with size and style
+		Uint64 getKey( Uint16 ch )
+		{
+			return
+                ( (Uint64) TTF_FontHeight       ( mFont ) << 40 ) |
+                ( (Uint64) TTF_GetFontOutline   ( mFont ) << 24 ) |
+                ( (Uint64) TTF_GetFontStyle     ( mFont ) << 16 ) |
+                ch;
+		}
+
+		//  Doubles the atlas and empties it, false past the largest
+		//	texture the renderer takes
+		bool grow()
+		{
+			SDL_RendererInfo    info;
+			int                 limit = 4096;
+			if  ( SDL_GetRendererInfo( mRenderer, &info ) == 0 && info.max_texture_width > 0 && info.max_texture_height > 0 )
+			{
+				limit = SDL_min( info.max_texture_width, info.max_texture_height );
+			}
+			if  ( mSize * 2 > limit )
+			{
+				return false;
+			}
+
+			SDL_Texture* atlas = SDL_CreateTexture( mRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, mSize * 2, mSize * 2 );
+			if  ( atlas == NULL )
+			{
+				printf( "Unable to grow glyph atlas! SDL Error: %s\n", SDL_GetError() );
+				return false;
+			}
+			SDL_SetTextureBlendMode( atlas, SDL_BLENDMODE_BLEND );
+
+			SDL_DestroyTexture( mAtlas );
+			mAtlas  = atlas;
+			mSize  *= 2;
+			clear();
+
+			return true;
+		}
+
+		//  Empties the atlas
+		void clear()
+		{
+			//  Static textures start undefined, filtering must see transparent padding
+			std::vector<Uint32> blank( mSize * mSize, 0 );
+			SDL_UpdateTexture( mAtlas, NULL, &blank[ 0 ], mSize * 4 );
+
+			mGlyphs.clear();
+			mShelfX     = 1;
+			mShelfY     = 1;
+			mShelfHeight= 0;
+		}
+
+		//  Finds a glyph, rasterizing it if it is not cached yet
+		const Glyph* getGlyph( Uint16 ch )
+		{
+			Uint64 key = getKey( ch );
+			std::unordered_map<Uint64, Glyph>::iterator cached = mGlyphs.find( key );
+			if  ( cached != mGlyphs.end() )
+			{
+				return &cached->second;
+			}
+
+			int minX = 0, advance = 0;
+			if  ( !TTF_GlyphIsProvided( mFont, ch ) || TTF_GlyphMetrics( mFont, ch, &minX, NULL, NULL, NULL, &advance ) != 0 )
+			{
+				return NULL;
+			}
+
+			//  Rasterize in white, color comes from the vertices
+			SDL_Color       white   = { 0xFF, 0xFF, 0xFF, 0xFF };
+			SDL_Surface*    raster  = TTF_RenderGlyph_Blended( mFont, ch, white );
+			SDL_Surface*    surface = raster == NULL ? NULL : SDL_ConvertSurfaceFormat( raster, SDL_PIXELFORMAT_ARGB8888, 0 );
+			SDL_FreeSurface( raster );
+			if  ( surface == NULL )
+			{
+				printf( "Unable to render glyph %u! SDL_ttf Error: %s\n", (unsigned) ch, TTF_GetError() );
+				return NULL;
+			}
+
+			//  Next shelf if this one is full, start over if the atlas is
+			if  ( mShelfX + surface->w + 1 > mSize )
+			{
+				mShelfX     = 1;
+				mShelfY    += mShelfHeight + 1;
+				mShelfHeight= 0;
+			}
+			if  ( mShelfY + surface->h + 1 > mSize )
+			{
+				clear();
+				++mResets;
+			}
+			if  ( surface->w + 2 > mSize || surface->h + 2 > mSize )
+			{
+				printf( "Glyph %u does not fit in the atlas!\n", (unsigned) ch );
+				SDL_FreeSurface( surface );
+				return NULL;
+			}
+
+			Glyph glyph;
+			glyph.clip      = { mShelfX, mShelfY, surface->w, surface->h };
+			glyph.xOffset   = SDL_min( minX, 0 );
+			glyph.advance   = advance;
+			SDL_UpdateTexture( mAtlas, &glyph.clip, surface->pixels, surface->pitch );
+			SDL_FreeSurface( surface );
+
+			mShelfX    += glyph.clip.w + 1;
+			mShelfHeight= SDL_max( mShelfHeight, glyph.clip.h );
+			++mRasterized;
+
+			return &( mGlyphs[ key ] = glyph );
+		}
+
+		//  Builds the glyph quads of the text
+		void layoutText( int x, int y, std::string text, SDL_Color color )
+		{
+			mVertices.clear();
+
+			float   scale   = 1.f / mSize;
+			int     curX    = x, curY = y;
+			Uint16  previous= 0;
+
+			for ( int i = 0; i < (int) text.length(); )
+			{
+				Uint16 ch = nextCharacter( text, i );
+
+				//  Move down and back on newlines
+				if  ( ch == '\n' )
+				{
+					curX = x;
+					curY += TTF_FontLineSkip( mFont );
+					previous = 0;
+					continue;
+				}
+
+				const Glyph* glyph = getGlyph( ch );
+				if  ( glyph == NULL )
+				{
+					continue;
+				}
+
+				//  Pull the pair together or apart
+				curX += getKerning( previous, ch );
+				previous = ch;
+
+				//  Add the glyph quad, clockwise from the top left
+				const SDL_Rect& clip = glyph->clip;
+				float   x0 = (float)( curX + glyph->xOffset ), x1 = x0 + clip.w;
+				float   y0 = (float) curY, y1 = y0 + clip.h;
+				float   u0 = clip.x * scale, u1 = ( clip.x + clip.w ) * scale;
+				float   v0 = clip.y * scale, v1 = ( clip.y + clip.h ) * scale;
+
+				SDL_Vertex  quad[ 4 ] = {
+                    { { x0, y0 }, color, { u0, v0 } },
+                    { { x1, y0 }, color, { u1, v0 } },
+                    { { x1, y1 }, color, { u1, v1 } },
+                    { { x0, y1 }, color, { u0, v1 } }
+                };
+				mVertices.insert( mVertices.end(), quad, quad + 4 );
+
+				curX += glyph->advance;
+			}
+		}
+
+		//  Where glyphs are drawn from and to
+		SDL_Renderer*   mRenderer;
+		TTF_Font*       mFont;
+		SDL_Texture*    mAtlas;
+		int             mSize;
+
+		//  Shelf packing position
+		int             mShelfX, mShelfY, mShelfHeight;
+
+		//  Cached glyphs and advances by size, style and character
+		std::unordered_map<Uint64, Glyph>   mGlyphs;
+		std::unordered_map<Uint64, int>     mAdvances;
+
+		//  Quads of the last string and the shared index pattern
+		std::vector<SDL_Vertex>     mVertices;
+		std::vector<int>            mIndices;
+
+		//  Statistics
+		int             mRasterized;
+		int             mResets;
+};
+
+#endif
@@ -0,0 +1,550 @@
+/*  Work stealing job system, shared by the threading lessons.
+
+    start() makes a worker thread per core after the first, and the thread
+    that called it is worker 0. Each worker has a fixed size Chase-Lev
+    deque. The owner pushes and pops jobs at the bottom, newest first, and
+    idle workers steal the oldest from the top of the others. Only a steal
+    and the owner taking the last job ever contend, and that is one
+    compare and swap.
+
+    A job can count down an LJobCounter when it is done, and can be held
+    back until another counter reaches zero. wait() runs jobs until its
+    counter is done instead of blocking, so the main thread helps rather
+    than sits idle. parallelFor() is built from those pieces.        */
+
+#ifndef LJOBSYSTEM_H
+#define LJOBSYSTEM_H
+
+//  Using SDL, SDL threads, atomics, standard IO, threads and vectors
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//  Jobs each worker can hold, a power of two. Past that they run straight away
+const int JOB_QUEUE_SIZE        = 4096;
+
+//  Times an idle worker looks for work before it sleeps
+const int JOB_SPINS_BEFORE_SLEEP = 256;
+
+//  Longest an idle worker sleeps without being woken, in milliseconds
+const Uint32 JOB_SLEEP_MS       = 10;
+
+//  Work to run, gets its range. Jobs started with run get 0 and 1
+typedef void ( *LJobFunction )( void* data, int begin, int end );
+
+class LJobCounter;
+
+//  One job
+struct LJob
+{
+	LJobFunction    function;
+	void*           data;
+	int             begin, end;
+	LJobCounter*    counter;
+};
+
+//  Jobs not yet finished, and jobs waiting for them
+class LJobCounter
+{
+	public:
+		//  Initializes a finished counter
+		LJobCounter()
+		{
+			mCount  = 0;
+			mLock   = 0;
+		}
+
+		//  Gets the jobs not yet finished
+		int get() const
+		{
+			return mCount.load( std::memory_order_acquire );
+		}
+
+	private:
+		friend class LJobSystem;
+
+		//  Jobs not yet finished
+		std::atomic<int>    mCount;
+
+		//  Guards the last count down against jobs being held back
+		SDL_SpinLock        mLock;
+
+		//  Jobs to start once the count reaches zero
+		std::vector<LJob>   mDependents;
+};
+
+//  Chase-Lev deque of a fixed size
+class LJobDeque
+{
+	public:
+		//  Initializes an empty deque
+		LJobDeque()
+		{
+			mTop    = 0;
+			mBottom = 0;
+		}
+
+		//  Owner side: adds a job at the bottom, false when full
+		bool push( const LJob& job )
+		{
+			Sint64 bottom   = mBottom.load( std::memory_order_relaxed );
+			Sint64 top      = mTop.load( std::memory_order_acquire );
+			if  ( bottom - top >= JOB_QUEUE_SIZE )
+			{
+				return false;
+			}
+
+			mJobs[ bottom & ( JOB_QUEUE_SIZE - 1 ) ].store( job );
+			mBottom.store( bottom + 1, std::memory_order_release );
+
+			return true;
+		}
+
+		//  Owner side: takes the newest job, false when empty
+		bool pop( LJob* job )
+		{
+			Sint64 bottom = mBottom.load( std::memory_order_relaxed ) - 1;
+			mBottom.store( bottom, std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+			Sint64 top = mTop.load( std::memory_order_relaxed );
+
+			//  Already empty
+			if  ( top > bottom )
+			{
+				mBottom.store( bottom + 1, std::memory_order_relaxed );
+				return false;
+			}
+
+			mJobs[ bottom & ( JOB_QUEUE_SIZE - 1 ) ].load( job );
+
+			//  The last job, a thief may be after it too
+			if  ( top == bottom )
+			{
+				bool won = mTop.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+				mBottom.store( bottom + 1, std::memory_order_relaxed );
+				return won;
+			}
+
+			return true;
+		}
+
+		//  Any thread: takes the oldest job, false when empty or another thread got it first
+		bool steal( LJob* job )
+		{
+			Sint64 top = mTop.load( std::memory_order_acquire );
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+			Sint64 bottom = mBottom.load( std::memory_order_acquire );
+			if  ( top >= bottom )
+			{
+				return false;
+			}
+
+			//  Copy first, the slot may be reused once the job is taken
+			mJobs[ top & ( JOB_QUEUE_SIZE - 1 ) ].load( job );
+			return mTop.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+		}
+
+		//  Gets whether there looks to be nothing to take
+		bool isEmpty() const
+		{
+			return mBottom.load( std::memory_order_acquire ) <= mTop.load( std::memory_order_acquire );
+		}
+
+	private:
+		//  A job in relaxed atomics, a thief can read a slot the owner is
+		//	refilling, but then it loses the race for it and drops the copy
+		struct Slot
+		{
+			void store( const LJob& job )
+			{
+				function.store  ( job.function, std::memory_order_relaxed );
+				data.store      ( job.data    , std::memory_order_relaxed );
+				begin.store     ( job.begin   , std::memory_order_relaxed );
+				end.store       ( job.end     , std::memory_order_relaxed );
+				counter.store   ( job.counter , std::memory_order_relaxed );
+			}
+
+			void load( LJob* job ) const
+			{
+				job->function   = function.load ( std::memory_order_relaxed );
+				job->data       = data.load     ( std::memory_order_relaxed );
+				job->begin      = begin.load    ( std::memory_order_relaxed );
+				job->end        = end.load      ( std::memory_order_relaxed );
+				job->counter    = counter.load  ( std::memory_order_relaxed );
+			}
+
+			std::atomic<LJobFunction>   function;
+			std::atomic<void*>          data;
+			std::atomic<int>            begin, end;
+			std::atomic<LJobCounter*>   counter;
+		};
+
+		//  Oldest job, moved by thieves and the owner's last pop
+		alignas( 64 ) std::atomic<Sint64>   mTop;
+
+		//  One past the newest job, moved by the owner
+		alignas( 64 ) std::atomic<Sint64>   mBottom;
+
+		//  The jobs
+		Slot    mJobs[ JOB_QUEUE_SIZE ];
+};
+
+//  Runs jobs on every core
+class LJobSystem
+{
+	public:
+		//  Initializes variables
+		LJobSystem()
+		{
+			mQuit       = false;
+			mSleeping   = 0;
+			mWake       = NULL;
+		}
+
+		//  Stops the workers
+		~LJobSystem()
+		{
+			stop();
+		}
+
+		//  Starts workerCount - 1 threads, the caller being the first. By default one
+		//	per core, and at least one thread so jobs never wait on the caller
+		bool start( int workerCount = 0 )
+		{
+			stop();
+			if  ( workerCount <= 0 )
+			{
+				workerCount = SDL_max( SDL_GetCPUCount(), 2 );
+			}
+
+			mWake = SDL_CreateSemaphore( 0 );
+			if  ( mWake == NULL )
+			{
+				printf( "Unable to create job semaphore! SDL Error: %s\n", SDL_GetError() );
+				return false;
+			}
+
+			mQuit.store( false, std::memory_order_relaxed );
+			for ( int i = 0; i < workerCount; ++i )
+			{
+				Worker* worker  = new Worker;
+				worker->system  = this;
+				worker->index   = i;
+				worker->random  = 0x9E3779B9u * ( i + 1 );
+				worker->thread  = NULL;
+				mWorkers.push_back( worker );
+			}
+
+			//  The caller is worker 0
+			currentWorker() = mWorkers[ 0 ];
+
+			for ( int i = 1; i < workerCount; ++i )
+			{
+				mWorkers[ i ]->thread = SDL_CreateThread( workerFunction, "LazyWorker", mWorkers[ i ] );
+				if  ( mWorkers[ i ]->thread == NULL )
+				{
+					printf( "Unable to create worker thread! SDL Error: %s\n", SDL_GetError() );
+					stop();
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		//  Stops the workers, call from the thread that started them once nothing is running
+		void stop()
+		{
+			mQuit.store( true, std::memory_order_release );
+			for ( Worker* worker : mWorkers )
+			{
+				if  ( worker->thread != NULL )
+				{
+					SDL_SemPost( mWake );
+				}
+			}
+
+			//  The caller is no longer a worker
+			if  ( getCurrentWorker() != NULL )
+			{
+				currentWorker() = NULL;
+			}
+			//  Every thread is done before any deque goes, they steal from each other
+			for ( Worker* worker : mWorkers )
+			{
+				if  ( worker->thread != NULL )
+				{
+					SDL_WaitThread( worker->thread, NULL );
+				}
+			}
+			for ( Worker* worker : mWorkers )
+			{
+				delete worker;
+			}
+			mWorkers.clear();
+			if  ( mWake != NULL )
+			{
+				SDL_DestroySemaphore( mWake );
+				mWake = NULL;
+			}
+		}
+
+		//  Gets the number of workers, including the thread that started them
+		int getWorkerCount() const
+		{
+			return (int) mWorkers.size();
+		}
+
+		//  Queues function( data, 0, 1 ), counting it on counter and holding it
+		//	back until after reaches zero. Call from the thread that started the
+		//	system or from jobs, anywhere else the job runs straight away
+		void run( LJobFunction function, void* data, LJobCounter* counter = NULL, LJobCounter* after = NULL )
+		{
+			LJob job = { function, data, 0, 1, counter };
+			schedule( job, after );
+		}
+
+		//  Splits begin to end into ranges of grain, or a few per worker when grain
+		//	is 0, runs function on each of them across the workers and waits
+		void parallelFor( int begin, int end, int grain, LJobFunction function, void* data )
+		{
+			if  ( begin >= end )
+			{
+				return;
+			}
+			if  ( grain <= 0 )
+			{
+				grain = SDL_max( ( end - begin ) / ( SDL_max( getWorkerCount(), 1 ) * 4 ), 1 );
+			}
+
+			//  Queue all but the first range, which this thread takes
+			LJobCounter counter;
+			for ( int start = begin + grain; start < end; start += grain )
+			{
+				LJob job = { function, data, start, SDL_min( start + grain, end ), &counter };
+				schedule( job, NULL );
+			}
+			function( data, begin, SDL_min( begin + grain, end ) );
+
+			wait( &counter );
+		}
+
+		//  Runs jobs until counter reaches zero
+		void wait( LJobCounter* counter )
+		{
+			Worker* worker = getCurrentWorker();
+			LJob    job;
+			while   ( counter->get() > 0 )
+			{
+				if  ( worker != NULL && find( worker, &job ) )
+				{
+					execute( job );
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			//  The last job may still be releasing the lock, the counter must outlive it
+			SDL_AtomicLock( &counter->mLock );
+			SDL_AtomicUnlock( &counter->mLock );
+		}
+
+	private:
+		//  A worker and its deque
+		struct Worker
+		{
+			LJobDeque       deque;
+			LJobSystem*     system;
+			int             index;
+			Uint32          random;
+			SDL_Thread*     thread;
+		};
+
+		//  Gets the calling thread's worker slot
+		static Worker*& currentWorker()
+		{
+			static thread_local Worker* worker = NULL;
+			return worker;
+		}
+
+		//  Gets the calling thread's worker in this system, NULL for other threads
+		Worker* getCurrentWorker()
+		{
+			Worker* worker = currentWorker();
+			return worker != NULL && worker->system == this ? worker : NULL;
+		}
+
+		//  Worker thread entry point
+		static int workerFunction( void* data )
+		{
+			Worker*         worker  = (Worker*) data;
+			LJobSystem*     system  = worker->system;
+			currentWorker() = worker;
+
+			int idle = 0;
+			LJob job;
+			while   ( !system->mQuit.load( std::memory_order_acquire ) )
+			{
+				if  ( system->find( worker, &job ) )
+				{
+					system->execute( job );
+					idle = 0;
+				}
+				else if ( ++idle < JOB_SPINS_BEFORE_SLEEP )
+				{
+					std::this_thread::yield();
+				}
+				//  Sleep until woken, checking once more after saying so
+				else
+				{
+					system->mSleeping.fetch_add( 1, std::memory_order_seq_cst );
+					if  ( !system->hasWork() )
+					{
+						SDL_SemWaitTimeout( system->mWake, JOB_SLEEP_MS );
+					}
+					system->mSleeping.fetch_sub( 1, std::memory_order_relaxed );
+					idle = 0;
+				}
+			}
+
+			return 0;
+		}
+
+		//  Counts the job and queues it, or holds it back behind after
+		void schedule( const LJob& job, LJobCounter* after )
+		{
+			if  ( job.counter != NULL )
+			{
+				job.counter->mCount.fetch_add( 1, std::memory_order_relaxed );
+			}
+
+			//  Held back until after is done, whoever finishes it queues the job
+			if  ( after != NULL )
+			{
+				SDL_AtomicLock( &after->mLock );
+				bool waiting = after->mCount.load( std::memory_order_acquire ) > 0;
+				if  ( waiting )
+				{
+					after->mDependents.push_back( job );
+				}
+				SDL_AtomicUnlock( &after->mLock );
+
+				if  ( waiting )
+				{
+					return;
+				}
+			}
+
+			submit( job );
+		}
+
+		//  Puts a job on the calling worker's deque, runs it if there is none or it is full
+		void submit( const LJob& job )
+		{
+			Worker* worker = getCurrentWorker();
+			if  ( worker == NULL || !worker->deque.push( job ) )
+			{
+				execute( job );
+				return;
+			}
+
+			//  Wake a sleeper for it
+			if  ( mSleeping.load( std::memory_order_seq_cst ) > 0 )
+			{
+				SDL_SemPost( mWake );
+			}
+		}
+
+		//  Takes a job from the worker's own deque, or steals one
+		bool find( Worker* worker, LJob* job )
+		{
+			if  ( worker->deque.pop( job ) )
+			{
+				return true;
+			}
+
+			//  Try the others from a random one on
+			int count = (int) mWorkers.size();
+			worker->random ^= worker->random << 13;
+			worker->random ^= worker->random >> 17;
+			worker->random ^= worker->random << 5;
+			int first = (int)( worker->random % count );
+			for ( int i = 0; i < count; ++i )
+			{
+				Worker* victim = mWorkers[ ( first + i ) % count ];
+				if  ( victim != worker && victim->deque.steal( job ) )
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		//  Gets whether any deque looks to have jobs
+		bool hasWork()
+		{
+			for ( Worker* worker : mWorkers )
+			{
+				if  ( !worker->deque.isEmpty() )
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		//  Runs a job and counts it down
+		void execute( const LJob& job )
+		{
+			job.function( job.data, job.begin, job.end );
+
+			LJobCounter* counter = job.counter;
+			if  ( counter == NULL )
+			{
+				return;
+			}
+
+			//  Not the last, nothing is waiting on this one
+			int count = counter->mCount.load( std::memory_order_relaxed );
+			while   ( count > 1 )
+			{
+				if  ( counter->mCount.compare_exchange_weak( count, count - 1, std::memory_order_acq_rel, std::memory_order_relaxed ) )
+				{
+					return;
+				}
+			}
+
+			//  Maybe the last, count down under the lock so held back jobs are not missed
+			std::vector<LJob> released;
+			SDL_AtomicLock( &counter->mLock );
+			if  ( counter->mCount.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+			{
+				released.swap( counter->mDependents );
+			}
+			SDL_AtomicUnlock( &counter->mLock );
+
+			for ( const LJob& dependent : released )
+			{
+				submit( dependent );
+			}
+		}
+
+		//  The workers, the first one being the thread that started them
+		std::vector<Worker*>    mWorkers;
+
+		//  Tells the workers to finish
+		std::atomic<bool>       mQuit;
+
+		//  Workers asleep and what wakes them
+		std::atomic<int>        mSleeping;
+		SDL_sem*                mWake;
+};
+
+#endif
@@ -0,0 +1,296 @@
+/*  Bounded lock free queue for any number of producers and consumers,
+    shared by the threading lessons.
+
+    Every cell carries a sequence number that says whose turn it is.
+    Producers claim a position with a compare and swap on the enqueue
+    index, fill the cell and set its sequence to say it is full, and
+    consumers do the same on the dequeue index. Nobody waits for anybody
+    to finish a cell they did not claim, and the two indices are on their
+    own cache lines.
+
+    tryPush and tryPop never block. push and pop spin a little first,
+    then park on a condition until the other side makes room or data.
+    The other side only takes the lock when someone is parked.     */
+
+#ifndef LMPMCQUEUE_H
+#define LMPMCQUEUE_H
+
+//  Using SDL, SDL threads, atomics, standard IO and placement new
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdio.h>
+#include <atomic>
+#include <new>
+
+//  Using the shared spin pause
+#include "LSpinLock.h"
+
+//  Failed attempts before push or pop parks
+const int QUEUE_SPINS = 64;
+
+//  Queue of T between any threads
+template<typename T>
+class LMPMCQueue
+{
+	public:
+		//  Initializes an empty queue
+		LMPMCQueue()
+		{
+			mCells          = NULL;
+			mMask           = 0;
+			mEnqueue        = 0;
+			mDequeue        = 0;
+			mLock           = NULL;
+			mNotEmpty       = NULL;
+			mNotFull        = NULL;
+			mParkedPushers  = 0;
+			mParkedPoppers  = 0;
+		}
+
+		//  Frees the queue
+		~LMPMCQueue()
+		{
+			free();
+		}
+
+		//  Makes room for at least capacity items, rounded up to a power of two
+		bool allocate( Uint32 capacity )
+		{
+			free();
+
+			Uint32 size = 2;
+			while   ( size < capacity && size < 0x80000000 )
+			{
+				size <<= 1;
+			}
+
+			mCells      = new( std::nothrow ) Cell[ size ];
+			mLock       = SDL_CreateMutex();
+			mNotEmpty   = SDL_CreateCond();
+			mNotFull    = SDL_CreateCond();
+			if  ( mCells == NULL || mLock == NULL || mNotEmpty == NULL || mNotFull == NULL )
+			{
+				printf( "Unable to allocate %u item queue! SDL Error: %s\n", size, SDL_GetError() );
+				free();
+				return false;
+			}
+
+			//  Cell i is first free for the producer at position i
+			for ( Uint32 i = 0; i < size; ++i )
+			{
+				mCells[ i ].sequence.store( i, std::memory_order_relaxed );
+			}
+			mMask = size - 1;
+			mEnqueue.store( 0, std::memory_order_relaxed );
+			mDequeue.store( 0, std::memory_order_relaxed );
+
+			return true;
+		}
+
+		//  Frees the cells, only while no thread is using the queue
+		void free()
+		{
+			delete[] mCells;
+			mCells = NULL;
+			mMask  = 0;
+
+			if  ( mLock != NULL )
+			{
+				SDL_DestroyMutex( mLock );
+				mLock = NULL;
+			}
+			if  ( mNotEmpty != NULL )
+			{
+				SDL_DestroyCond( mNotEmpty );
+				mNotEmpty = NULL;
+			}
+			if  ( mNotFull != NULL )
+			{
+				SDL_DestroyCond( mNotFull );
+				mNotFull = NULL;
+			}
+		}
+
+		//  Adds an item, false when full
+		bool tryPush( const T& item )
+		{
+			if  ( !claimPush( item ) )
+			{
+				return false;
+			}
+
+			wake( mParkedPoppers, mNotEmpty );
+			return true;
+		}
+
+		//  Takes the oldest item, false when empty
+		bool tryPop( T* item )
+		{
+			if  ( !claimPop( item ) )
+			{
+				return false;
+			}
+
+			wake( mParkedPushers, mNotFull );
+			return true;
+		}
+
+		//  Adds an item, waiting for room
+		void push( const T& item )
+		{
+			for ( int i = 0; i < QUEUE_SPINS; ++i )
+			{
+				if  ( tryPush( item ) )
+				{
+					return;
+				}
+				cpuPause();
+			}
+
+			park( mParkedPushers, mNotFull, [ & ]() { return claimPush( item ); } );
+			wake( mParkedPoppers, mNotEmpty );
+		}
+
+		//  Takes the oldest item, waiting for one
+		void pop( T* item )
+		{
+			for ( int i = 0; i < QUEUE_SPINS; ++i )
+			{
+				if  ( tryPop( item ) )
+				{
+					return;
+				}
+				cpuPause();
+			}
+
+			park( mParkedPoppers, mNotEmpty, [ & ]() { return claimPop( item ); } );
+			wake( mParkedPushers, mNotFull );
+		}
+
+		//  Gets the most items it holds
+		Uint32 getCapacity() const
+		{
+			return mCells != NULL ? mMask + 1 : 0;
+		}
+
+	private:
+		//  An item and whose turn it is
+		struct Cell
+		{
+			std::atomic<Uint32> sequence;
+			T                   item;
+		};
+
+		//  Adds an item without waking anyone, false when full
+		bool claimPush( const T& item )
+		{
+			Uint32 position = mEnqueue.load( std::memory_order_relaxed );
+			while   ( true )
+			{
+				Cell*   cell        = &mCells[ position & mMask ];
+				Uint32  sequence    = cell->sequence.load( std::memory_order_acquire );
+				Sint32  difference  = (Sint32)( sequence - position );
+
+				//  Free, try to claim it
+				if  ( difference == 0 )
+				{
+					if  ( mEnqueue.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) )
+					{
+						cell->item = item;
+						cell->sequence.store( position + 1, std::memory_order_release );
+						return true;
+					}
+				}
+				//  Still holding the item from a lap ago
+				else if ( difference < 0 )
+				{
+					return false;
+				}
+				//  Another producer got there first
+				else
+				{
+					position = mEnqueue.load( std::memory_order_relaxed );
+				}
+			}
+		}
+
+		//  Takes the oldest item without waking anyone, false when empty
+		bool claimPop( T* item )
+		{
+			Uint32 position = mDequeue.load( std::memory_order_relaxed );
+			while   ( true )
+			{
+				Cell*   cell        = &mCells[ position & mMask ];
+				Uint32  sequence    = cell->sequence.load( std::memory_order_acquire );
+				Sint32  difference  = (Sint32)( sequence - ( position + 1 ) );
+
+				//  Full, try to claim it
+				if  ( difference == 0 )
+				{
+					if  ( mDequeue.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) )
+					{
+						*item = cell->item;
+						cell->sequence.store( position + mMask + 1, std::memory_order_release );
+						return true;
+					}
+				}
+				//  Not written yet
+				else if ( difference < 0 )
+				{
+					return false;
+				}
+				//  Another consumer got there first
+				else
+				{
+					position = mDequeue.load( std::memory_order_relaxed );
+				}
+			}
+		}
+
+		//  Sleeps on condition until attempt succeeds
+		template<typename Attempt>
+		void park( std::atomic<int>& parked, SDL_cond* condition, Attempt attempt )
+		{
+			SDL_LockMutex( mLock );
+			parked.fetch_add( 1, std::memory_order_relaxed );
+
+			//  Say so before the last look, the other side looks after its change
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+			while   ( !attempt() )
+			{
+				SDL_CondWait( condition, mLock );
+			}
+
+			parked.fetch_sub( 1, std::memory_order_relaxed );
+			SDL_UnlockMutex( mLock );
+		}
+
+		//  Wakes a thread parked on condition, if there is one
+		void wake( std::atomic<int>& parked, SDL_cond* condition )
+		{
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+			if  ( parked.load( std::memory_order_relaxed ) > 0 )
+			{
+				SDL_LockMutex( mLock );
+				SDL_CondSignal( condition );
+				SDL_UnlockMutex( mLock );
+			}
+		}
+
+		//  The cells and the mask of their positions
+		Cell*   mCells;
+		Uint32  mMask;
+
+		//  Next position to push and to pop, on their own cache lines
+		alignas( 64 ) std::atomic<Uint32>   mEnqueue;
+		alignas( 64 ) std::atomic<Uint32>   mDequeue;
+
+		//  Where blocked threads park and how many of them there are
+		alignas( 64 ) SDL_mutex*    mLock;
+		SDL_cond*                   mNotEmpty;
+		SDL_cond*                   mNotFull;
+		std::atomic<int>            mParkedPushers;
+		std::atomic<int>            mParkedPoppers;
+};
+
+#endif
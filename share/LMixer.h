@@ -0,0 +1,664 @@
+/*  Software audio mixer driven by an SDL audio callback, shared by the
+    audio lessons.
+
+    Sounds are converted to 32 bit float at the mixer's rate when they are
+    loaded. Each voice plays one sound with its own gain, pan and pitch and
+    is accumulated into a stereo float bus, with SSE2 or NEON when the build
+    targets them. A peak limiter then turns the bus into the output.
+
+    The main thread never touches voices. Its commands go through a lock
+    free ring and are applied at the start of the next callback, so neither
+    side waits on the other. When every voice is busy, a new sound takes the
+    lowest priority voice, the oldest among equals, as long as its own
+    priority is at least as high.                                       */
+
+#ifndef LMIXER_H
+#define LMIXER_H
+
+//  Using SDL, math, standard IO, strings, vectors, atomics and ring buffers
+#include <SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "LRingBuffer.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define LMIXER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define LMIXER_NEON
+#include <arm_neon.h>
+#endif
+
+//  Frames mixed at a time
+const int   MIXER_BLOCK_FRAMES  = 256;
+
+//  Bytes of room for commands between callbacks
+const int   MIXER_COMMAND_BYTES = 64 * 1024;
+
+//  Highest output level and how fast the limiter lets go, per frame
+const float MIXER_LIMIT         = 0.98f;
+const float MIXER_RELEASE       = 0.0002f;
+
+//  bus[ 2i ] += source[ i ] * left, bus[ 2i + 1 ] += source[ i ] * right
+inline void mixMonoSamples( float* bus, const float* source, int frames, float left, float right )
+{
+	int i = 0;
+
+	#if defined(LMIXER_SSE2)
+	__m128 gains = _mm_setr_ps( left, right, left, right );
+	for ( ; i + 4 <= frames; i += 4 )
+	{
+		//  Each sample twice, once for each side
+		__m128 samples  = _mm_loadu_ps( source + i );
+		__m128 low      = _mm_mul_ps( _mm_unpacklo_ps( samples, samples ), gains );
+		__m128 high     = _mm_mul_ps( _mm_unpackhi_ps( samples, samples ), gains );
+		_mm_storeu_ps( bus + i * 2    , _mm_add_ps( _mm_loadu_ps( bus + i * 2     ), low  ) );
+		_mm_storeu_ps( bus + i * 2 + 4, _mm_add_ps( _mm_loadu_ps( bus + i * 2 + 4 ), high ) );
+	}
+	#elif defined(LMIXER_NEON)
+	float32x4_t gains = { left, right, left, right };
+	for ( ; i + 4 <= frames; i += 4 )
+	{
+		//  Each sample twice, once for each side
+		float32x4_t     samples = vld1q_f32( source + i );
+		float32x4x2_t   pairs   = vzipq_f32( samples, samples );
+		vst1q_f32( bus + i * 2    , vmlaq_f32( vld1q_f32( bus + i * 2     ), pairs.val[ 0 ], gains ) );
+		vst1q_f32( bus + i * 2 + 4, vmlaq_f32( vld1q_f32( bus + i * 2 + 4 ), pairs.val[ 1 ], gains ) );
+	}
+	#endif
+
+	for ( ; i < frames; ++i )
+	{
+		bus[ i * 2     ] += source[ i ] * left;
+		bus[ i * 2 + 1 ] += source[ i ] * right;
+	}
+}
+
+//  bus[ 2i ] += source[ 2i ] * left, bus[ 2i + 1 ] += source[ 2i + 1 ] * right
+inline void mixStereoSamples( float* bus, const float* source, int frames, float left, float right )
+{
+	int i = 0;
+	int count = frames * 2;
+
+	#if defined(LMIXER_SSE2)
+	__m128 gains = _mm_setr_ps( left, right, left, right );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128 samples = _mm_mul_ps( _mm_loadu_ps( source + i ), gains );
+		_mm_storeu_ps( bus + i, _mm_add_ps( _mm_loadu_ps( bus + i ), samples ) );
+	}
+	#elif defined(LMIXER_NEON)
+	float32x4_t gains = { left, right, left, right };
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		vst1q_f32( bus + i, vmlaq_f32( vld1q_f32( bus + i ), vld1q_f32( source + i ), gains ) );
+	}
+	#endif
+
+	for ( ; i < count; i += 2 )
+	{
+		bus[ i     ] += source[ i     ] * left;
+		bus[ i + 1 ] += source[ i + 1 ] * right;
+	}
+}
+
+//  Float samples, mono or stereo, at the mixer's rate
+class LSound
+{
+	public:
+		//  Initializes an empty sound
+		LSound()
+		{
+			mFrames     = 0;
+			mChannels   = 0;
+		}
+
+		//  Loads a WAV file, converted to float at frequency. Sounds
+		//	with more than two channels are mixed down to stereo
+		bool loadFromFile( std::string path, int frequency )
+		{
+			//  Get rid of preexisting samples
+			free();
+
+			SDL_AudioSpec   spec;
+			Uint8*          buffer  = NULL;
+			Uint32          length  = 0;
+			if  ( SDL_LoadWAV( path.c_str(), &spec, &buffer, &length ) == NULL )
+			{
+				printf( "Unable to load sound %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+				return false;
+			}
+
+			//  Plan the conversion
+			int             channels = spec.channels == 1 ? 1 : 2;
+			SDL_AudioCVT    cvt;
+			if  ( SDL_BuildAudioCVT( &cvt, spec.format, spec.channels, spec.freq, AUDIO_F32SYS, channels, frequency ) < 0 )
+			{
+				printf( "Unable to convert sound %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+				SDL_FreeWAV( buffer );
+				return false;
+			}
+
+			//  Convert in a buffer big enough for every step
+			std::vector<Uint8> converted( length * cvt.len_mult );
+			memcpy( converted.data(), buffer, length );
+			SDL_FreeWAV( buffer );
+			cvt.buf = converted.data();
+			cvt.len = length;
+			if  ( SDL_ConvertAudio( &cvt ) < 0 )
+			{
+				printf( "Unable to convert sound %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+				return false;
+			}
+
+			mChannels   = channels;
+			mFrames     = cvt.len_cvt / ( (int) sizeof( float ) * channels );
+			mSamples.assign( (const float*) cvt.buf, (const float*) cvt.buf + mFrames * channels );
+
+			return true;
+		}
+
+		//  Frees the samples
+		void free()
+		{
+			std::vector<float>().swap( mSamples );
+			mFrames     = 0;
+			mChannels   = 0;
+		}
+
+		//  Gets the samples, interleaved when stereo
+		const float* getSamples() const { return mSamples.data(); }
+
+		//  Gets the length in frames and the channels per frame
+		int getFrames() const   { return mFrames; }
+		int getChannels() const { return mChannels; }
+
+	private:
+		//  The samples
+		std::vector<float>  mSamples;
+
+		//  Frames and channels per frame
+		int     mFrames;
+		int     mChannels;
+};
+
+//  Mixes voices into a stereo float stream
+class LMixer
+{
+	public:
+		//  Initializes an empty mixer
+		LMixer()
+		{
+			mDevice         = 0;
+			mFrequency      = 0;
+			mMaxVoices      = 0;
+			mNextId         = 1;
+			mLimiterGain    = 1.0f;
+			mActiveVoices   = 0;
+			mStolenVoices   = 0;
+			mDroppedVoices  = 0;
+			SDL_zero( mSpec );
+		}
+
+		//  Closes the mixer
+		~LMixer()
+		{
+			close();
+		}
+
+		//  Sets up room for maxVoices voices mixed at frequency
+		bool init( int maxVoices, int frequency )
+		{
+			close();
+
+			mFrequency  = frequency;
+			mMaxVoices  = maxVoices;
+			mVoices.reserve( maxVoices );
+			mBus.assign( MIXER_BLOCK_FRAMES * 2, 0.0f );
+			mScratch.assign( MIXER_BLOCK_FRAMES * 2, 0.0f );
+
+			return mCommands.allocate( MIXER_COMMAND_BYTES );
+		}
+
+		//  Opens the default audio device, asking for a buffer of samples
+		//	frames, and starts mixing into it
+		bool open( Uint16 samples )
+		{
+			SDL_AudioSpec desired;
+			SDL_zero( desired );
+			desired.freq        = mFrequency;
+			desired.format      = AUDIO_F32SYS;
+			desired.channels    = 2;
+			desired.samples     = samples;
+			desired.callback    = callback;
+			desired.userdata    = this;
+
+			//  SDL converts if the device wants something else
+			mDevice = SDL_OpenAudioDevice( NULL, SDL_FALSE, &desired, &mSpec, 0 );
+			if  ( mDevice == 0 )
+			{
+				printf( "Unable to open audio device! SDL Error: %s\n", SDL_GetError() );
+				return false;
+			}
+			SDL_PauseAudioDevice( mDevice, SDL_FALSE );
+
+			return true;
+		}
+
+		//  Stops the device and frees the voices
+		void close()
+		{
+			if  ( mDevice != 0 )
+			{
+				SDL_CloseAudioDevice( mDevice );
+				mDevice = 0;
+			}
+			std::vector<Voice>().swap( mVoices );
+			mCommands.free();
+			mActiveVoices = 0;
+		}
+
+		//  Starts a sound. Pan goes from -1 for left to 1 for right, pitch
+		//	scales the playback rate. Returns the voice for the commands
+		//	below, or 0 when too many commands are waiting
+		Uint32 play( const LSound* sound, float gain = 1.0f, float pan = 0.0f, float pitch = 1.0f, int priority = 0, bool loop = false )
+		{
+			Command command = { PLAY, mNextId, sound, gain, pan, pitch, priority, loop };
+			if  ( sound == NULL || sound->getFrames() == 0 || !send( command ) )
+			{
+				return 0;
+			}
+
+			return mNextId++;
+		}
+
+		//  Stops, pauses or resumes a voice
+		void stop( Uint32 voice )   { send( { STOP,   voice, NULL, 0.0f, 0.0f, 0.0f, 0, false } ); }
+		void pause( Uint32 voice )  { send( { PAUSE,  voice, NULL, 0.0f, 0.0f, 0.0f, 0, false } ); }
+		void resume( Uint32 voice ) { send( { RESUME, voice, NULL, 0.0f, 0.0f, 0.0f, 0, false } ); }
+
+		//  Changes a playing voice
+		void setVoice( Uint32 voice, float gain, float pan, float pitch )
+		{
+			send( { SET, voice, NULL, gain, pan, pitch, 0, false } );
+		}
+
+		//  Mixes frames of interleaved stereo into out. The audio callback
+		//	calls this, or anything else wanting samples without a device
+		void mix( float* out, int frames )
+		{
+			runCommands();
+
+			while   ( frames > 0 )
+			{
+				int block = SDL_min( frames, MIXER_BLOCK_FRAMES );
+				memset( mBus.data(), 0, block * 2 * sizeof( float ) );
+
+				//  Accumulate every voice, dropping the ones that finish
+				size_t i = 0;
+				while   ( i < mVoices.size() )
+				{
+					if  ( mVoices[ i ].paused || mixVoice( mVoices[ i ], block ) )
+					{
+						++i;
+					}
+					else
+					{
+						mVoices[ i ] = mVoices.back();
+						mVoices.pop_back();
+					}
+				}
+
+				limit( out, block );
+				out     += block * 2;
+				frames  -= block;
+			}
+
+			mActiveVoices.store( (int) mVoices.size(), std::memory_order_relaxed );
+		}
+
+		//  Gets what the device was opened with
+		const SDL_AudioSpec& getSpec() const { return mSpec; }
+
+		//  Gets the voices playing after the last callback
+		int getActiveVoices() const { return mActiveVoices.load( std::memory_order_relaxed ); }
+
+		//  Gets voices taken over by new sounds and sounds that found no voice
+		Uint32 getStolenVoices() const  { return mStolenVoices.load( std::memory_order_relaxed ); }
+		Uint32 getDroppedVoices() const { return mDroppedVoices.load( std::memory_order_relaxed ); }
+
+	private:
+		//  What a command does
+		enum CommandType
+		{
+			PLAY    ,
+			STOP    ,
+			PAUSE   ,
+			RESUME  ,
+			SET
+		};
+
+		//  A command from the main thread
+		struct Command
+		{
+			CommandType     type;
+			Uint32          voice;
+			const LSound*   sound;
+			float           gain, pan, pitch;
+			int             priority;
+			bool            loop;
+		};
+
+		//  A playing sound
+		struct Voice
+		{
+			const LSound*   sound;
+			Uint32          id;
+			double          position;
+			float           gain, pan, pitch;
+			int             priority;
+			bool            loop, paused;
+		};
+
+		//  Queues a whole command or nothing, so the callback never sees half of one
+		bool send( const Command& command )
+		{
+			if  ( mCommands.getWritable() < sizeof( Command ) )
+			{
+				printf( "Mixer command queue is full!\n" );
+				return false;
+			}
+			mCommands.write( &command, sizeof( Command ) );
+
+			return true;
+		}
+
+		//  Applies the waiting commands
+		void runCommands()
+		{
+			Command command;
+			while   ( mCommands.getReadable() >= sizeof( Command ) )
+			{
+				mCommands.read( &command, sizeof( Command ) );
+				if  ( command.type == PLAY )
+				{
+					startVoice( command );
+					continue;
+				}
+
+				Voice* voice = findVoice( command.voice );
+				if  ( voice == NULL )
+				{
+					continue;
+				}
+				switch  ( command.type )
+				{
+					case    STOP:
+						*voice = mVoices.back();
+						mVoices.pop_back();
+						break;
+
+					case    PAUSE:
+						voice->paused = true;
+						break;
+
+					case    RESUME:
+						voice->paused = false;
+						break;
+
+					case    SET:
+						voice->gain     = command.gain;
+						voice->pan      = SDL_clamp( command.pan, -1.0f, 1.0f );
+						voice->pitch    = SDL_max( command.pitch, 0.01f );
+						break;
+
+					case    PLAY:
+						break;
+				}
+			}
+		}
+
+		//  Finds a playing voice
+		Voice* findVoice( Uint32 id )
+		{
+			for ( Voice& voice : mVoices )
+			{
+				if  ( voice.id == id )
+				{
+					return &voice;
+				}
+			}
+
+			return NULL;
+		}
+
+		//  Starts a voice, taking one over if all are busy
+		void startVoice( const Command& command )
+		{
+			Voice voice =
+                {
+                    command.sound                           ,
+                    command.voice                           ,
+                    0.0                                     ,
+                    command.gain                            ,
+                    SDL_clamp( command.pan, -1.0f, 1.0f )   ,
+                    SDL_max( command.pitch, 0.01f )         ,
+                    command.priority                        ,
+                    command.loop                            ,
+                    false
+                };
+
+			if  ( (int) mVoices.size() < mMaxVoices )
+			{
+				mVoices.push_back( voice );
+				return;
+			}
+			if  ( mVoices.empty() )
+			{
+				mDroppedVoices.fetch_add( 1, std::memory_order_relaxed );
+				return;
+			}
+
+			//  Lowest priority, oldest first
+			Voice* victim = &mVoices[ 0 ];
+			for ( Voice& other : mVoices )
+			{
+				if  ( other.priority < victim->priority || ( other.priority == victim->priority && other.id < victim->id ) )
+				{
+					victim = &other;
+				}
+			}
+
+			if  ( victim->priority > voice.priority )
+			{
+				mDroppedVoices.fetch_add( 1, std::memory_order_relaxed );
+				return;
+			}
+			*victim = voice;
+			mStolenVoices.fetch_add( 1, std::memory_order_relaxed );
+		}
+
+		//  Adds frames of a voice to the bus, returns false once it has ended
+		bool mixVoice( Voice& voice, int frames )
+		{
+			const float*    samples     = voice.sound->getSamples();
+			int             length      = voice.sound->getFrames();
+			int             channels    = voice.sound->getChannels();
+
+			//  Constant power pan for mono, balance for stereo
+			float left, right;
+			if  ( channels == 1 )
+			{
+				float angle = ( voice.pan + 1.0f ) * (float) M_PI / 4.0f;
+				left    = voice.gain * cosf( angle );
+				right   = voice.gain * sinf( angle );
+			}
+			else
+			{
+				left    = voice.gain * SDL_min( 1.0f, 1.0f - voice.pan );
+				right   = voice.gain * SDL_min( 1.0f, 1.0f + voice.pan );
+			}
+
+			int done = 0;
+			while   ( done < frames )
+			{
+				const float*    source;
+				int             count;
+
+				//  At the original pitch the sound is mixed straight from its samples
+				if  ( voice.pitch == 1.0f && voice.position == floor( voice.position ) )
+				{
+					int start   = (int) voice.position;
+					count       = SDL_min( frames - done, length - start );
+					source      = samples + start * channels;
+					voice.position += count;
+				}
+				//  Otherwise it is resampled into scratch first
+				else
+				{
+					count   = resample( voice, frames - done );
+					source  = mScratch.data();
+				}
+
+				if  ( channels == 1 )
+				{
+					mixMonoSamples( mBus.data() + done * 2, source, count, left, right );
+				}
+				else
+				{
+					mixStereoSamples( mBus.data() + done * 2, source, count, left, right );
+				}
+				done += count;
+
+				//  At the end go round again or stop
+				if  ( voice.position >= length )
+				{
+					if  ( !voice.loop )
+					{
+						return false;
+					}
+					voice.position = fmod( voice.position, length );
+				}
+			}
+
+			return true;
+		}
+
+		//  Linearly interpolates up to frames of a voice into scratch,
+		//	stopping at the end of the sound. Returns the frames made
+		int resample( Voice& voice, int frames )
+		{
+			const float*    samples     = voice.sound->getSamples();
+			int             length      = voice.sound->getFrames();
+			int             channels    = voice.sound->getChannels();
+			float*          scratch     = mScratch.data();
+			double          position    = voice.position;
+
+			int     count   = 0;
+			double  pitch   = voice.pitch;
+
+			//  Frames followed by another frame of the sound need no checks
+			if  ( channels == 1 )
+			{
+				while   ( count < frames && position < length - 1 )
+				{
+					int             index       = (int) position;
+					float           fraction    = (float)( position - index );
+					const float*    a           = samples + index;
+					scratch[ count ] = a[ 0 ] + ( a[ 1 ] - a[ 0 ] ) * fraction;
+					position += pitch;
+					++count;
+				}
+			}
+			else
+			{
+				while   ( count < frames && position < length - 1 )
+				{
+					int             index       = (int) position;
+					float           fraction    = (float)( position - index );
+					const float*    a           = samples + index * 2;
+					scratch[ count * 2     ] = a[ 0 ] + ( a[ 2 ] - a[ 0 ] ) * fraction;
+					scratch[ count * 2 + 1 ] = a[ 1 ] + ( a[ 3 ] - a[ 1 ] ) * fraction;
+					position += pitch;
+					++count;
+				}
+			}
+
+			//  The last frame leads into the first when looping, silence otherwise
+			while   ( count < frames && position < length )
+			{
+				float           fraction    = (float)( position - ( length - 1 ) );
+				const float*    a           = samples + ( length - 1 ) * channels;
+				for ( int c = 0; c < channels; ++c )
+				{
+					float b = voice.loop ? samples[ c ] : 0.0f;
+					scratch[ count * channels + c ] = a[ c ] + ( b - a[ c ] ) * fraction;
+				}
+				position += pitch;
+				++count;
+			}
+			voice.position = position;
+
+			return count;
+		}
+
+		//  Copies the bus to out, turning it down where it would pass the
+		//	limit and back up slowly afterwards
+		void limit( float* out, int frames )
+		{
+			const float*    bus     = mBus.data();
+			float           gain    = mLimiterGain;
+
+			for ( int i = 0; i < frames; ++i )
+			{
+				float peak = SDL_max( fabsf( bus[ i * 2 ] ), fabsf( bus[ i * 2 + 1 ] ) );
+				gain += ( 1.0f - gain ) * MIXER_RELEASE;
+				if  ( peak * gain > MIXER_LIMIT )
+				{
+					gain = MIXER_LIMIT / peak;
+				}
+
+				out[ i * 2     ] = bus[ i * 2     ] * gain;
+				out[ i * 2 + 1 ] = bus[ i * 2 + 1 ] * gain;
+			}
+
+			mLimiterGain = gain;
+		}
+
+		//  Mixes for SDL
+		static void callback( void* userdata, Uint8* stream, int len )
+		{
+			( (LMixer*) userdata )->mix( (float*) stream, len / (int)( 2 * sizeof( float ) ) );
+		}
+
+		//  The device and what it was opened with
+		SDL_AudioDeviceID   mDevice;
+		SDL_AudioSpec       mSpec;
+		int                 mFrequency;
+
+		//  Playing voices, only touched by mix
+		std::vector<Voice>  mVoices;
+		int                 mMaxVoices;
+
+		//  Stereo bus and resampling space for one block
+		std::vector<float>  mBus;
+		std::vector<float>  mScratch;
+
+		//  Commands from the main thread and the id of the next voice
+		LRingBuffer         mCommands;
+		Uint32              mNextId;
+
+		//  Limiter gain carried between blocks
+		float               mLimiterGain;
+
+		//  Statistics for the main thread
+		std::atomic<int>    mActiveVoices;
+		std::atomic<Uint32> mStolenVoices;
+		std::atomic<Uint32> mDroppedVoices;
+};
+
+#endif
@@ -0,0 +1,514 @@
+/*  Pixel kernels shared by the texture manipulation lessons.
+
+    Loops over 32 bit pixels with SSE2, AVX2 and NEON versions. The best
+    set the CPU supports is picked the first time a kernel is called, using
+    SDL's CPU feature detection. Every set gives exactly the same results
+    as the scalar reference functions.                                  */
+
+#ifndef LPIXELKERNELS_H
+#define LPIXELKERNELS_H
+
+//  Using SDL and the compiler intrinsics
+#include <SDL.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LPIXEL_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define LPIXEL_NEON
+#include <arm_neon.h>
+#endif
+
+//  GCC and Clang only emit instructions the build targets unless told per function
+#if defined(__GNUC__)
+#define LPIXEL_TARGET( isa ) __attribute__(( target( isa ) ))
+#else
+#define LPIXEL_TARGET( isa )
+#endif
+
+//  One implementation of every kernel
+struct LPixelKernelSet
+{
+	//  Name for logging
+	const char* name;
+
+	//  Replaces every pixel equal to colorKey with replacement
+	void    ( *colorKey     )( Uint32* pixels, int count, Uint32 colorKey, Uint32 replacement );
+
+	//  Multiplies the color channels by the alpha channel selected by alphaMask
+	void    ( *premultiply  )( Uint32* pixels, int count, Uint32 alphaMask );
+
+	//  Byte i of every pixel, counting from the least significant,
+	//	is taken from byte order[ i ]
+	void    ( *swizzle      )( Uint32* pixels, int count, const Uint8 order[ 4 ] );
+
+	//  Sets marks[ i ] to all ones where pixels[ i ] differs from value,
+	//	leaves it alone otherwise. Returns whether any pixel differed
+	bool    ( *markNotEqual )( const Uint32* pixels, int count, Uint32 value, Uint32* marks );
+};
+
+//  Rounded c * a / 255, exact for every 8 bit input
+inline Uint32 premultiplyChannel( Uint32 c, Uint32 a )
+{
+	Uint32 t = c * a + 128;
+	return ( t + ( t >> 8 ) ) >> 8;
+}
+
+//  Byte index of an 8 bit alpha mask, -1 when there is none
+inline int alphaByteFromMask( Uint32 alphaMask )
+{
+	for ( int i = 0; i < 4; ++i )
+	{
+		if  ( alphaMask == ( 0xFFu << ( i * 8 ) ) )
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+inline void colorKeyPixelsScalar( Uint32* pixels, int count, Uint32 colorKey, Uint32 replacement )
+{
+	for ( int i = 0; i < count; ++i )
+	{
+		if  ( pixels[ i ] == colorKey )
+		{
+			pixels[ i ] = replacement;
+		}
+	}
+}
+
+inline void premultiplyPixelsScalar( Uint32* pixels, int count, Uint32 alphaMask )
+{
+	int alphaByte = alphaByteFromMask( alphaMask );
+	if  ( alphaByte < 0 )
+	{
+		return;
+	}
+
+	for ( int i = 0; i < count; ++i )
+	{
+		Uint32 pixel    = pixels[ i ];
+		Uint32 alpha    = ( pixel >> ( alphaByte * 8 ) ) & 0xFF;
+		Uint32 result   = pixel & alphaMask;
+
+		for ( int c = 0; c < 4; ++c )
+		{
+			if  ( c != alphaByte )
+			{
+				result |= premultiplyChannel( ( pixel >> ( c * 8 ) ) & 0xFF, alpha ) << ( c * 8 );
+			}
+		}
+
+		pixels[ i ] = result;
+	}
+}
+
+inline void swizzlePixelsScalar( Uint32* pixels, int count, const Uint8 order[ 4 ] )
+{
+	for ( int i = 0; i < count; ++i )
+	{
+		Uint32 pixel    = pixels[ i ];
+		Uint32 result   = 0;
+
+		for ( int c = 0; c < 4; ++c )
+		{
+			result |= ( ( pixel >> ( order[ c ] * 8 ) ) & 0xFF ) << ( c * 8 );
+		}
+
+		pixels[ i ] = result;
+	}
+}
+
+inline bool markPixelsNotEqualScalar( const Uint32* pixels, int count, Uint32 value, Uint32* marks )
+{
+	Uint32 any = 0;
+	for ( int i = 0; i < count; ++i )
+	{
+		Uint32 mark = pixels[ i ] != value ? 0xFFFFFFFF : 0;
+		marks[ i ] |= mark;
+		any |= mark;
+	}
+
+	return any != 0;
+}
+
+#if defined(LPIXEL_X86)
+LPIXEL_TARGET( "sse2" )
+inline void colorKeyPixelsSSE2( Uint32* pixels, int count, Uint32 colorKey, Uint32 replacement )
+{
+	__m128i key = _mm_set1_epi32( (int) colorKey );
+	__m128i rep = _mm_set1_epi32( (int) replacement );
+
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128i p   = _mm_loadu_si128( (__m128i*)( pixels + i ) );
+		__m128i hit = _mm_cmpeq_epi32( p, key );
+		p = _mm_or_si128( _mm_andnot_si128( hit, p ), _mm_and_si128( hit, rep ) );
+		_mm_storeu_si128( (__m128i*)( pixels + i ), p );
+	}
+
+	colorKeyPixelsScalar( pixels + i, count - i, colorKey, replacement );
+}
+
+//  Alpha word index is a template argument, the shuffles need immediates
+template <int A>
+LPIXEL_TARGET( "sse2" )
+inline __m128i premultiplyWordsSSE2( __m128i words )
+{
+	__m128i alpha = _mm_shufflelo_epi16( words, _MM_SHUFFLE( A, A, A, A ) );
+	alpha = _mm_shufflehi_epi16( alpha, _MM_SHUFFLE( A, A, A, A ) );
+
+	__m128i t = _mm_add_epi16( _mm_mullo_epi16( words, alpha ), _mm_set1_epi16( 128 ) );
+	return _mm_srli_epi16( _mm_add_epi16( t, _mm_srli_epi16( t, 8 ) ), 8 );
+}
+
+template <int A>
+LPIXEL_TARGET( "sse2" )
+inline void premultiplyPixelsSSE2( Uint32* pixels, int count, Uint32 alphaMask )
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i keep = _mm_set1_epi32( (int) alphaMask );
+
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128i p   = _mm_loadu_si128( (__m128i*)( pixels + i ) );
+		__m128i lo  = premultiplyWordsSSE2<A>( _mm_unpacklo_epi8( p, zero ) );
+		__m128i hi  = premultiplyWordsSSE2<A>( _mm_unpackhi_epi8( p, zero ) );
+		__m128i out = _mm_packus_epi16( lo, hi );
+
+		//  Alpha itself is kept
+		out = _mm_or_si128( _mm_andnot_si128( keep, out ), _mm_and_si128( keep, p ) );
+		_mm_storeu_si128( (__m128i*)( pixels + i ), out );
+	}
+
+	premultiplyPixelsScalar( pixels + i, count - i, alphaMask );
+}
+
+LPIXEL_TARGET( "sse2" )
+inline void swizzlePixelsSSE2( Uint32* pixels, int count, const Uint8 order[ 4 ] )
+{
+	__m128i byteMask = _mm_set1_epi32( 0xFF );
+
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128i p   = _mm_loadu_si128( (__m128i*)( pixels + i ) );
+		__m128i out = _mm_setzero_si128();
+
+		for ( int c = 0; c < 4; ++c )
+		{
+			__m128i channel = _mm_srl_epi32( p, _mm_cvtsi32_si128( order[ c ] * 8 ) );
+			channel = _mm_and_si128( channel, byteMask );
+			out     = _mm_or_si128( out, _mm_sll_epi32( channel, _mm_cvtsi32_si128( c * 8 ) ) );
+		}
+
+		_mm_storeu_si128( (__m128i*)( pixels + i ), out );
+	}
+
+	swizzlePixelsScalar( pixels + i, count - i, order );
+}
+
+LPIXEL_TARGET( "sse2" )
+inline bool markPixelsNotEqualSSE2( const Uint32* pixels, int count, Uint32 value, Uint32* marks )
+{
+	__m128i v   = _mm_set1_epi32( (int) value );
+	__m128i any = _mm_setzero_si128();
+
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		//  Equal lanes are all ones, so the difference is the equality inverted
+		__m128i same = _mm_cmpeq_epi32( _mm_loadu_si128( (const __m128i*)( pixels + i ) ), v );
+		__m128i diff = _mm_andnot_si128( same, _mm_set1_epi32( -1 ) );
+		__m128i mark = _mm_loadu_si128( (__m128i*)( marks + i ) );
+		_mm_storeu_si128( (__m128i*)( marks + i ), _mm_or_si128( mark, diff ) );
+		any = _mm_or_si128( any, diff );
+	}
+
+	bool found = _mm_movemask_epi8( any ) != 0;
+	return markPixelsNotEqualScalar( pixels + i, count - i, value, marks + i ) || found;
+}
+
+LPIXEL_TARGET( "avx2" )
+inline void colorKeyPixelsAVX2( Uint32* pixels, int count, Uint32 colorKey, Uint32 replacement )
+{
+	__m256i key = _mm256_set1_epi32( (int) colorKey );
+	__m256i rep = _mm256_set1_epi32( (int) replacement );
+
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m256i p   = _mm256_loadu_si256( (__m256i*)( pixels + i ) );
+		__m256i hit = _mm256_cmpeq_epi32( p, key );
+		_mm256_storeu_si256( (__m256i*)( pixels + i ), _mm256_blendv_epi8( p, rep, hit ) );
+	}
+
+	colorKeyPixelsScalar( pixels + i, count - i, colorKey, replacement );
+}
+
+template <int A>
+LPIXEL_TARGET( "avx2" )
+inline __m256i premultiplyWordsAVX2( __m256i words )
+{
+	__m256i alpha = _mm256_shufflelo_epi16( words, _MM_SHUFFLE( A, A, A, A ) );
+	alpha = _mm256_shufflehi_epi16( alpha, _MM_SHUFFLE( A, A, A, A ) );
+
+	__m256i t = _mm256_add_epi16( _mm256_mullo_epi16( words, alpha ), _mm256_set1_epi16( 128 ) );
+	return _mm256_srli_epi16( _mm256_add_epi16( t, _mm256_srli_epi16( t, 8 ) ), 8 );
+}
+
+template <int A>
+LPIXEL_TARGET( "avx2" )
+inline void premultiplyPixelsAVX2( Uint32* pixels, int count, Uint32 alphaMask )
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i keep = _mm256_set1_epi32( (int) alphaMask );
+
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		//  Unpacking and packing both work per 128 bit lane, so pixels stay in place
+		__m256i p   = _mm256_loadu_si256( (__m256i*)( pixels + i ) );
+		__m256i lo  = premultiplyWordsAVX2<A>( _mm256_unpacklo_epi8( p, zero ) );
+		__m256i hi  = premultiplyWordsAVX2<A>( _mm256_unpackhi_epi8( p, zero ) );
+		__m256i out = _mm256_packus_epi16( lo, hi );
+
+		_mm256_storeu_si256( (__m256i*)( pixels + i ), _mm256_blendv_epi8( out, p, keep ) );
+	}
+
+	premultiplyPixelsScalar( pixels + i, count - i, alphaMask );
+}
+
+LPIXEL_TARGET( "avx2" )
+inline void swizzlePixelsAVX2( Uint32* pixels, int count, const Uint8 order[ 4 ] )
+{
+	//  Byte shuffle, x86 is little endian so byte c of the value is byte c in memory
+	alignas( 32 ) Uint8 table[ 32 ];
+	for ( int b = 0; b < 32; ++b )
+	{
+		table[ b ] = (Uint8)( ( ( b % 16 ) / 4 ) * 4 + order[ b % 4 ] );
+	}
+	__m256i shuffle = _mm256_load_si256( (__m256i*) table );
+
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m256i p = _mm256_loadu_si256( (__m256i*)( pixels + i ) );
+		_mm256_storeu_si256( (__m256i*)( pixels + i ), _mm256_shuffle_epi8( p, shuffle ) );
+	}
+
+	swizzlePixelsScalar( pixels + i, count - i, order );
+}
+
+LPIXEL_TARGET( "avx2" )
+inline bool markPixelsNotEqualAVX2( const Uint32* pixels, int count, Uint32 value, Uint32* marks )
+{
+	__m256i v   = _mm256_set1_epi32( (int) value );
+	__m256i any = _mm256_setzero_si256();
+
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m256i same = _mm256_cmpeq_epi32( _mm256_loadu_si256( (const __m256i*)( pixels + i ) ), v );
+		__m256i diff = _mm256_andnot_si256( same, _mm256_set1_epi32( -1 ) );
+		__m256i mark = _mm256_loadu_si256( (__m256i*)( marks + i ) );
+		_mm256_storeu_si256( (__m256i*)( marks + i ), _mm256_or_si256( mark, diff ) );
+		any = _mm256_or_si256( any, diff );
+	}
+
+	bool found = _mm256_movemask_epi8( any ) != 0;
+	return markPixelsNotEqualScalar( pixels + i, count - i, value, marks + i ) || found;
+}
+#endif
+
+#if defined(LPIXEL_NEON)
+inline void colorKeyPixelsNEON( Uint32* pixels, int count, Uint32 colorKey, Uint32 replacement )
+{
+	uint32x4_t key = vdupq_n_u32( colorKey );
+	uint32x4_t rep = vdupq_n_u32( replacement );
+
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		uint32x4_t p = vld1q_u32( pixels + i );
+		vst1q_u32( pixels + i, vbslq_u32( vceqq_u32( p, key ), rep, p ) );
+	}
+
+	colorKeyPixelsScalar( pixels + i, count - i, colorKey, replacement );
+}
+
+inline void premultiplyPixelsNEON( Uint32* pixels, int count, Uint32 alphaMask )
+{
+	int alphaByte = alphaByteFromMask( alphaMask );
+	if  ( alphaByte < 0 )
+	{
+		return;
+	}
+
+	int i = 0;
+	for ( ; i + 16 <= count; i += 16 )
+	{
+		//  Split sixteen pixels into one register per channel
+		uint8x16x4_t    p       = vld4q_u8( (Uint8*)( pixels + i ) );
+		uint8x16_t      alpha   = p.val[ alphaByte ];
+
+		for ( int c = 0; c < 4; ++c )
+		{
+			if  ( c == alphaByte )
+			{
+				continue;
+			}
+
+			uint16x8_t lo = vaddq_u16( vmull_u8( vget_low_u8 ( p.val[ c ] ), vget_low_u8 ( alpha ) ), vdupq_n_u16( 128 ) );
+			uint16x8_t hi = vaddq_u16( vmull_u8( vget_high_u8( p.val[ c ] ), vget_high_u8( alpha ) ), vdupq_n_u16( 128 ) );
+			p.val[ c ] =
+                vcombine_u8(
+                    vshrn_n_u16( vaddq_u16( lo, vshrq_n_u16( lo, 8 ) ), 8 ) ,
+                    vshrn_n_u16( vaddq_u16( hi, vshrq_n_u16( hi, 8 ) ), 8 )
+                );
+		}
+
+		vst4q_u8( (Uint8*)( pixels + i ), p );
+	}
+
+	premultiplyPixelsScalar( pixels + i, count - i, alphaMask );
+}
+
+inline void swizzlePixelsNEON( Uint32* pixels, int count, const Uint8 order[ 4 ] )
+{
+	//  Byte table lookup, little endian like x86
+	Uint8 table[ 16 ];
+	for ( int b = 0; b < 16; ++b )
+	{
+		table[ b ] = (Uint8)( ( b / 4 ) * 4 + order[ b % 4 ] );
+	}
+	uint8x16_t shuffle = vld1q_u8( table );
+
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		uint8x16_t p = vld1q_u8( (Uint8*)( pixels + i ) );
+		vst1q_u8( (Uint8*)( pixels + i ), vqtbl1q_u8( p, shuffle ) );
+	}
+
+	swizzlePixelsScalar( pixels + i, count - i, order );
+}
+
+inline bool markPixelsNotEqualNEON( const Uint32* pixels, int count, Uint32 value, Uint32* marks )
+{
+	uint32x4_t v   = vdupq_n_u32( value );
+	uint32x4_t any = vdupq_n_u32( 0 );
+
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		uint32x4_t diff = vmvnq_u32( vceqq_u32( vld1q_u32( pixels + i ), v ) );
+		vst1q_u32( marks + i, vorrq_u32( vld1q_u32( marks + i ), diff ) );
+		any = vorrq_u32( any, diff );
+	}
+
+	bool found = vmaxvq_u32( any ) != 0;
+	return markPixelsNotEqualScalar( pixels + i, count - i, value, marks + i ) || found;
+}
+#endif
+
+//  Picks the premultiply instantiation for the alpha position
+#define LPIXEL_PREMULTIPLY_DISPATCH( isa )                                      \
+inline void premultiplyPixels##isa##Any( Uint32* pixels, int count, Uint32 alphaMask ) \
+{                                                                               \
+	switch  ( alphaByteFromMask( alphaMask ) )                                  \
+	{                                                                           \
+		case 0: premultiplyPixels##isa<0>( pixels, count, alphaMask ); break;   \
+		case 1: premultiplyPixels##isa<1>( pixels, count, alphaMask ); break;   \
+		case 2: premultiplyPixels##isa<2>( pixels, count, alphaMask ); break;   \
+		case 3: premultiplyPixels##isa<3>( pixels, count, alphaMask ); break;   \
+	}                                                                           \
+}
+
+#if defined(LPIXEL_X86)
+LPIXEL_PREMULTIPLY_DISPATCH( SSE2 )
+LPIXEL_PREMULTIPLY_DISPATCH( AVX2 )
+#endif
+
+//  Gets every kernel set this CPU can run, scalar first and best last
+inline int getPixelKernelSets( const LPixelKernelSet** sets )
+{
+	static const LPixelKernelSet scalar =
+        { "scalar", colorKeyPixelsScalar, premultiplyPixelsScalar, swizzlePixelsScalar, markPixelsNotEqualScalar };
+
+	int count = 0;
+	sets[ count++ ] = &scalar;
+
+	#if defined(LPIXEL_X86)
+	static const LPixelKernelSet sse2 =
+        { "SSE2", colorKeyPixelsSSE2, premultiplyPixelsSSE2Any, swizzlePixelsSSE2, markPixelsNotEqualSSE2 };
+	static const LPixelKernelSet avx2 =
+        { "AVX2", colorKeyPixelsAVX2, premultiplyPixelsAVX2Any, swizzlePixelsAVX2, markPixelsNotEqualAVX2 };
+
+	if  ( SDL_HasSSE2() )
+	{
+		sets[ count++ ] = &sse2;
+	}
+	if  ( SDL_HasAVX2() )
+	{
+		sets[ count++ ] = &avx2;
+	}
+	#endif
+
+	#if defined(LPIXEL_NEON)
+	static const LPixelKernelSet neon =
+        { "NEON", colorKeyPixelsNEON, premultiplyPixelsNEON, swizzlePixelsNEON, markPixelsNotEqualNEON };
+
+	if  ( SDL_HasNEON() )
+	{
+		sets[ count++ ] = &neon;
+	}
+	#endif
+
+	return count;
+}
+
+//  Gets the best kernel set, chosen once
+inline const LPixelKernelSet& getPixelKernels()
+{
+	static const LPixelKernelSet* best =
+        []()
+        {
+            const LPixelKernelSet* sets[ 4 ];
+            return sets[ getPixelKernelSets( sets ) - 1 ];
+        }();
+
+	return *best;
+}
+
+//  Replaces every pixel equal to colorKey with replacement
+inline void colorKeyPixels( Uint32* pixels, int count, Uint32 colorKey, Uint32 replacement )
+{
+	getPixelKernels().colorKey( pixels, count, colorKey, replacement );
+}
+
+//  Multiplies the color channels by alpha, alphaMask comes from SDL_PixelFormat::Amask
+inline void premultiplyPixels( Uint32* pixels, int count, Uint32 alphaMask )
+{
+	getPixelKernels().premultiply( pixels, count, alphaMask );
+}
+
+//  Reorders the bytes of every pixel, see LPixelKernelSet::swizzle
+inline void swizzlePixels( Uint32* pixels, int count, const Uint8 order[ 4 ] )
+{
+	getPixelKernels().swizzle( pixels, count, order );
+}
+
+//  Marks pixels that differ from value, see LPixelKernelSet::markNotEqual
+inline bool markPixelsNotEqual( const Uint32* pixels, int count, Uint32 value, Uint32* marks )
+{
+	return getPixelKernels().markNotEqual( pixels, count, value, marks );
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*  Typed access to locked 32 bit pixels, shared by the texture
+    manipulation lessons.
+
+    The pitch is converted to pixels once, rows come out as spans, and
+    every access is bounds checked with SDL_assert. SDL_assert ignores
+    NDEBUG: it only checks at SDL_ASSERT_LEVEL 2 or more, which is the
+    default when DEBUG or _DEBUG is defined. Otherwise the level is 1
+    and the checks compile away.                                   */
+
+#ifndef LPIXELVIEW_H
+#define LPIXELVIEW_H
+
+//  Using SDL and spans
+#include <SDL.h>
+#include <span>
+
+//  View over a block of 32 bit pixels
+class LPixelView
+{
+	public:
+		//  Initializes an empty view
+		LPixelView()
+		{
+			mPixels = NULL;
+			mPitch  = 0;
+			mWidth  = 0;
+			mHeight = 0;
+		}
+
+		//  Wraps pixels with a pitch in bytes, as SDL_LockTexture returns them
+		LPixelView( void* pixels, int pitch, int width, int height )
+		{
+			mPixels = (Uint32*) pixels;
+			mPitch  = pitch / 4;
+			mWidth  = width;
+			mHeight = height;
+		}
+
+		//  Gets dimensions, the pitch is in pixels
+		int getWidth()  const { return mWidth; }
+		int getHeight() const { return mHeight; }
+		int getPitch()  const { return mPitch; }
+
+		//  Gets the first pixel of a row
+		Uint32* getRow( int y ) const
+		{
+			SDL_assert( mPixels != NULL && y >= 0 && y < mHeight );
+			return mPixels + y * mPitch;
+		}
+
+		//  Gets the visible pixels of a row
+		std::span<Uint32> getRowSpan( int y ) const
+		{
+			return std::span<Uint32>( getRow( y ), mWidth );
+		}
+
+		//  Gets a pixel
+		Uint32& at( int x, int y ) const
+		{
+			SDL_assert( x >= 0 && x < mWidth );
+			return getRow( y )[ x ];
+		}
+
+		//  Calls function( std::span<Uint32> row, int y ) for every row
+		template <typename Function>
+		void forEachRow( Function function ) const
+		{
+			for ( int y = 0; y < mHeight; ++y )
+			{
+				function( std::span<Uint32>( mPixels + y * mPitch, mWidth ), y );
+			}
+		}
+
+		//  Calls function( Uint32& pixel ) for every pixel, the inner loop
+		//	has no index math so the compiler can vectorize it
+		template <typename Function>
+		void forEachPixel( Function function ) const
+		{
+			for ( int y = 0; y < mHeight; ++y )
+			{
+				Uint32* row = mPixels + y * mPitch;
+				for ( int x = 0; x < mWidth; ++x )
+				{
+					function( row[ x ] );
+				}
+			}
+		}
+
+	private:
+		//  First pixel
+		Uint32* mPixels;
+
+		//  Row length in pixels, padding included
+		int     mPitch;
+
+		//  Visible dimensions
+		int     mWidth;
+		int     mHeight;
+};
+
+#endif
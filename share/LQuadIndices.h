@@ -0,0 +1,24 @@
+/*  Index list for drawing quads with SDL_RenderGeometry, shared by the
+    lessons that batch sprites and glyphs.
+
+    Quad q is vertices 4q to 4q + 3, clockwise from the top left, drawn
+    as two triangles. The indices are the same for every batch, so one
+    list that only ever grows serves any number of quads.           */
+
+#ifndef LQUADINDICES_H
+#define LQUADINDICES_H
+
+//  Using vectors
+#include <vector>
+
+//  Makes sure indices covers at least quads quads
+inline void growQuadIndices( std::vector<int>& indices, int quads )
+{
+	for ( int q = (int) indices.size() / 6; q < quads; ++q )
+	{
+		int quad[ 6 ] = { q * 4, q * 4 + 1, q * 4 + 2, q * 4 + 2, q * 4 + 3, q * 4 };
+		indices.insert( indices.end(), quad, quad + 6 );
+	}
+}
+
+#endif
@@ -0,0 +1,679 @@
+/*  Streaming sample rate and format conversion, shared by the audio
+    lessons.
+
+    LResampler is a polyphase windowed sinc resampler for interleaved
+    float. Converting by L / M, the ratio of the rates reduced, needs L
+    phases of the filter. They are tabled once, or, when L is too large,
+    257 evenly spaced phases are tabled and neighbours blended. Every
+    output frame is then one dot product per channel, done 4 taps at a
+    time with SSE2 or NEON. The history and tables are allocated by init,
+    so converting never allocates.
+
+    LAudioConverter wraps it for SDL audio formats, turning blocks of
+    samples to float and back and mapping channels around the resampler.
+    The filter holds back half its taps, so the end of a stream has to be
+    flushed out with silence.                                           */
+
+#ifndef LRESAMPLER_H
+#define LRESAMPLER_H
+
+//  Using SDL, algorithms, math, strings and vectors
+#include <SDL.h>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define LRESAMPLER_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define LRESAMPLER_NEON
+#include <arm_neon.h>
+#endif
+
+//  Most frames a single process or convert step takes in
+const int   RESAMPLER_BLOCK_FRAMES  = 256;
+
+//  Phases tabled when the exact count would be larger
+const int   RESAMPLER_MAX_PHASES    = 256;
+
+//  Filter length against stop band rejection
+enum LResamplerQuality
+{
+	RESAMPLER_LOW       ,
+	RESAMPLER_MEDIUM    ,
+	RESAMPLER_HIGH
+};
+
+//  Sum of a[ i ] * b[ i ], count is a multiple of 4
+inline float resamplerDot( const float* a, const float* b, int count )
+{
+	#if defined(LRESAMPLER_SSE2)
+	__m128 sum = _mm_setzero_ps();
+	for ( int i = 0; i < count; i += 4 )
+	{
+		sum = _mm_add_ps( sum, _mm_mul_ps( _mm_loadu_ps( a + i ), _mm_loadu_ps( b + i ) ) );
+	}
+	sum = _mm_add_ps( sum, _mm_movehl_ps( sum, sum ) );
+	sum = _mm_add_ss( sum, _mm_shuffle_ps( sum, sum, 1 ) );
+	return _mm_cvtss_f32( sum );
+	#elif defined(LRESAMPLER_NEON)
+	float32x4_t sum = vdupq_n_f32( 0.0f );
+	for ( int i = 0; i < count; i += 4 )
+	{
+		sum = vmlaq_f32( sum, vld1q_f32( a + i ), vld1q_f32( b + i ) );
+	}
+	return vaddvq_f32( sum );
+	#else
+	float sum[ 4 ] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for ( int i = 0; i < count; i += 4 )
+	{
+		for ( int j = 0; j < 4; ++j )
+		{
+			sum[ j ] += a[ i + j ] * b[ i + j ];
+		}
+	}
+	return ( sum[ 0 ] + sum[ 2 ] ) + ( sum[ 1 ] + sum[ 3 ] );
+	#endif
+}
+
+//  Converts count samples of an SDL audio format to float
+inline void samplesToFloat( const void* in, SDL_AudioFormat format, int count, float* out )
+{
+	bool swap = ( SDL_AUDIO_ISBIGENDIAN( format ) != 0 ) != ( SDL_BYTEORDER == SDL_BIG_ENDIAN );
+
+	switch  ( SDL_AUDIO_BITSIZE( format ) | ( SDL_AUDIO_ISFLOAT( format ) ? 0x100 : 0 ) )
+	{
+		case    8:
+			if  ( SDL_AUDIO_ISSIGNED( format ) )
+			{
+				const Sint8* samples = (const Sint8*) in;
+				for ( int i = 0; i < count; ++i )
+				{
+					out[ i ] = samples[ i ] * ( 1.0f / 128 );
+				}
+			}
+			else
+			{
+				const Uint8* samples = (const Uint8*) in;
+				for ( int i = 0; i < count; ++i )
+				{
+					out[ i ] = ( samples[ i ] - 128 ) * ( 1.0f / 128 );
+				}
+			}
+			break;
+
+		case    16:
+		{
+			const Sint16* samples = (const Sint16*) in;
+			for ( int i = 0; i < count; ++i )
+			{
+				out[ i ] = ( swap ? (Sint16) SDL_Swap16( samples[ i ] ) : samples[ i ] ) * ( 1.0f / 32768 );
+			}
+			break;
+		}
+
+		case    32:
+		{
+			const Sint32* samples = (const Sint32*) in;
+			for ( int i = 0; i < count; ++i )
+			{
+				out[ i ] = ( swap ? (Sint32) SDL_Swap32( samples[ i ] ) : samples[ i ] ) * ( 1.0f / 2147483648.0f );
+			}
+			break;
+		}
+
+		case    0x100 | 32:
+			if  ( swap )
+			{
+				const float* samples = (const float*) in;
+				for ( int i = 0; i < count; ++i )
+				{
+					out[ i ] = SDL_SwapFloat( samples[ i ] );
+				}
+			}
+			else
+			{
+				memcpy( out, in, count * sizeof( float ) );
+			}
+			break;
+	}
+}
+
+//  Converts count float samples to an SDL audio format, clipping
+inline void floatToSamples( const float* in, SDL_AudioFormat format, int count, void* out )
+{
+	bool swap = ( SDL_AUDIO_ISBIGENDIAN( format ) != 0 ) != ( SDL_BYTEORDER == SDL_BIG_ENDIAN );
+
+	switch  ( SDL_AUDIO_BITSIZE( format ) | ( SDL_AUDIO_ISFLOAT( format ) ? 0x100 : 0 ) )
+	{
+		case    8:
+			if  ( SDL_AUDIO_ISSIGNED( format ) )
+			{
+				Sint8* samples = (Sint8*) out;
+				for ( int i = 0; i < count; ++i )
+				{
+					samples[ i ] = (Sint8)( SDL_clamp( in[ i ], -1.0f, 1.0f ) * 127 );
+				}
+			}
+			else
+			{
+				Uint8* samples = (Uint8*) out;
+				for ( int i = 0; i < count; ++i )
+				{
+					samples[ i ] = (Uint8)( SDL_clamp( in[ i ], -1.0f, 1.0f ) * 127 + 128 );
+				}
+			}
+			break;
+
+		case    16:
+		{
+			Sint16* samples = (Sint16*) out;
+			for ( int i = 0; i < count; ++i )
+			{
+				Sint16 sample = (Sint16)( SDL_clamp( in[ i ], -1.0f, 1.0f ) * 32767 );
+				samples[ i ] = swap ? (Sint16) SDL_Swap16( sample ) : sample;
+			}
+			break;
+		}
+
+		case    32:
+		{
+			Sint32* samples = (Sint32*) out;
+			for ( int i = 0; i < count; ++i )
+			{
+				Sint32 sample = (Sint32)( SDL_clamp( in[ i ], -1.0f, 1.0f ) * 2147483520.0f );
+				samples[ i ] = swap ? (Sint32) SDL_Swap32( sample ) : sample;
+			}
+			break;
+		}
+
+		case    0x100 | 32:
+			if  ( swap )
+			{
+				float* samples = (float*) out;
+				for ( int i = 0; i < count; ++i )
+				{
+					samples[ i ] = SDL_SwapFloat( in[ i ] );
+				}
+			}
+			else
+			{
+				memcpy( out, in, count * sizeof( float ) );
+			}
+			break;
+	}
+}
+
+//  Gets whether the conversions above handle a format
+inline bool isConvertibleFormat( SDL_AudioFormat format )
+{
+	int bits = SDL_AUDIO_BITSIZE( format );
+	if  ( SDL_AUDIO_ISFLOAT( format ) )
+	{
+		return bits == 32;
+	}
+
+	return bits == 8 || ( SDL_AUDIO_ISSIGNED( format ) && ( bits == 16 || bits == 32 ) );
+}
+
+//  Polyphase resampler for interleaved float
+class LResampler
+{
+	public:
+		//  Initializes an empty resampler
+		LResampler()
+		{
+			mChannels       = 0;
+			mTaps           = 0;
+			mUp             = 1;
+			mDown           = 1;
+			mPhaseCount     = 0;
+			mStride         = 0;
+			mBuffered       = 0;
+			mPosition       = 0;
+			mPhase          = 0;
+		}
+
+		//  Sets up conversion of channels from inRate to outRate
+		bool init( int inRate, int outRate, int channels, LResamplerQuality quality = RESAMPLER_MEDIUM )
+		{
+			if  ( inRate <= 0 || outRate <= 0 || channels <= 0 )
+			{
+				printf( "Unable to resample %d Hz to %d Hz!\n", inRate, outRate );
+				return false;
+			}
+
+			//  Output frame j falls on input frame j * M / L
+			int divisor = gcd( inRate, outRate );
+			mUp         = outRate / divisor;
+			mDown       = inRate / divisor;
+			mChannels   = channels;
+
+			//  Taps and rolloff per quality, as wide again when the cutoff drops
+			static const int    TAPS[]      = { 8, 16, 32 };
+			static const double ROLLOFF[]   = { 0.80, 0.90, 0.95 };
+			static const double BETA[]      = { 5.0, 7.0, 9.0 };
+			double  scale   = SDL_min( 1.0, (double) mUp / mDown );
+			mTaps           = ( (int) ceil( TAPS[ quality ] / scale ) + 3 ) / 4 * 4;
+
+			//  Table exact phases, or evenly spaced ones to blend between
+			mPhaseCount = mUp <= RESAMPLER_MAX_PHASES ? mUp : RESAMPLER_MAX_PHASES + 1;
+			mCoefficients.resize( mPhaseCount * mTaps );
+			double phases = mUp <= RESAMPLER_MAX_PHASES ? mUp : RESAMPLER_MAX_PHASES;
+			double cutoff = 0.5 * scale * ROLLOFF[ quality ];
+			for ( int phase = 0; phase < mPhaseCount; ++phase )
+			{
+				float*  row = &mCoefficients[ phase * mTaps ];
+				double  sum = 0.0;
+				for ( int tap = 0; tap < mTaps; ++tap )
+				{
+					//  Input frames from the output time
+					double t = tap - ( mTaps / 2 - 1 ) - phase / phases;
+					row[ tap ] = (float)( sinc( 2.0 * cutoff * t ) * kaiser( t / ( mTaps / 2 ), BETA[ quality ] ) );
+					sum += row[ tap ];
+				}
+
+				//  Unity gain at DC
+				for ( int tap = 0; tap < mTaps; ++tap )
+				{
+					row[ tap ] = (float)( row[ tap ] / sum );
+				}
+			}
+
+			//  History of every channel, room for taps and a block
+			mStride = mTaps + RESAMPLER_BLOCK_FRAMES;
+			mHistory.resize( mStride * mChannels );
+			mBlend.resize( mTaps );
+			reset();
+
+			return true;
+		}
+
+		//  Forgets the input so far
+		void reset()
+		{
+			//  Half a filter of silence lines the first output up with the first input
+			std::fill( mHistory.begin(), mHistory.end(), 0.0f );
+			mBuffered   = mTaps / 2 - 1;
+			mPosition   = 0;
+			mPhase      = 0;
+		}
+
+		//  Most output frames a process of frames can give
+		int getMaxOutput( int frames ) const
+		{
+			return (int)( ( (Sint64) frames * mUp + mDown - 1 ) / mDown ) + 1;
+		}
+
+		//  Frames of silence that push the last input through the filter
+		int getFlushFrames() const
+		{
+			return mUp == mDown ? 0 : mTaps / 2;
+		}
+
+		//  Resamples frames of input, at most RESAMPLER_BLOCK_FRAMES, into out,
+		//	which has room for getMaxOutput( frames ). Returns the frames written
+		int process( const float* in, int frames, float* out )
+		{
+			//  Same rate, nothing to filter
+			if  ( mUp == mDown )
+			{
+				memcpy( out, in, frames * mChannels * sizeof( float ) );
+				return frames;
+			}
+
+			//  Append the input, one row per channel
+			for ( int c = 0; c < mChannels; ++c )
+			{
+				float* row = &mHistory[ c * mStride + mBuffered ];
+				for ( int i = 0; i < frames; ++i )
+				{
+					row[ i ] = in[ i * mChannels + c ];
+				}
+			}
+			mBuffered += frames;
+
+			//  Every output whose taps have all arrived
+			int produced = 0;
+			while   ( mPosition + mTaps <= mBuffered )
+			{
+				const float* coefficients = getCoefficients();
+				for ( int c = 0; c < mChannels; ++c )
+				{
+					out[ produced * mChannels + c ] = resamplerDot( &mHistory[ c * mStride + mPosition ], coefficients, mTaps );
+				}
+				++produced;
+
+				mPhase      += mDown;
+				mPosition   += mPhase / mUp;
+				mPhase      %= mUp;
+			}
+
+			//  Keep what the next outputs still need at the front
+			if  ( mPosition >= mBuffered )
+			{
+				mPosition   -= mBuffered;
+				mBuffered   = 0;
+			}
+			else
+			{
+				for ( int c = 0; c < mChannels; ++c )
+				{
+					float* row = &mHistory[ c * mStride ];
+					memmove( row, row + mPosition, ( mBuffered - mPosition ) * sizeof( float ) );
+				}
+				mBuffered   -= mPosition;
+				mPosition   = 0;
+			}
+
+			return produced;
+		}
+
+	private:
+		//  Greatest common divisor
+		static int gcd( int a, int b )
+		{
+			while   ( b != 0 )
+			{
+				int r = a % b;
+				a = b;
+				b = r;
+			}
+
+			return a;
+		}
+
+		//  sin( pi x ) / ( pi x )
+		static double sinc( double x )
+		{
+			return fabs( x ) < 1e-9 ? 1.0 : sin( M_PI * x ) / ( M_PI * x );
+		}
+
+		//  Kaiser window from -1 to 1
+		static double kaiser( double x, double beta )
+		{
+			if  ( fabs( x ) > 1.0 )
+			{
+				return 0.0;
+			}
+
+			return besselI0( beta * sqrt( 1.0 - x * x ) ) / besselI0( beta );
+		}
+
+		//  Modified Bessel function of the first kind, order 0
+		static double besselI0( double x )
+		{
+			double sum = 1.0, term = 1.0;
+			for ( int k = 1; k < 32; ++k )
+			{
+				term *= ( x / ( 2 * k ) ) * ( x / ( 2 * k ) );
+				sum += term;
+			}
+
+			return sum;
+		}
+
+		//  Gets the filter for the current phase
+		const float* getCoefficients()
+		{
+			if  ( mUp <= RESAMPLER_MAX_PHASES )
+			{
+				return &mCoefficients[ mPhase * mTaps ];
+			}
+
+			//  Blend the tabled phases either side
+			Uint64  scaled      = (Uint64) mPhase * RESAMPLER_MAX_PHASES;
+			int     index       = (int)( scaled / mUp );
+			float   fraction    = (float)( scaled % mUp ) / mUp;
+			const float* a = &mCoefficients[ index * mTaps ];
+			const float* b = a + mTaps;
+			for ( int tap = 0; tap < mTaps; ++tap )
+			{
+				mBlend[ tap ] = a[ tap ] + ( b[ tap ] - a[ tap ] ) * fraction;
+			}
+
+			return mBlend.data();
+		}
+
+		//  Channels and filter length
+		int     mChannels;
+		int     mTaps;
+
+		//  Reduced output and input rates
+		int     mUp, mDown;
+
+		//  Filter per phase
+		std::vector<float>  mCoefficients;
+		int                 mPhaseCount;
+
+		//  Input history per channel, mStride apart, and frames in it
+		std::vector<float>  mHistory;
+		int                 mStride;
+		int                 mBuffered;
+
+		//  First tap of the next output and its phase out of mUp
+		int     mPosition;
+		int     mPhase;
+
+		//  Blended filter
+		std::vector<float>  mBlend;
+};
+
+//  Converts between SDL audio specs in blocks
+class LAudioConverter
+{
+	public:
+		//  Initializes an empty converter
+		LAudioConverter()
+		{
+			mInFormat       = 0;
+			mOutFormat      = 0;
+			mInChannels     = 0;
+			mOutChannels    = 0;
+			mChannels       = 0;
+			mInRate         = 0;
+			mOutRate        = 0;
+		}
+
+		//  Sets up conversion from the frequency, format and channels of from to those of to
+		bool init( const SDL_AudioSpec& from, const SDL_AudioSpec& to, LResamplerQuality quality = RESAMPLER_MEDIUM )
+		{
+			if  ( !isConvertibleFormat( from.format ) || !isConvertibleFormat( to.format ) )
+			{
+				printf( "Unable to convert audio format %04X to %04X!\n", from.format, to.format );
+				return false;
+			}
+
+			mInFormat       = from.format;
+			mOutFormat      = to.format;
+			mInChannels     = from.channels;
+			mOutChannels    = to.channels;
+			mInRate         = from.freq;
+			mOutRate        = to.freq;
+
+			//  Resample the fewer channels
+			mChannels = SDL_min( mInChannels, mOutChannels );
+			if  ( !mResampler.init( from.freq, to.freq, mChannels, quality ) )
+			{
+				return false;
+			}
+
+			//  Room for a block on each side
+			int outFrames = mResampler.getMaxOutput( RESAMPLER_BLOCK_FRAMES );
+			mInput.resize( RESAMPLER_BLOCK_FRAMES * mInChannels );
+			mMixed.resize( RESAMPLER_BLOCK_FRAMES * mChannels );
+			mOutput.resize( outFrames * mChannels );
+			mMapped.resize( outFrames * mOutChannels );
+
+			return true;
+		}
+
+		//  Forgets the input so far
+		void reset()
+		{
+			mResampler.reset();
+		}
+
+		//  Most output bytes flush can give
+		int getMaxFlushBytes() const
+		{
+			int frames  = mResampler.getFlushFrames();
+			int blocks  = ( frames + RESAMPLER_BLOCK_FRAMES - 1 ) / RESAMPLER_BLOCK_FRAMES;
+			return ( mResampler.getMaxOutput( frames ) + blocks ) * getOutFrameBytes();
+		}
+
+		//  Ends the input, writing the frames still inside the filter to out,
+		//	which has room for getMaxFlushBytes(). Returns the bytes written,
+		//	the next convert starts a new stream
+		int flush( void* out )
+		{
+			Uint8*  destination = (Uint8*) out;
+			int     frames      = mResampler.getFlushFrames();
+			int     written     = 0;
+
+			//  Silence in the resampled channels
+			std::fill( mMixed.begin(), mMixed.end(), 0.0f );
+
+			for ( int done = 0; done < frames; done += RESAMPLER_BLOCK_FRAMES )
+			{
+				int block = SDL_min( frames - done, RESAMPLER_BLOCK_FRAMES );
+
+				int produced = mResampler.process( mMixed.data(), block, mOutput.data() );
+				const float* result = mOutput.data();
+				if  ( mOutChannels > mChannels )
+				{
+					upmix( produced );
+					result = mMapped.data();
+				}
+				floatToSamples( result, mOutFormat, produced * mOutChannels, destination + written );
+				written += produced * getOutFrameBytes();
+			}
+
+			mResampler.reset();
+			return written;
+		}
+
+		//  Most output bytes converting inBytes can give
+		int getMaxOutputBytes( int inBytes ) const
+		{
+			//  Each block can round up once
+			int frames  = inBytes / getInFrameBytes();
+			int blocks  = ( frames + RESAMPLER_BLOCK_FRAMES - 1 ) / RESAMPLER_BLOCK_FRAMES;
+			return ( mResampler.getMaxOutput( frames ) + blocks ) * getOutFrameBytes();
+		}
+
+		//  Most input bytes, whole frames, whose output fits in outBytes
+		int getMaxInputBytes( int outBytes ) const
+		{
+			//  Start from the rate ratio and back off past the rounding
+			int frames = (int)( (Sint64)( outBytes / getOutFrameBytes() ) * mInRate / mOutRate );
+			while   ( frames > 0 && getMaxOutputBytes( frames * getInFrameBytes() ) > outBytes )
+			{
+				frames -= SDL_max( frames / 64, 1 );
+			}
+
+			return SDL_max( frames, 0 ) * getInFrameBytes();
+		}
+
+		//  Gets the bytes per input and output frame
+		int getInFrameBytes() const     { return mInChannels  * SDL_AUDIO_BITSIZE( mInFormat  ) / 8; }
+		int getOutFrameBytes() const    { return mOutChannels * SDL_AUDIO_BITSIZE( mOutFormat ) / 8; }
+
+		//  Converts whole frames of in into out, which has room for
+		//	getMaxOutputBytes( inBytes ). Returns the bytes written
+		int convert( const void* in, int inBytes, void* out )
+		{
+			const Uint8*    source      = (const Uint8*) in;
+			Uint8*          destination = (Uint8*) out;
+			int             frames      = inBytes / getInFrameBytes();
+			int             written     = 0;
+
+			for ( int done = 0; done < frames; done += RESAMPLER_BLOCK_FRAMES )
+			{
+				int block = SDL_min( frames - done, RESAMPLER_BLOCK_FRAMES );
+
+				//  To float, then down to the channels being resampled
+				samplesToFloat( source + done * getInFrameBytes(), mInFormat, block * mInChannels, mInput.data() );
+				const float* resampled = mInput.data();
+				if  ( mInChannels > mChannels )
+				{
+					downmix( block );
+					resampled = mMixed.data();
+				}
+
+				//  Resample, then up to the output channels and format
+				int produced = mResampler.process( resampled, block, mOutput.data() );
+				const float* result = mOutput.data();
+				if  ( mOutChannels > mChannels )
+				{
+					upmix( produced );
+					result = mMapped.data();
+				}
+				floatToSamples( result, mOutFormat, produced * mOutChannels, destination + written );
+				written += produced * getOutFrameBytes();
+			}
+
+			return written;
+		}
+
+	private:
+		//  Input channels to the resampled ones, mono gets the average
+		void downmix( int frames )
+		{
+			const float*    in  = mInput.data();
+			float*          out = mMixed.data();
+			if  ( mChannels == 1 )
+			{
+				float scale = 1.0f / mInChannels;
+				for ( int i = 0; i < frames; ++i )
+				{
+					float sum = 0.0f;
+					for ( int c = 0; c < mInChannels; ++c )
+					{
+						sum += in[ i * mInChannels + c ];
+					}
+					out[ i ] = sum * scale;
+				}
+				return;
+			}
+
+			//  Otherwise the extra channels go
+			for ( int i = 0; i < frames; ++i )
+			{
+				memcpy( out + i * mChannels, in + i * mInChannels, mChannels * sizeof( float ) );
+			}
+		}
+
+		//  Resampled channels to the output ones, mono goes to all of them
+		void upmix( int frames )
+		{
+			const float*    in  = mOutput.data();
+			float*          out = mMapped.data();
+			for ( int i = 0; i < frames; ++i )
+			{
+				for ( int c = 0; c < mOutChannels; ++c )
+				{
+					out[ i * mOutChannels + c ] =
+                        mChannels == 1 ? in[ i ] : c < mChannels ? in[ i * mChannels + c ] : 0.0f;
+				}
+			}
+		}
+
+		//  Formats and channels either side and in between
+		SDL_AudioFormat mInFormat, mOutFormat;
+		int             mInChannels, mOutChannels;
+		int             mChannels;
+		int             mInRate, mOutRate;
+
+		//  The resampler and a block at each step
+		LResampler          mResampler;
+		std::vector<float>  mInput;
+		std::vector<float>  mMixed;
+		std::vector<float>  mOutput;
+		std::vector<float>  mMapped;
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*  Lock free single producer, single consumer byte ring, shared by the
+    audio lessons.
+
+    One thread writes and one thread reads, typically an audio callback
+    and the main loop. Each side owns one index and only reads the other,
+    so neither ever waits: a full ring writes less and an empty ring reads
+    less, and both return how much they moved. The capacity is a power of
+    two so the free running indices wrap with a mask.                   */
+
+#ifndef LRINGBUFFER_H
+#define LRINGBUFFER_H
+
+//  Using SDL, atomics, standard IO and strings
+#include <SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+
+//  Byte ring between one writer and one reader
+class LRingBuffer
+{
+	public:
+		//  Initializes an empty ring
+		LRingBuffer()
+		{
+			mData           = NULL;
+			mCapacity       = 0;
+			mHead           = 0;
+			mTail           = 0;
+			mCachedTail     = 0;
+			mCachedHead     = 0;
+		}
+
+		//  Frees the ring
+		~LRingBuffer()
+		{
+			free();
+		}
+
+		//  Allocates at least size bytes, rounded up to a power of two
+		bool allocate( Uint32 size )
+		{
+			free();
+
+			Uint32 capacity = 1;
+			while   ( capacity < size && capacity < 0x80000000 )
+			{
+				capacity <<= 1;
+			}
+
+			mData = new( std::nothrow ) Uint8[ capacity ];
+			if  ( mData == NULL )
+			{
+				printf( "Unable to allocate %u byte ring buffer!\n", capacity );
+				return false;
+			}
+			mCapacity = capacity;
+			reset();
+
+			return true;
+		}
+
+		//  Frees the bytes
+		void free()
+		{
+			delete[] mData;
+			mData       = NULL;
+			mCapacity   = 0;
+			reset();
+		}
+
+		//  Empties the ring, only while neither side is running
+		void reset()
+		{
+			mHead.store( 0, std::memory_order_relaxed );
+			mTail.store( 0, std::memory_order_relaxed );
+			mCachedTail = 0;
+			mCachedHead = 0;
+		}
+
+		//  Writer side: copies in up to bytes, returns how many fit
+		Uint32 write( const void* data, Uint32 bytes )
+		{
+			Uint32 head = mHead.load( std::memory_order_relaxed );
+
+			//  Only look at the reader's index when the cached one says full
+			if  ( mCapacity - ( head - mCachedTail ) < bytes )
+			{
+				mCachedTail = mTail.load( std::memory_order_acquire );
+			}
+			bytes = SDL_min( bytes, mCapacity - ( head - mCachedTail ) );
+			if  ( bytes == 0 )
+			{
+				return 0;
+			}
+
+			//  Copy in up to two pieces around the end
+			Uint32 start    = head & ( mCapacity - 1 );
+			Uint32 first    = SDL_min( bytes, mCapacity - start );
+			memcpy( mData + start, data, first );
+			memcpy( mData, (const Uint8*) data + first, bytes - first );
+
+			//  Publish the bytes to the reader
+			mHead.store( head + bytes, std::memory_order_release );
+
+			return bytes;
+		}
+
+		//  Reader side: copies out up to bytes, returns how many there were
+		Uint32 read( void* data, Uint32 bytes )
+		{
+			Uint32 tail = mTail.load( std::memory_order_relaxed );
+
+			//  Only look at the writer's index when the cached one says empty
+			if  ( mCachedHead - tail < bytes )
+			{
+				mCachedHead = mHead.load( std::memory_order_acquire );
+			}
+			bytes = SDL_min( bytes, mCachedHead - tail );
+			if  ( bytes == 0 )
+			{
+				return 0;
+			}
+
+			//  Copy out up to two pieces around the end
+			Uint32 start    = tail & ( mCapacity - 1 );
+			Uint32 first    = SDL_min( bytes, mCapacity - start );
+			memcpy( data, mData + start, first );
+			memcpy( (Uint8*) data + first, mData, bytes - first );
+
+			//  Hand the space back to the writer
+			mTail.store( tail + bytes, std::memory_order_release );
+
+			return bytes;
+		}
+
+		//  Gets the bytes waiting to be read, exact on the reader side
+		Uint32 getReadable() const
+		{
+			return mHead.load( std::memory_order_acquire ) - mTail.load( std::memory_order_acquire );
+		}
+
+		//  Gets the free bytes, exact on the writer side
+		Uint32 getWritable() const
+		{
+			return mCapacity - getReadable();
+		}
+
+		//  Gets the size
+		Uint32 getCapacity() const
+		{
+			return mCapacity;
+		}
+
+	private:
+		//  The bytes
+		Uint8*  mData;
+		Uint32  mCapacity;
+
+		//  Writer's index and its copy of the reader's, on their own cache line
+		alignas( 64 ) std::atomic<Uint32>   mHead;
+		Uint32                              mCachedTail;
+
+		//  Reader's index and its copy of the writer's
+		alignas( 64 ) std::atomic<Uint32>   mTail;
+		Uint32                              mCachedHead;
+};
+
+#endif
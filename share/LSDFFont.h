@@ -0,0 +1,566 @@
+/*  Signed distance field fonts, shared by the true type font lessons.
+
+    A font is opened once, at a base point size, and each glyph is turned
+    into a distance field with the linear time Euclidean distance transform
+    of Felzenszwalb and Huttenlocher. The fields are packed into one single
+    channel atlas, 512 pixels wide or as wide as the widest padded glyph.
+    The font stays open only to look up the kerning of each pair the
+    first time it is drawn or measured.
+
+    The SDL renderer has no shaders to threshold the field while drawing,
+    so the atlas is resampled on the CPU into an anti-aliased coverage
+    texture. Sizes are rounded up to one of SDF_SIZE_STEPS steps per
+    octave, and the coverage texture for that step is drawn slightly
+    shrunk with linear filtering. At most SDF_MAX_SIZE_TEXTURES steps are
+    kept, the least recently drawn one goes first, so animated scaling
+    can't grow memory past that many scaled atlases. The glyph layout is
+    the same at every size, only scaled, so strings are drawn with one
+    SDL_RenderGeometry call from whichever texture matches.             */
+
+#ifndef LSDFFONT_H
+#define LSDFFONT_H
+
+//  Using SDL, SDL_ttf, standard IO, math, strings, vectors, algorithms and maps
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <stdio.h>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+//  Using the shared UTF-8 decoder and quad indices
+#include "LUTF8.h"
+#include "LQuadIndices.h"
+
+//  Coverage texture sizes per doubling of the point size
+const int SDF_SIZE_STEPS        = 8;
+
+//  Coverage textures kept at once
+const int SDF_MAX_SIZE_TEXTURES = 4;
+
+//  Distance field font usable at any size
+class LSDFFont
+{
+	public:
+		//  Initializes variables
+		LSDFFont()
+		{
+			mRenderer   = NULL;
+			mFont       = NULL;
+			mFieldWidth = 0;
+			mFieldHeight= 0;
+			mBaseSize   = 0;
+			mLineHeight = 0;
+			mSpread     = 0;
+			mLastUse    = 0;
+		}
+
+		//  Deallocates memory
+		~LSDFFont()
+		{
+			free();
+		}
+
+		//  Opens the font at the base size and builds the distance fields
+		//	of the characters, printable Latin-1 if none are given. Sizes
+		//	down to about the base size over the spread stay anti-aliased
+		bool build( SDL_Renderer* renderer, std::string path, int baseSize = 48, int spread = 4, std::string characters = "" )
+		{
+			//  Get rid of preexisting font
+			free();
+
+			TTF_Font* font = TTF_OpenFont( path.c_str(), baseSize );
+			if  ( font == NULL )
+			{
+				printf( "Unable to open font %s! SDL_ttf Error: %s\n", path.c_str(), TTF_GetError() );
+				return false;
+			}
+
+			//  Printable Latin-1
+			std::vector<Uint16> set;
+			for ( int i = 0; i < (int) characters.length(); )
+			{
+				set.push_back( nextCharacter( characters, i ) );
+			}
+			bool latin1 = set.empty();
+			for ( int ch = 32; latin1 && ch < 256; ++ch )
+			{
+				if  ( ch < 127 || ch >= 160 )
+				{
+					set.push_back( (Uint16) ch );
+				}
+			}
+
+			//  Each character once, so each field is packed once
+			std::sort( set.begin(), set.end() );
+			set.erase( std::unique( set.begin(), set.end() ), set.end() );
+
+			mRenderer   = renderer;
+			mBaseSize   = baseSize;
+			mSpread     = spread;
+			mLineHeight = TTF_FontHeight( font );
+			mFieldWidth = 512;
+
+			//  Fields of the glyphs with ink, in set order
+			std::vector< std::vector<Uint8> > fields;
+
+			for ( Uint16 ch : set )
+			{
+				int minX = 0, advance = 0;
+				if  ( !TTF_GlyphIsProvided( font, ch ) || TTF_GlyphMetrics( font, ch, &minX, NULL, NULL, NULL, &advance ) != 0 )
+				{
+					continue;
+				}
+
+				Glyph glyph;
+				glyph.clip      = { 0, 0, 0, 0 };
+				glyph.xOffset   = SDL_min( minX, 0 ) - spread;
+				glyph.advance   = advance;
+
+				//  Rasterize and take the field around the outline
+				SDL_Color       white   = { 0xFF, 0xFF, 0xFF, 0xFF };
+				SDL_Surface*    raster  = TTF_RenderGlyph_Blended( font, ch, white );
+				SDL_Surface*    surface = raster == NULL ? NULL : SDL_ConvertSurfaceFormat( raster, SDL_PIXELFORMAT_ARGB8888, 0 );
+				SDL_FreeSurface( raster );
+				if  ( surface != NULL && ch != ' ' )
+				{
+					std::vector<Uint8> field;
+					glyph.clip.w = surface->w + spread * 2;
+					glyph.clip.h = surface->h + spread * 2;
+					buildField( surface, spread, field );
+					fields.push_back( field );
+
+					//  At large base sizes a padded glyph can be wider than the atlas
+					mFieldWidth = SDL_max( mFieldWidth, glyph.clip.w );
+				}
+				SDL_FreeSurface( surface );
+
+				mGlyphs[ ch ] = glyph;
+			}
+
+			//  Kept for kerning, looked up per pair as text uses it
+			mFont = font;
+
+			//  Shelf pack the fields now that the atlas is wide enough for all of them
+			int shelfX = 0, shelfY = 0, shelfHeight = 0;
+			for ( Uint16 ch : set )
+			{
+				std::unordered_map<Uint16, Glyph>::iterator glyph = mGlyphs.find( ch );
+				if  ( glyph == mGlyphs.end() || glyph->second.clip.w == 0 )
+				{
+					continue;
+				}
+
+				//  Next shelf if this one is full
+				SDL_Rect& clip = glyph->second.clip;
+				if  ( shelfX + clip.w > mFieldWidth )
+				{
+					shelfX      = 0;
+					shelfY     += shelfHeight;
+					shelfHeight = 0;
+				}
+				clip.x      = shelfX;
+				clip.y      = shelfY;
+				shelfX     += clip.w;
+				shelfHeight = SDL_max( shelfHeight, clip.h );
+			}
+
+			//  Copy the fields into the atlas
+			mFieldHeight = SDL_max( shelfY + shelfHeight, 1 );
+			mField.assign( mFieldWidth * mFieldHeight, 0 );
+
+			int next = 0;
+			for ( Uint16 ch : set )
+			{
+				std::unordered_map<Uint16, Glyph>::iterator glyph = mGlyphs.find( ch );
+				if  ( glyph == mGlyphs.end() || glyph->second.clip.w == 0 )
+				{
+					continue;
+				}
+
+				const SDL_Rect& clip = glyph->second.clip;
+				for ( int y = 0; y < clip.h; ++y )
+				{
+					std::copy(
+                        fields[ next ].begin() + y * clip.w         ,
+                        fields[ next ].begin() + ( y + 1 ) * clip.w ,
+                        mField.begin() + ( clip.y + y ) * mFieldWidth + clip.x
+                    );
+				}
+				++next;
+			}
+
+			return true;
+		}
+
+		//  Deallocates the atlas and every size
+		void free()
+		{
+			for ( const SizeTexture& size : mSizes )
+			{
+				SDL_DestroyTexture( size.texture );
+			}
+			mSizes.clear();
+			if  ( mFont != NULL )
+			{
+				TTF_CloseFont( mFont );
+				mFont = NULL;
+			}
+			mGlyphs.clear();
+			mKerning.clear();
+			mField.clear();
+			mFieldWidth = 0;
+			mFieldHeight= 0;
+		}
+
+		//  Shows the UTF-8 text at a point size, top left corner at x, y
+		void renderText( int x, int y, std::string text, int size, SDL_Color color )
+		{
+			int             textureSize;
+			SDL_Texture*    texture = getSizeTexture( size, &textureSize );
+			if  ( texture == NULL )
+			{
+				return;
+			}
+
+			//  Texture coordinates of the atlas scaled to the size step
+			float   scale   = (float) size / mBaseSize;
+			float   step    = (float) textureSize / mBaseSize;
+			float   scaleU  = step / SDL_max( (int) ceilf( mFieldWidth  * step ), 1 );
+			float   scaleV  = step / SDL_max( (int) ceilf( mFieldHeight * step ), 1 );
+			float   penX    = (float) x, penY = (float) y;
+			Uint16  previous= 0;
+			mVertices.clear();
+
+			for ( int i = 0; i < (int) text.length(); )
+			{
+				Uint16 ch = nextCharacter( text, i );
+
+				//  Move down and back on newlines
+				if  ( ch == '\n' )
+				{
+					penX = (float) x;
+					penY += mLineHeight * scale;
+					previous = 0;
+					continue;
+				}
+
+				std::unordered_map<Uint16, Glyph>::iterator found = mGlyphs.find( ch );
+				if  ( found == mGlyphs.end() )
+				{
+					continue;
+				}
+				const Glyph& glyph = found->second;
+
+				//  Pull the pair together or apart
+				penX += getKerning( previous, ch ) * scale;
+				previous = ch;
+
+				//  Add the glyph quad, the padding around the field included
+				if  ( glyph.clip.w > 0 )
+				{
+					const SDL_Rect& clip = glyph.clip;
+					float   x0 = penX + glyph.xOffset * scale, x1 = x0 + clip.w * scale;
+					float   y0 = penY - mSpread * scale, y1 = y0 + clip.h * scale;
+					float   u0 = clip.x * scaleU, u1 = ( clip.x + clip.w ) * scaleU;
+					float   v0 = clip.y * scaleV, v1 = ( clip.y + clip.h ) * scaleV;
+
+					SDL_Vertex  quad[ 4 ] = {
+                        { { x0, y0 }, color, { u0, v0 } },
+                        { { x1, y0 }, color, { u1, v0 } },
+                        { { x1, y1 }, color, { u1, v1 } },
+                        { { x0, y1 }, color, { u0, v1 } }
+                    };
+					mVertices.insert( mVertices.end(), quad, quad + 4 );
+				}
+
+				penX += glyph.advance * scale;
+			}
+
+			int glyphs = (int) mVertices.size() / 4;
+			if  ( glyphs == 0 )
+			{
+				return;
+			}
+
+			//  Two triangles per quad
+			growQuadIndices( mIndices, glyphs );
+
+			SDL_RenderGeometry( mRenderer, texture, &mVertices[ 0 ], glyphs * 4, &mIndices[ 0 ], glyphs * 6 );
+		}
+
+		//  Gets the size the text takes at a point size
+		void getTextSize( std::string text, int size, int* w, int* h )
+		{
+			float   scale   = mBaseSize == 0 ? 0.f : (float) size / mBaseSize;
+			int     width   = 0, lineWidth = 0, lines = 1;
+			Uint16  previous= 0;
+
+			for ( int i = 0; i < (int) text.length(); )
+			{
+				Uint16 ch = nextCharacter( text, i );
+				std::unordered_map<Uint16, Glyph>::iterator found = mGlyphs.find( ch );
+				if  ( ch == '\n' )
+				{
+					lineWidth = 0;
+					previous = 0;
+					++lines;
+				}
+				else if ( found != mGlyphs.end() )
+				{
+					lineWidth += getKerning( previous, ch ) + found->second.advance;
+					previous = ch;
+					width = SDL_max( width, lineWidth );
+				}
+			}
+
+			if  ( w != NULL ) *w = (int) ceilf( width * scale );
+			if  ( h != NULL ) *h = (int) ceilf( lines * mLineHeight * scale );
+		}
+
+		//  Gets the bytes of the distance field atlas
+		int getFieldBytes() const { return (int) mField.size(); }
+
+	private:
+		//  A glyph, in base size pixels, the clip covers the padded field
+		struct Glyph
+		{
+			SDL_Rect    clip;
+			int         xOffset;
+			int         advance;
+		};
+
+		//  The atlas resampled for a size step and when it was last drawn
+		struct SizeTexture
+		{
+			int             size;
+			SDL_Texture*    texture;
+			Uint32          lastUse;
+		};
+
+		//  Rounds a point size up to its step, so nearby sizes share a texture
+		static int getSizeStep( int size )
+		{
+			float step = ceilf( log2f( (float) size ) * SDF_SIZE_STEPS - 0.001f );
+			return SDL_max( (int) ceilf( exp2f( step / SDF_SIZE_STEPS ) - 0.001f ), size );
+		}
+
+		//  Squared distance from every sample to the nearest zero of f,
+		//	the lower envelope of parabolas rooted at each sample
+		static void transform( const float* f, float* d, int* v, float* z, int n )
+		{
+			int k = 0;
+			v[ 0 ] = 0;
+			z[ 0 ] = -INFINITY;
+			z[ 1 ] = INFINITY;
+
+			for ( int q = 1; q < n; ++q )
+			{
+				//  Drop parabolas the new one hides
+				float s = ( ( f[ q ] + q * q ) - ( f[ v[ k ] ] + v[ k ] * v[ k ] ) ) / ( 2 * q - 2 * v[ k ] );
+				while   ( s <= z[ k ] )
+				{
+					--k;
+					s = ( ( f[ q ] + q * q ) - ( f[ v[ k ] ] + v[ k ] * v[ k ] ) ) / ( 2 * q - 2 * v[ k ] );
+				}
+
+				++k;
+				v[ k ]      = q;
+				z[ k ]      = s;
+				z[ k + 1 ]  = INFINITY;
+			}
+
+			k = 0;
+			for ( int q = 0; q < n; ++q )
+			{
+				while   ( z[ k + 1 ] < q )
+				{
+					++k;
+				}
+				d[ q ] = ( q - v[ k ] ) * ( q - v[ k ] ) + f[ v[ k ] ];
+			}
+		}
+
+		//  Squared distance to the nearest zero, columns then rows
+		static void transform( std::vector<float>& grid, int width, int height )
+		{
+			int                 length = SDL_max( width, height );
+			std::vector<float>  f( length ), d( length ), z( length + 1 );
+			std::vector<int>    v( length );
+
+			for ( int x = 0; x < width; ++x )
+			{
+				for ( int y = 0; y < height; ++y ) f[ y ] = grid[ y * width + x ];
+				transform( &f[ 0 ], &d[ 0 ], &v[ 0 ], &z[ 0 ], height );
+				for ( int y = 0; y < height; ++y ) grid[ y * width + x ] = d[ y ];
+			}
+
+			for ( int y = 0; y < height; ++y )
+			{
+				transform( &grid[ y * width ], &d[ 0 ], &v[ 0 ], &z[ 0 ], width );
+				std::copy( d.begin(), d.begin() + width, grid.begin() + y * width );
+			}
+		}
+
+		//  Turns the coverage of a glyph into a padded distance field,
+		//	128 on the outline, rising inside, falling outside
+		static void buildField( SDL_Surface* surface, int spread, std::vector<Uint8>& field )
+		{
+			int     width   = surface->w + spread * 2;
+			int     height  = surface->h + spread * 2;
+			float   far     = (float)( width * width + height * height );
+
+			//  Distances to the nearest inside and outside pixel
+			std::vector<float> toInside( width * height, far ), toOutside( width * height, 0.f );
+			for ( int y = 0; y < surface->h; ++y )
+			{
+				Uint32* row = (Uint32*)( (Uint8*) surface->pixels + y * surface->pitch );
+				for ( int x = 0; x < surface->w; ++x )
+				{
+					if  ( ( row[ x ] >> 24 ) >= 0x80 )
+					{
+						int i = ( y + spread ) * width + x + spread;
+						toInside[ i ]   = 0.f;
+						toOutside[ i ]  = far;
+					}
+				}
+			}
+			transform( toInside , width, height );
+			transform( toOutside, width, height );
+
+			//  The outline lies half a pixel from the pixel centers
+			field.resize( width * height );
+			for ( int i = 0; i < width * height; ++i )
+			{
+				float distance =
+                    toInside[ i ] > 0.f ?
+                        sqrtf( toInside[ i ]  ) - 0.5f :
+                        0.5f - sqrtf( toOutside[ i ] );
+				field[ i ] = (Uint8) SDL_clamp( 128.f - distance * 127.f / spread, 0.f, 255.f );
+			}
+		}
+
+		//  Gets the kerning between two characters at the base size,
+		//	asking the font the first time the pair comes up
+		int getKerning( Uint16 previous, Uint16 ch )
+		{
+			if  ( previous == 0 || mFont == NULL )
+			{
+				return 0;
+			}
+
+			Uint32 pair = ( (Uint32) previous << 16 ) | ch;
+			std::unordered_map<Uint32, int>::iterator kerning = mKerning.find( pair );
+			if  ( kerning != mKerning.end() )
+			{
+				return kerning->second;
+			}
+
+			return mKerning[ pair ] = TTF_GetFontKerningSizeGlyphs( mFont, previous, ch );
+		}
+
+		//  Gets the coverage texture for a point size and the size it was
+		//	made for, resampling the distance field when that step isn't kept
+		SDL_Texture* getSizeTexture( int drawSize, int* textureSize )
+		{
+			if  ( mField.empty() || drawSize <= 0 )
+			{
+				return NULL;
+			}
+
+			int size = getSizeStep( drawSize );
+			*textureSize = size;
+			for ( SizeTexture& cached : mSizes )
+			{
+				if  ( cached.size == size )
+				{
+					cached.lastUse = ++mLastUse;
+					return cached.texture;
+				}
+			}
+
+			//  Make room by dropping the least recently drawn step
+			if  ( (int) mSizes.size() >= SDF_MAX_SIZE_TEXTURES )
+			{
+				std::vector<SizeTexture>::iterator oldest =
+                    std::min_element(
+                        mSizes.begin()  ,
+                        mSizes.end()    ,
+                        []( const SizeTexture& a, const SizeTexture& b ) { return a.lastUse < b.lastUse; }
+                    );
+				SDL_DestroyTexture( oldest->texture );
+				mSizes.erase( oldest );
+			}
+
+			//  The whole atlas scaled, so the layout stays the same
+			float   scale   = (float) size / mBaseSize;
+			int     width   = SDL_max( (int) ceilf( mFieldWidth  * scale ), 1 );
+			int     height  = SDL_max( (int) ceilf( mFieldHeight * scale ), 1 );
+
+			//  One output pixel of anti-aliasing, in field units
+			float   ramp    = 127.f / ( mSpread * scale );
+
+			std::vector<Uint32> pixels( width * height );
+			for ( int y = 0; y < height; ++y )
+			{
+				float   fy  = SDL_clamp( ( y + 0.5f ) / scale - 0.5f, 0.f, mFieldHeight - 1.f );
+				int     y0  = (int) fy, y1 = SDL_min( y0 + 1, mFieldHeight - 1 );
+				float   ty  = fy - y0;
+
+				for ( int x = 0; x < width; ++x )
+				{
+					float   fx  = SDL_clamp( ( x + 0.5f ) / scale - 0.5f, 0.f, mFieldWidth - 1.f );
+					int     x0  = (int) fx, x1 = SDL_min( x0 + 1, mFieldWidth - 1 );
+					float   tx  = fx - x0;
+
+					//  Bilinear distance, then coverage across the outline
+					float top       = mField[ y0 * mFieldWidth + x0 ] * ( 1 - tx ) + mField[ y0 * mFieldWidth + x1 ] * tx;
+					float bottom    = mField[ y1 * mFieldWidth + x0 ] * ( 1 - tx ) + mField[ y1 * mFieldWidth + x1 ] * tx;
+					float value     = top * ( 1 - ty ) + bottom * ty;
+					float alpha     = SDL_clamp( ( value - 128.f ) / ramp + 0.5f, 0.f, 1.f );
+
+					pixels[ y * width + x ] = ( (Uint32)( alpha * 255.f + 0.5f ) << 24 ) | 0xFFFFFF;
+				}
+			}
+
+			SDL_Texture* texture = SDL_CreateTexture( mRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, width, height );
+			if  ( texture == NULL )
+			{
+				printf( "Unable to create font texture! SDL Error: %s\n", SDL_GetError() );
+				return NULL;
+			}
+			SDL_UpdateTexture( texture, NULL, &pixels[ 0 ], width * 4 );
+			SDL_SetTextureBlendMode( texture, SDL_BLENDMODE_BLEND );
+			SDL_SetTextureScaleMode( texture, SDL_ScaleModeLinear );
+
+			mSizes.push_back( { size, texture, ++mLastUse } );
+			return texture;
+		}
+
+		//  Where glyphs are drawn and the font at the base size
+		SDL_Renderer*   mRenderer;
+		TTF_Font*       mFont;
+
+		//  Distance field atlas, one byte per pixel
+		std::vector<Uint8>  mField;
+		int             mFieldWidth, mFieldHeight;
+
+		//  Glyphs and the kerning of pairs used so far, at the base size
+		std::unordered_map<Uint16, Glyph>   mGlyphs;
+		std::unordered_map<Uint32, int>     mKerning;
+		int             mBaseSize;
+		int             mLineHeight;
+		int             mSpread;
+
+		//  Coverage textures by size step and the last use stamp handed out
+		std::vector<SizeTexture>    mSizes;
+		Uint32                      mLastUse;
+
+		//  Quads of the last string and the shared index pattern
+		std::vector<SDL_Vertex>     mVertices;
+		std::vector<int>            mIndices;
+};
+
+#endif
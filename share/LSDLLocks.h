@@ -0,0 +1,49 @@
+/*  SDL's synchronization primitives behind one lock and unlock interface,
+    so benchmarks can swap them with the shared locks in LSpinLock.h.  */
+
+#ifndef LSDLLOCKS_H
+#define LSDLLOCKS_H
+
+//  Using SDL and SDL threads
+#include <SDL.h>
+#include <SDL_thread.h>
+
+//  SDL_AtomicLock, a bare spin
+class LSDLSpinLock
+{
+	public:
+		LSDLSpinLock    ()  { mLock = 0; }
+		void lock       ()  { SDL_AtomicLock( &mLock ); }
+		void unlock     ()  { SDL_AtomicUnlock( &mLock ); }
+
+	private:
+		SDL_SpinLock mLock;
+};
+
+//  SDL_mutex, as in lesson 49
+class LSDLMutex
+{
+	public:
+		LSDLMutex       ()  { mLock = SDL_CreateMutex(); }
+		~LSDLMutex      ()  { SDL_DestroyMutex( mLock ); }
+		void lock       ()  { SDL_LockMutex( mLock ); }
+		void unlock     ()  { SDL_UnlockMutex( mLock ); }
+
+	private:
+		SDL_mutex* mLock;
+};
+
+//  SDL_sem with one slot, as in lesson 47
+class LSDLSemaphore
+{
+	public:
+		LSDLSemaphore   ()  { mLock = SDL_CreateSemaphore( 1 ); }
+		~LSDLSemaphore  ()  { SDL_DestroySemaphore( mLock ); }
+		void lock       ()  { SDL_SemWait( mLock ); }
+		void unlock     ()  { SDL_SemPost( mLock ); }
+
+	private:
+		SDL_sem* mLock;
+};
+
+#endif
@@ -0,0 +1,583 @@
+/*  Spectrum and level analysis of captured audio, shared by the audio
+    lessons.
+
+    LFFT is a real FFT. The N real samples are packed as N / 2 complex ones
+    and transformed in place: one radix-4 pass does the first two stages,
+    where the twiddles are only 1 and -i, then radix-2 stages run 4
+    butterflies at a time with SSE2 or NEON on separate real and imaginary
+    arrays. A last pass splits the result into the N / 2 + 1 real bins.
+    Twiddles and the bit reversal are tabled by init.
+
+    LSpectrumAnalyzer runs on its own thread. It empties a ring the
+    recording callback also writes to, and every half window it works out
+    the peak and RMS level of each channel and a Hann windowed spectrum in
+    log spaced bands. The main thread copies out the latest results. */
+
+#ifndef LSPECTRUM_H
+#define LSPECTRUM_H
+
+//  Using SDL, atomics, math, standard IO, strings, vectors, ring buffers and sample conversion
+#include <SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+#include "LRingBuffer.h"
+#include "LResampler.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define LSPECTRUM_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define LSPECTRUM_NEON
+#include <arm_neon.h>
+#endif
+
+//  Samples per transform, results come every half of it
+const int   SPECTRUM_FFT_SIZE       = 2048;
+
+//  Bands shown, from the lowest to the highest frequency
+const int   SPECTRUM_BANDS          = 32;
+const float SPECTRUM_LOW_FREQUENCY  = 30.0f;
+const float SPECTRUM_HIGH_FREQUENCY = 20000.0f;
+
+//  Floor of every level and how fast bands fall back to it
+const float SPECTRUM_MIN_DB         = -90.0f;
+const float SPECTRUM_FALLOFF_DB     = 3.0f;
+
+//  Channels analyzed, any more are left out
+const int   SPECTRUM_MAX_CHANNELS   = 2;
+
+//  A sample at or over this is counted as clipped
+const float SPECTRUM_CLIP_LEVEL     = 0.999f;
+
+//  Real FFT
+class LFFT
+{
+	public:
+		//  Initializes an empty transform
+		LFFT()
+		{
+			mSize   = 0;
+			mHalf   = 0;
+		}
+
+		//  Sets up transforms of size real samples, a power of two from 8
+		bool init( int size )
+		{
+			if  ( size < 8 || ( size & ( size - 1 ) ) != 0 )
+			{
+				printf( "Unable to set up a %d point FFT!\n", size );
+				return false;
+			}
+			mSize = size;
+			mHalf = size / 2;
+
+			//  Bit reversed order of the complex input
+			int bits = 0;
+			while   ( ( 1 << bits ) < mHalf )
+			{
+				++bits;
+			}
+			mReverse.resize( mHalf );
+			for ( int i = 0; i < mHalf; ++i )
+			{
+				int reversed = 0;
+				for ( int b = 0; b < bits; ++b )
+				{
+					reversed |= ( ( i >> b ) & 1 ) << ( bits - 1 - b );
+				}
+				mReverse[ i ] = reversed;
+			}
+
+			//  Twiddles of the radix-2 stages, one run per stage
+			mTwiddleRe.clear();
+			mTwiddleIm.clear();
+			for ( int span = 4; span < mHalf; span *= 2 )
+			{
+				for ( int j = 0; j < span; ++j )
+				{
+					mTwiddleRe.push_back( (float) cos( -M_PI * j / span ) );
+					mTwiddleIm.push_back( (float) sin( -M_PI * j / span ) );
+				}
+			}
+
+			//  Twiddles of the real split
+			mSplitRe.resize( mHalf );
+			mSplitIm.resize( mHalf );
+			for ( int k = 0; k < mHalf; ++k )
+			{
+				mSplitRe[ k ] = (float) cos( -2.0 * M_PI * k / mSize );
+				mSplitIm[ k ] = (float) sin( -2.0 * M_PI * k / mSize );
+			}
+
+			mRe.resize( mHalf );
+			mIm.resize( mHalf );
+
+			return true;
+		}
+
+		//  Gets the real samples per transform
+		int getSize() const
+		{
+			return mSize;
+		}
+
+		//  Transforms getSize() samples into getSize() / 2 + 1 bins
+		void transform( const float* in, float* re, float* im )
+		{
+			//  Pack pairs of samples as complex ones, bit reversed
+			for ( int i = 0; i < mHalf; ++i )
+			{
+				mRe[ mReverse[ i ] ] = in[ 2 * i ];
+				mIm[ mReverse[ i ] ] = in[ 2 * i + 1 ];
+			}
+
+			//  First two stages as one radix-4 pass, the twiddles are 1 and -i
+			for ( int g = 0; g < mHalf; g += 4 )
+			{
+				float* xr = &mRe[ g ];
+				float* xi = &mIm[ g ];
+				float b0r = xr[ 0 ] + xr[ 1 ], b0i = xi[ 0 ] + xi[ 1 ];
+				float b1r = xr[ 0 ] - xr[ 1 ], b1i = xi[ 0 ] - xi[ 1 ];
+				float b2r = xr[ 2 ] + xr[ 3 ], b2i = xi[ 2 ] + xi[ 3 ];
+				float b3r = xr[ 2 ] - xr[ 3 ], b3i = xi[ 2 ] - xi[ 3 ];
+				xr[ 0 ] = b0r + b2r;    xi[ 0 ] = b0i + b2i;
+				xr[ 2 ] = b0r - b2r;    xi[ 2 ] = b0i - b2i;
+				xr[ 1 ] = b1r + b3i;    xi[ 1 ] = b1i - b3r;
+				xr[ 3 ] = b1r - b3i;    xi[ 3 ] = b1i + b3r;
+			}
+
+			//  The rest as radix-2, 4 butterflies at a time
+			const float* twiddleRe = mTwiddleRe.data();
+			const float* twiddleIm = mTwiddleIm.data();
+			for ( int span = 4; span < mHalf; span *= 2 )
+			{
+				for ( int g = 0; g < mHalf; g += 2 * span )
+				{
+					butterflies( &mRe[ g ], &mIm[ g ], span, twiddleRe, twiddleIm );
+				}
+				twiddleRe += span;
+				twiddleIm += span;
+			}
+
+			//  Split into the spectrum of the real samples
+			re[ 0 ]     = mRe[ 0 ] + mIm[ 0 ];
+			im[ 0 ]     = 0.0f;
+			re[ mHalf ] = mRe[ 0 ] - mIm[ 0 ];
+			im[ mHalf ] = 0.0f;
+			for ( int k = 1; k < mHalf; ++k )
+			{
+				//  Even and odd sample spectra from Z[ k ] and Z[ N / 2 - k ]
+				float zr = mRe[ k ], zi = mIm[ k ];
+				float cr = mRe[ mHalf - k ], ci = -mIm[ mHalf - k ];
+				float er = 0.5f * ( zr + cr ), ei = 0.5f * ( zi + ci );
+				float or_ = 0.5f * ( zi - ci ), oi = -0.5f * ( zr - cr );
+
+				re[ k ] = er + mSplitRe[ k ] * or_ - mSplitIm[ k ] * oi;
+				im[ k ] = ei + mSplitRe[ k ] * oi + mSplitIm[ k ] * or_;
+			}
+		}
+
+	private:
+		//  span butterflies between x[ j ] and x[ j + span ], span is a multiple of 4
+		static void butterflies( float* xr, float* xi, int span, const float* wr, const float* wi )
+		{
+			float* yr = xr + span;
+			float* yi = xi + span;
+			for ( int j = 0; j < span; j += 4 )
+			{
+				#if defined(LSPECTRUM_SSE2)
+				__m128 ar = _mm_loadu_ps( xr + j ), ai = _mm_loadu_ps( xi + j );
+				__m128 br = _mm_loadu_ps( yr + j ), bi = _mm_loadu_ps( yi + j );
+				__m128 cr = _mm_loadu_ps( wr + j ), ci = _mm_loadu_ps( wi + j );
+				__m128 tr = _mm_sub_ps( _mm_mul_ps( br, cr ), _mm_mul_ps( bi, ci ) );
+				__m128 ti = _mm_add_ps( _mm_mul_ps( br, ci ), _mm_mul_ps( bi, cr ) );
+				_mm_storeu_ps( xr + j, _mm_add_ps( ar, tr ) );
+				_mm_storeu_ps( xi + j, _mm_add_ps( ai, ti ) );
+				_mm_storeu_ps( yr + j, _mm_sub_ps( ar, tr ) );
+				_mm_storeu_ps( yi + j, _mm_sub_ps( ai, ti ) );
+				#elif defined(LSPECTRUM_NEON)
+				float32x4_t ar = vld1q_f32( xr + j ), ai = vld1q_f32( xi + j );
+				float32x4_t br = vld1q_f32( yr + j ), bi = vld1q_f32( yi + j );
+				float32x4_t cr = vld1q_f32( wr + j ), ci = vld1q_f32( wi + j );
+				float32x4_t tr = vmlsq_f32( vmulq_f32( br, cr ), bi, ci );
+				float32x4_t ti = vmlaq_f32( vmulq_f32( br, ci ), bi, cr );
+				vst1q_f32( xr + j, vaddq_f32( ar, tr ) );
+				vst1q_f32( xi + j, vaddq_f32( ai, ti ) );
+				vst1q_f32( yr + j, vsubq_f32( ar, tr ) );
+				vst1q_f32( yi + j, vsubq_f32( ai, ti ) );
+				#else
+				for ( int k = j; k < j + 4; ++k )
+				{
+					float tr = yr[ k ] * wr[ k ] - yi[ k ] * wi[ k ];
+					float ti = yr[ k ] * wi[ k ] + yi[ k ] * wr[ k ];
+					yr[ k ] = xr[ k ] - tr;
+					yi[ k ] = xi[ k ] - ti;
+					xr[ k ] += tr;
+					xi[ k ] += ti;
+				}
+				#endif
+			}
+		}
+
+		//  Real samples and complex points
+		int mSize;
+		int mHalf;
+
+		//  Bit reversal, stage and split twiddles
+		std::vector<int>    mReverse;
+		std::vector<float>  mTwiddleRe, mTwiddleIm;
+		std::vector<float>  mSplitRe, mSplitIm;
+
+		//  Complex points being transformed
+		std::vector<float>  mRe, mIm;
+};
+
+//  Latest levels and spectrum, all in dB from full scale
+struct LSpectrumFrame
+{
+	//  Channels analyzed
+	int     channels;
+
+	//  Sample peak and RMS over the last half window
+	float   peak[ SPECTRUM_MAX_CHANNELS ];
+	float   rms[ SPECTRUM_MAX_CHANNELS ];
+
+	//  Level of each band
+	float   bands[ SPECTRUM_MAX_CHANNELS ][ SPECTRUM_BANDS ];
+
+	//  Clipped samples since starting
+	Uint32  clipped;
+};
+
+//  Analyzes audio from a ring on its own thread
+class LSpectrumAnalyzer
+{
+	public:
+		//  Initializes internals
+		LSpectrumAnalyzer()
+		{
+			mRing       = NULL;
+			mThread     = NULL;
+			mMutex      = NULL;
+			mQuit       = false;
+			mChannels   = 0;
+			mScale      = 0.0f;
+			mFilled     = 0;
+			mPending    = 0;
+			mBusyTicks  = 0;
+			mWallTicks  = 0;
+			mReady      = false;
+			SDL_zero( mSpec );
+			SDL_zero( mFrame );
+			SDL_zero( mShared );
+		}
+
+		//  Stops analyzing
+		~LSpectrumAnalyzer()
+		{
+			stop();
+			if  ( mMutex != NULL )
+			{
+				SDL_DestroyMutex( mMutex );
+			}
+		}
+
+		//  Sets up analysis of audio in spec, without a thread
+		bool init( const SDL_AudioSpec& spec )
+		{
+			if  ( !isConvertibleFormat( spec.format ) || !mFFT.init( SPECTRUM_FFT_SIZE ) )
+			{
+				printf( "Unable to analyze audio format %04X!\n", spec.format );
+				return false;
+			}
+			if  ( mMutex == NULL && ( mMutex = SDL_CreateMutex() ) == NULL )
+			{
+				printf( "Unable to create analyzer mutex! SDL Error: %s\n", SDL_GetError() );
+				return false;
+			}
+			mSpec       = spec;
+			mChannels   = SDL_min( (int) spec.channels, SPECTRUM_MAX_CHANNELS );
+
+			//  Hann window and its gain, a full scale sine peaks at half of it
+			mWindow.resize( SPECTRUM_FFT_SIZE );
+			float gain = 0.0f;
+			for ( int i = 0; i < SPECTRUM_FFT_SIZE; ++i )
+			{
+				mWindow[ i ] = (float)( 0.5 - 0.5 * cos( 2.0 * M_PI * i / SPECTRUM_FFT_SIZE ) );
+				gain += mWindow[ i ];
+			}
+			mScale = 2.0f / gain;
+
+			//  Log spaced bands, each at least one bin wide
+			float nyquist   = spec.freq / 2.0f;
+			float high      = SDL_min( SPECTRUM_HIGH_FREQUENCY, nyquist );
+			float binWidth  = (float) spec.freq / SPECTRUM_FFT_SIZE;
+			int   bin       = SDL_max( (int)( SPECTRUM_LOW_FREQUENCY / binWidth ), 1 );
+			for ( int band = 0; band < SPECTRUM_BANDS; ++band )
+			{
+				float edge = SPECTRUM_LOW_FREQUENCY * powf( high / SPECTRUM_LOW_FREQUENCY, (float)( band + 1 ) / SPECTRUM_BANDS );
+				mBandStart[ band ] = SDL_min( bin, SPECTRUM_FFT_SIZE / 2 );
+				bin = SDL_max( (int)( edge / binWidth + 0.5f ), bin + 1 );
+				mBandEnd[ band ] = SDL_min( bin, SPECTRUM_FFT_SIZE / 2 + 1 );
+			}
+
+			//  Room for a window per channel and a half window of samples
+			mHistory.resize( SPECTRUM_FFT_SIZE * mChannels );
+			mWindowed.resize( SPECTRUM_FFT_SIZE );
+			mBinRe.resize( SPECTRUM_FFT_SIZE / 2 + 1 );
+			mBinIm.resize( SPECTRUM_FFT_SIZE / 2 + 1 );
+			mBytes.resize( SPECTRUM_FFT_SIZE / 2 * spec.channels * ( SDL_AUDIO_BITSIZE( spec.format ) / 8 ) );
+			mSamples.resize( SPECTRUM_FFT_SIZE / 2 * spec.channels );
+			reset();
+
+			return true;
+		}
+
+		//  Starts the thread that empties the ring into the analysis
+		bool start( const SDL_AudioSpec& spec, LRingBuffer* ring )
+		{
+			stop();
+			if  ( !init( spec ) )
+			{
+				return false;
+			}
+
+			mRing = ring;
+			mQuit.store( false, std::memory_order_relaxed );
+			mThread = SDL_CreateThread( analyzer, "Spectrum analyzer", this );
+			if  ( mThread == NULL )
+			{
+				printf( "Unable to create analyzer thread! SDL Error: %s\n", SDL_GetError() );
+				return false;
+			}
+
+			return true;
+		}
+
+		//  Stops the thread
+		void stop()
+		{
+			if  ( mThread != NULL )
+			{
+				mQuit.store( true, std::memory_order_release );
+				SDL_WaitThread( mThread, NULL );
+				mThread = NULL;
+			}
+		}
+
+		//  Starts over with silence
+		void reset()
+		{
+			std::fill( mHistory.begin(), mHistory.end(), 0.0f );
+			mFilled     = 0;
+			mPending    = 0;
+			mBusyTicks  = 0;
+			mWallTicks  = 0;
+			mFrame.channels = mChannels;
+			mFrame.clipped  = 0;
+			for ( int c = 0; c < SPECTRUM_MAX_CHANNELS; ++c )
+			{
+				mPeak[ c ]  = 0.0f;
+				mPower[ c ] = 0.0f;
+				mFrame.peak[ c ] = mFrame.rms[ c ] = SPECTRUM_MIN_DB;
+				for ( int band = 0; band < SPECTRUM_BANDS; ++band )
+				{
+					mFrame.bands[ c ][ band ] = SPECTRUM_MIN_DB;
+				}
+			}
+			mReady = false;
+		}
+
+		//  Adds frames of interleaved float in the spec's channels, analyzing every half window
+		void analyze( const float* samples, int frames )
+		{
+			int channels = mSpec.channels;
+			while   ( frames > 0 )
+			{
+				//  Fill the back half of the window
+				int count = SDL_min( frames, SPECTRUM_FFT_SIZE - mFilled );
+				for ( int c = 0; c < mChannels; ++c )
+				{
+					float*  history = &mHistory[ c * SPECTRUM_FFT_SIZE + mFilled ];
+					float   peak    = 0.0f;
+					float   power   = 0.0f;
+					Uint32  clipped = 0;
+					for ( int i = 0; i < count; ++i )
+					{
+						float sample = samples[ i * channels + c ];
+						float level  = fabsf( sample );
+						history[ i ] = sample;
+						peak    = SDL_max( peak, level );
+						power   += sample * sample;
+						clipped += level >= SPECTRUM_CLIP_LEVEL;
+					}
+					mPeak[ c ]      = SDL_max( mPeak[ c ], peak );
+					mPower[ c ]     += power;
+					mFrame.clipped  += clipped;
+				}
+				samples += count * channels;
+				frames  -= count;
+				mFilled += count;
+				mPending += count;
+
+				if  ( mFilled == SPECTRUM_FFT_SIZE )
+				{
+					update();
+				}
+			}
+		}
+
+		//  Copies out the latest results, returns false before the first
+		bool getFrame( LSpectrumFrame* frame )
+		{
+			if  ( mMutex == NULL )
+			{
+				return false;
+			}
+
+			SDL_LockMutex( mMutex );
+			bool ready = mReady;
+			*frame = mShared;
+			SDL_UnlockMutex( mMutex );
+
+			return ready;
+		}
+
+		//  Gets the share of the thread's time spent analyzing, once stopped
+		double getLoad() const
+		{
+			return mWallTicks > 0 ? (double) mBusyTicks / mWallTicks : 0.0;
+		}
+
+	private:
+		//  Empties the ring until stopped
+		static int analyzer( void* data )
+		{
+			LSpectrumAnalyzer*  spectrum    = (LSpectrumAnalyzer*) data;
+			int                 frameBytes  = spectrum->mSpec.channels * ( SDL_AUDIO_BITSIZE( spectrum->mSpec.format ) / 8 );
+			Uint64              started     = SDL_GetPerformanceCounter();
+
+			while   ( !spectrum->mQuit.load( std::memory_order_acquire ) )
+			{
+				//  Take whole frames, up to half a window
+				Uint32 bytes = spectrum->mRing->getReadable();
+				bytes = SDL_min( bytes - bytes % frameBytes, (Uint32) spectrum->mBytes.size() );
+				if  ( bytes == 0 )
+				{
+					SDL_Delay( 10 );
+					continue;
+				}
+
+				Uint64 start = SDL_GetPerformanceCounter();
+				spectrum->mRing->read( spectrum->mBytes.data(), bytes );
+				int frames = bytes / frameBytes;
+				samplesToFloat( spectrum->mBytes.data(), spectrum->mSpec.format, frames * spectrum->mSpec.channels, spectrum->mSamples.data() );
+				spectrum->analyze( spectrum->mSamples.data(), frames );
+
+				Uint64 now = SDL_GetPerformanceCounter();
+				spectrum->mBusyTicks += now - start;
+				spectrum->mWallTicks = now - started;
+			}
+
+			return 0;
+		}
+
+		//  Analyzes the full window, then slides it on by half
+		void update()
+		{
+			for ( int c = 0; c < mChannels; ++c )
+			{
+				float* history = &mHistory[ c * SPECTRUM_FFT_SIZE ];
+
+				//  Levels of the samples since the last update
+				mFrame.peak[ c ]    = toDecibels( mPeak[ c ] );
+				mFrame.rms[ c ]     = toDecibels( sqrtf( mPower[ c ] / mPending ) );
+				mPeak[ c ]          = 0.0f;
+				mPower[ c ]         = 0.0f;
+
+				//  Windowed transform
+				for ( int i = 0; i < SPECTRUM_FFT_SIZE; ++i )
+				{
+					mWindowed[ i ] = history[ i ] * mWindow[ i ];
+				}
+				mFFT.transform( mWindowed.data(), mBinRe.data(), mBinIm.data() );
+
+				//  Strongest bin in each band, falling back gradually
+				for ( int band = 0; band < SPECTRUM_BANDS; ++band )
+				{
+					float power = 0.0f;
+					for ( int bin = mBandStart[ band ]; bin < mBandEnd[ band ]; ++bin )
+					{
+						power = SDL_max( power, mBinRe[ bin ] * mBinRe[ bin ] + mBinIm[ bin ] * mBinIm[ bin ] );
+					}
+					float level = toDecibels( sqrtf( power ) * mScale );
+					mFrame.bands[ c ][ band ] = SDL_max( level, mFrame.bands[ c ][ band ] - SPECTRUM_FALLOFF_DB );
+				}
+
+				//  Keep the back half as the next front half
+				memmove( history, history + SPECTRUM_FFT_SIZE / 2, SPECTRUM_FFT_SIZE / 2 * sizeof( float ) );
+			}
+			mFilled     = SPECTRUM_FFT_SIZE / 2;
+			mPending    = 0;
+
+			//  Publish
+			SDL_LockMutex( mMutex );
+			mShared = mFrame;
+			mReady  = true;
+			SDL_UnlockMutex( mMutex );
+		}
+
+		//  Amplitude to dB from full scale, floored
+		static float toDecibels( float amplitude )
+		{
+			return amplitude > 0.0f ? SDL_max( 20.0f * log10f( amplitude ), SPECTRUM_MIN_DB ) : SPECTRUM_MIN_DB;
+		}
+
+		//  Format of the ring and channels analyzed
+		SDL_AudioSpec   mSpec;
+		int             mChannels;
+
+		//  The ring being emptied and the thread doing it
+		LRingBuffer*        mRing;
+		SDL_Thread*         mThread;
+		std::atomic<bool>   mQuit;
+
+		//  Raw and float samples taken at a time
+		std::vector<Uint8>  mBytes;
+		std::vector<float>  mSamples;
+
+		//  Window of samples per channel, how full it is and samples since the last update
+		std::vector<float>  mHistory;
+		int                 mFilled;
+		int                 mPending;
+
+		//  Peak and power since the last update
+		float   mPeak[ SPECTRUM_MAX_CHANNELS ];
+		float   mPower[ SPECTRUM_MAX_CHANNELS ];
+
+		//  Transform, window and its scale to full scale
+		LFFT                mFFT;
+		std::vector<float>  mWindow;
+		std::vector<float>  mWindowed;
+		float               mScale;
+
+		//  Bins and the bins in each band
+		std::vector<float>  mBinRe, mBinIm;
+		int                 mBandStart[ SPECTRUM_BANDS ];
+		int                 mBandEnd[ SPECTRUM_BANDS ];
+
+		//  Results being worked on and the ones published under the mutex
+		LSpectrumFrame  mFrame;
+		LSpectrumFrame  mShared;
+		bool            mReady;
+		SDL_mutex*      mMutex;
+
+		//  Performance counter ticks spent analyzing and since starting
+		Uint64  mBusyTicks;
+		Uint64  mWallTicks;
+};
+
+#endif
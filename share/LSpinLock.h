@@ -0,0 +1,282 @@
+/*  Spin locks that back off, shared by the threading lessons.
+
+    SDL_AtomicLock retries its swap as fast as it can. Every retry pulls
+    the lock's cache line over to the spinning core, and a core stuck
+    spinning is a core the render thread can't use.
+
+    LSpinLock only reads the lock while it is taken and only tries to
+    take it once it looks free. Between looks it waits with pause
+    instructions, twice as long each time. If that goes on too long it
+    sleeps on the lock word, which is a futex on Linux, and unlock only
+    makes a system call when someone is asleep.
+
+    LTicketLock hands the lock out in the order threads asked for it,
+    so nobody starves. It costs a handoff per unlock even when a thread
+    could have retaken the lock on its own.
+
+    Both count how they were taken. The counts are only written while
+    holding the lock, so they need no atomics of their own.        */
+
+#ifndef LSPINLOCK_H
+#define LSPINLOCK_H
+
+//  Using SDL, atomics and threads
+#include <SDL.h>
+#include <atomic>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+//  Looks at a busy LSpinLock before sleeping
+const int LOCK_SPIN_ROUNDS  = 16;
+
+//  Most pause instructions between two looks
+const int LOCK_MAX_BACKOFF  = 64;
+
+//  Pause instructions per thread ahead in an LTicketLock
+const int LOCK_TICKET_PAUSE = 32;
+
+//  Tells the core this is a spin loop
+inline void cpuPause()
+{
+	#if defined(__SSE2__) || defined(_M_X64)
+	_mm_pause();
+	#else
+	std::this_thread::yield();
+	#endif
+}
+
+//  How a lock was taken
+struct LLockStats
+{
+	//  Times taken and times it was busy at first
+	Uint64 acquisitions;
+	Uint64 contended;
+
+	//  Pause instructions spent waiting and times a thread slept
+	Uint64 spins;
+	Uint64 parks;
+};
+
+//  Test and test and set lock with exponential backoff, sleeps when it gives up
+class LSpinLock
+{
+	public:
+		//  Initializes an unlocked lock
+		LSpinLock()
+		{
+			mState = UNLOCKED;
+			resetStats();
+		}
+
+		//  Takes the lock
+		void lock()
+		{
+			int expected = UNLOCKED;
+			if  ( mState.compare_exchange_strong( expected, LOCKED, std::memory_order_acquire ) )
+			{
+				++mStats.acquisitions;
+				return;
+			}
+
+			lockContended();
+		}
+
+		//  Takes the lock if it is free
+		bool tryLock()
+		{
+			int expected = UNLOCKED;
+			if  ( mState.load( std::memory_order_relaxed ) != UNLOCKED
+			   || !mState.compare_exchange_strong( expected, LOCKED, std::memory_order_acquire ) )
+			{
+				return false;
+			}
+
+			++mStats.acquisitions;
+			return true;
+		}
+
+		//  Releases the lock, waking one sleeper if there are any
+		void unlock()
+		{
+			if  ( mState.exchange( UNLOCKED, std::memory_order_release ) == SLEEPERS )
+			{
+				mState.notify_one();
+			}
+		}
+
+		//  Gets the counts, only exact while no thread holds the lock
+		LLockStats getStats() const
+		{
+			return mStats;
+		}
+
+		//  Clears the counts
+		void resetStats()
+		{
+			mStats = LLockStats();
+		}
+
+	private:
+		//  Free, taken, and taken with someone asleep on it
+		enum LockState
+		{
+			UNLOCKED,
+			LOCKED,
+			SLEEPERS
+		};
+
+		//  Spins with backoff, then sleeps until the lock is ours
+		void lockContended()
+		{
+			Uint64  spins   = 0;
+			int     backoff = 1;
+			for ( int round = 0; round < LOCK_SPIN_ROUNDS; ++round )
+			{
+				//  Only try the swap once it looks free, looking shares the line
+				int expected = UNLOCKED;
+				if  ( mState.load( std::memory_order_relaxed ) == UNLOCKED
+				   && mState.compare_exchange_strong( expected, LOCKED, std::memory_order_acquire ) )
+				{
+					record( spins, 0 );
+					return;
+				}
+
+				for ( int i = 0; i < backoff; ++i )
+				{
+					cpuPause();
+				}
+				spins   += backoff;
+				backoff  = backoff * 2 < LOCK_MAX_BACKOFF ? backoff * 2 : LOCK_MAX_BACKOFF;
+			}
+
+			//  Mark the lock as slept on so unlock wakes us, then sleep while it is
+			Uint64 parks = 0;
+			while   ( mState.exchange( SLEEPERS, std::memory_order_acquire ) != UNLOCKED )
+			{
+				mState.wait( SLEEPERS, std::memory_order_relaxed );
+				++parks;
+			}
+			record( spins, parks );
+		}
+
+		//  Counts a contended acquisition, called holding the lock
+		void record( Uint64 spins, Uint64 parks )
+		{
+			++mStats.acquisitions;
+			++mStats.contended;
+			mStats.spins += spins;
+			mStats.parks += parks;
+		}
+
+		//  The lock word and the counts
+		std::atomic<int>    mState;
+		LLockStats          mStats;
+};
+
+//  First come first served lock
+class LTicketLock
+{
+	public:
+		//  Initializes an unlocked lock
+		LTicketLock()
+		{
+			mNext       = 0;
+			mServing    = 0;
+			mSleepers   = 0;
+			resetStats();
+		}
+
+		//  Takes a ticket and waits for it to be served
+		void lock()
+		{
+			Uint32 ticket   = mNext.fetch_add( 1, std::memory_order_relaxed );
+			Uint32 serving  = mServing.load( std::memory_order_acquire );
+			if  ( serving == ticket )
+			{
+				++mStats.acquisitions;
+				return;
+			}
+
+			//  Wait in proportion to the threads ahead, they go first anyway
+			Uint64 spins = 0;
+			for ( int round = 0; round < LOCK_SPIN_ROUNDS && serving != ticket; ++round )
+			{
+				int backoff = (int)( ticket - serving ) * LOCK_TICKET_PAUSE;
+				backoff     = backoff < LOCK_MAX_BACKOFF * 4 ? backoff : LOCK_MAX_BACKOFF * 4;
+				for ( int i = 0; i < backoff; ++i )
+				{
+					cpuPause();
+				}
+				spins   += backoff;
+				serving  = mServing.load( std::memory_order_acquire );
+			}
+
+			//  Sleep on the served ticket until it is ours
+			Uint64 parks = 0;
+			if  ( serving != ticket )
+			{
+				mSleepers.fetch_add( 1, std::memory_order_seq_cst );
+				while   ( ( serving = mServing.load( std::memory_order_seq_cst ) ) != ticket )
+				{
+					mServing.wait( serving, std::memory_order_acquire );
+					++parks;
+				}
+				mSleepers.fetch_sub( 1, std::memory_order_relaxed );
+			}
+
+			++mStats.acquisitions;
+			++mStats.contended;
+			mStats.spins += spins;
+			mStats.parks += parks;
+		}
+
+		//  Takes the lock if nobody holds or waits for it
+		bool tryLock()
+		{
+			Uint32 serving  = mServing.load( std::memory_order_acquire );
+			Uint32 expected = serving;
+			if  ( !mNext.compare_exchange_strong( expected, serving + 1, std::memory_order_relaxed ) )
+			{
+				return false;
+			}
+
+			++mStats.acquisitions;
+			return true;
+		}
+
+		//  Serves the next ticket, waking sleepers so its owner can run
+		void unlock()
+		{
+			mServing.fetch_add( 1, std::memory_order_seq_cst );
+			if  ( mSleepers.load( std::memory_order_seq_cst ) > 0 )
+			{
+				mServing.notify_all();
+			}
+		}
+
+		//  Gets the counts, only exact while no thread holds the lock
+		LLockStats getStats() const
+		{
+			return mStats;
+		}
+
+		//  Clears the counts
+		void resetStats()
+		{
+			mStats = LLockStats();
+		}
+
+	private:
+		//  Next ticket to hand out and ticket being served, on their own cache lines
+		alignas( 64 ) std::atomic<Uint32>   mNext;
+		alignas( 64 ) std::atomic<Uint32>   mServing;
+
+		//  Threads asleep on mServing and the counts
+		alignas( 64 ) std::atomic<int>      mSleepers;
+		LLockStats                          mStats;
+};
+
+#endif
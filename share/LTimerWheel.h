@@ -0,0 +1,366 @@
+/*  Hierarchical timer wheel for callbacks that must run on the game
+    thread, shared by the timer lessons.
+
+    SDL_AddTimer runs every callback on SDL's timer thread, from one
+    list, so tens of thousands of cooldowns and despawns all go through
+    that thread and then have to be handed back to the game. The wheel
+    instead keeps four rings of 256 slots. The first ring holds the next
+    256 milliseconds one slot each, the next ring holds 256 of those
+    spans, and so on up to about 49 days. Adding or cancelling a timer
+    only links or unlinks it in one slot. When the first ring comes back
+    around, the next ring's slot is spread over it.
+
+    The frame loop calls update, which reads the performance counter
+    and fires everything that came due since the last frame, in one
+    batch on the calling thread. Callbacks look like SDL's: returning a
+    non zero interval runs the timer again that much later.       */
+
+#ifndef LTIMERWHEEL_H
+#define LTIMERWHEEL_H
+
+//  Using SDL and vectors
+#include <SDL.h>
+#include <vector>
+
+//  Rings in the wheel and slots per ring, as a shift
+const int TIMER_LEVELS      = 4;
+const int TIMER_SLOT_BITS   = 8;
+const int TIMER_SLOTS       = 1 << TIMER_SLOT_BITS;
+
+//  Same as SDL_TimerCallback, returns the next interval or 0 to stop
+typedef Uint32 ( *LTimerCallback )( Uint32 interval, void* param );
+
+//  Names a timer, 0 is never a timer
+typedef Uint64 LTimerID;
+
+//  Timers in milliseconds, fired by the thread that updates the wheel
+class LTimerWheel
+{
+	public:
+		//  Initializes an empty wheel at time 0
+		LTimerWheel()
+		{
+			mOrigin = 0;
+			clear();
+		}
+
+		//  Makes room for timers without growing later
+		void reserve( Uint32 timers )
+		{
+			mTimers.reserve( timers );
+		}
+
+		//  Makes the performance counter's current value time 0
+		void start()
+		{
+			clear();
+			mOrigin = SDL_GetPerformanceCounter();
+		}
+
+		//  Forgets every timer and goes back to time 0
+		void clear()
+		{
+			mTimers.clear();
+			for ( int i = 0; i < TIMER_LEVELS * TIMER_SLOTS; ++i )
+			{
+				mSlots[ i ] = NO_TIMER;
+			}
+			for ( int i = 0; i < TIMER_LEVELS; ++i )
+			{
+				mLevelCounts[ i ] = 0;
+			}
+			mFree       = NO_TIMER;
+			mFiring     = NO_TIMER;
+			mRunning    = NO_TIMER;
+			mCancelled  = false;
+			mCount      = 0;
+			mNow        = 1;
+		}
+
+		//  Calls callback with param after interval milliseconds
+		LTimerID add( Uint32 interval, LTimerCallback callback, void* param )
+		{
+			if  ( callback == NULL )
+			{
+				return 0;
+			}
+
+			//  Reuse a freed timer or make a new one
+			Uint32 index = mFree;
+			if  ( index != NO_TIMER )
+			{
+				mFree = mTimers[ index ].next;
+			}
+			else
+			{
+				index = (Uint32) mTimers.size();
+				mTimers.push_back( Timer() );
+				mTimers[ index ].generation = 0;
+			}
+
+			Timer& timer    = mTimers[ index ];
+			timer.interval  = interval;
+			timer.callback  = callback;
+			timer.param     = param;
+			++mCount;
+
+			schedule( index, getTime() + interval );
+
+			return ( (LTimerID) timer.generation << 32 | index ) + 1;
+		}
+
+		//  Stops a timer, false if it already fired for good or was cancelled
+		bool cancel( LTimerID id )
+		{
+			Uint32 index = (Uint32)( id - 1 );
+			if  ( id == 0 || index >= mTimers.size() || mTimers[ index ].generation != (Uint32)( ( id - 1 ) >> 32 ) )
+			{
+				return false;
+			}
+
+			//  A callback cancelling its own timer, freed once it returns
+			if  ( index == mRunning )
+			{
+				if  ( mCancelled )
+				{
+					return false;
+				}
+				mCancelled = true;
+				return true;
+			}
+
+			unlink( index );
+			release( index );
+			return true;
+		}
+
+		//  Fires every timer due by the performance counter, returns how many fired
+		int update()
+		{
+			Uint64 elapsed = SDL_GetPerformanceCounter() - mOrigin;
+			return advanceTo( elapsed * 1000 / SDL_GetPerformanceFrequency() );
+		}
+
+		//  Fires every timer due by time milliseconds, returns how many fired
+		int advanceTo( Uint64 time )
+		{
+			int fired = 0;
+			while   ( mNow <= time )
+			{
+				//  Nothing to fire or bring down, skip to the end
+				if  ( mCount == 0 )
+				{
+					mNow = time + 1;
+					break;
+				}
+
+				//  Nothing in the first ring, skip to where it wraps
+				if  ( mLevelCounts[ 0 ] == 0 )
+				{
+					Uint64 wrap = ( mNow + TIMER_SLOTS - 1 ) & ~(Uint64)( TIMER_SLOTS - 1 );
+					if  ( wrap > time )
+					{
+						mNow = time + 1;
+						break;
+					}
+					mNow = wrap;
+				}
+
+				fired += tick();
+			}
+
+			return fired;
+		}
+
+		//  Gets the last time fired, in milliseconds
+		Uint64 getTime() const
+		{
+			return mNow - 1;
+		}
+
+		//  Gets how many timers are waiting
+		Uint32 getCount() const
+		{
+			return mCount;
+		}
+
+	private:
+		//  Ends a list of timers
+		static const Uint32 NO_TIMER    = 0xFFFFFFFF;
+
+		//  Slot of a timer that is about to fire or firing
+		static const Uint32 FIRING_SLOT = 0xFFFFFFFF;
+
+		//  A timer, linked into a slot by index
+		struct Timer
+		{
+			Uint64          expires;
+			Uint32          interval;
+			LTimerCallback  callback;
+			void*           param;
+			Uint32          next;
+			Uint32          prev;
+			Uint32          slot;
+			Uint32          generation;
+		};
+
+		//  Links a timer into the slot for expires
+		void schedule( Uint32 index, Uint64 expires )
+		{
+			if  ( expires < mNow )
+			{
+				expires = mNow;
+			}
+
+			//  Further than the wheel reaches, park it in the last ring's furthest slot
+			Uint64 delta = expires - mNow;
+			if  ( delta >= (Uint64) 1 << ( TIMER_SLOT_BITS * TIMER_LEVELS ) )
+			{
+				delta   = ( (Uint64) 1 << ( TIMER_SLOT_BITS * TIMER_LEVELS ) ) - 1;
+				expires = mNow + delta;
+			}
+
+			int level = 0;
+			while   ( delta >= (Uint64) 1 << ( TIMER_SLOT_BITS * ( level + 1 ) ) )
+			{
+				++level;
+			}
+
+			Uint32 slot     = level * TIMER_SLOTS + (Uint32)( ( expires >> ( TIMER_SLOT_BITS * level ) ) & ( TIMER_SLOTS - 1 ) );
+			Timer& timer    = mTimers[ index ];
+			timer.expires   = expires;
+			timer.slot      = slot;
+			timer.prev      = NO_TIMER;
+			timer.next      = mSlots[ slot ];
+			if  ( timer.next != NO_TIMER )
+			{
+				mTimers[ timer.next ].prev = index;
+			}
+			mSlots[ slot ] = index;
+			++mLevelCounts[ level ];
+		}
+
+		//  Takes a timer out of its slot or out of the batch being fired
+		void unlink( Uint32 index )
+		{
+			Timer&  timer   = mTimers[ index ];
+			Uint32* head    = &mFiring;
+			if  ( timer.slot != FIRING_SLOT )
+			{
+				head = &mSlots[ timer.slot ];
+				--mLevelCounts[ timer.slot / TIMER_SLOTS ];
+			}
+
+			if  ( timer.prev != NO_TIMER )
+			{
+				mTimers[ timer.prev ].next = timer.next;
+			}
+			else
+			{
+				*head = timer.next;
+			}
+			if  ( timer.next != NO_TIMER )
+			{
+				mTimers[ timer.next ].prev = timer.prev;
+			}
+		}
+
+		//  Puts a timer on the free list, old IDs stop matching it
+		void release( Uint32 index )
+		{
+			Timer& timer    = mTimers[ index ];
+			++timer.generation;
+			timer.callback  = NULL;
+			timer.next      = mFree;
+			mFree           = index;
+			--mCount;
+		}
+
+		//  Spreads one slot of a higher ring over the rings below it
+		void cascade( int level )
+		{
+			Uint32 slot     = level * TIMER_SLOTS + (Uint32)( ( mNow >> ( TIMER_SLOT_BITS * level ) ) & ( TIMER_SLOTS - 1 ) );
+			Uint32 index    = mSlots[ slot ];
+			mSlots[ slot ]  = NO_TIMER;
+			while   ( index != NO_TIMER )
+			{
+				Uint32 next = mTimers[ index ].next;
+				--mLevelCounts[ level ];
+				schedule( index, mTimers[ index ].expires );
+				index = next;
+			}
+		}
+
+		//  Fires the slot for mNow, then moves on a millisecond
+		int tick()
+		{
+			//  The first ring came around, bring down what is due in its next lap
+			for ( int level = 1; level < TIMER_LEVELS; ++level )
+			{
+				if  ( ( mNow & ( ( (Uint64) 1 << ( TIMER_SLOT_BITS * level ) ) - 1 ) ) != 0 )
+				{
+					break;
+				}
+				cascade( level );
+			}
+
+			//  Take the whole slot as one batch
+			Uint32 slot     = (Uint32)( mNow & ( TIMER_SLOTS - 1 ) );
+			mFiring         = mSlots[ slot ];
+			mSlots[ slot ]  = NO_TIMER;
+			for ( Uint32 index = mFiring; index != NO_TIMER; index = mTimers[ index ].next )
+			{
+				mTimers[ index ].slot = FIRING_SLOT;
+				--mLevelCounts[ 0 ];
+			}
+			++mNow;
+
+			//  Callbacks may add or cancel timers, including ones in this batch
+			int fired = 0;
+			while   ( mFiring != NO_TIMER )
+			{
+				Uint32 index = mFiring;
+				unlink( index );
+
+				mRunning    = index;
+				mCancelled  = false;
+				Uint32 next = mTimers[ index ].callback( mTimers[ index ].interval, mTimers[ index ].param );
+				mRunning    = NO_TIMER;
+				++fired;
+
+				//  Run again from when it was due, so repeats don't drift
+				if  ( next != 0 && !mCancelled )
+				{
+					mTimers[ index ].interval = next;
+					schedule( index, mTimers[ index ].expires + next );
+				}
+				else
+				{
+					release( index );
+				}
+			}
+
+			return fired;
+		}
+
+		//  Every timer ever made, free ones chained through next
+		std::vector<Timer>  mTimers;
+		Uint32              mFree;
+
+		//  First timer in each slot and timers in each ring
+		Uint32              mSlots[ TIMER_LEVELS * TIMER_SLOTS ];
+		Uint32              mLevelCounts[ TIMER_LEVELS ];
+
+		//  The batch being fired, the timer whose callback is running,
+		//	and whether that callback cancelled it
+		Uint32              mFiring;
+		Uint32              mRunning;
+		bool                mCancelled;
+
+		//  Timers waiting, next millisecond to fire and the counter's time 0
+		Uint32              mCount;
+		Uint64              mNow;
+		Uint64              mOrigin;
+};
+
+#endif
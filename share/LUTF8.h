@@ -0,0 +1,97 @@
+/*  UTF-8 decoding and encoding, shared by the font lessons.
+
+    Text is decoded strictly: a bad lead byte, a missing continuation
+    byte, an overlong form, a surrogate or a value past U+10FFFF each
+    turn into U+FFFD. A byte that breaks a sequence is decoded again as
+    the start of the next character, so one bad byte costs one
+    character.                                                      */
+
+#ifndef LUTF8_H
+#define LUTF8_H
+
+//  Using SDL and strings
+#include <SDL.h>
+#include <string>
+
+//  Decodes the UTF-8 character at offset and moves past it
+inline Uint32 nextCodepoint( const std::string& text, int& offset )
+{
+	Uint32  lead = (unsigned char) text[ offset++ ];
+
+	//  Plain ASCII
+	if  ( lead < 0x80 )
+	{
+		return lead;
+	}
+
+	//  Length of the sequence from the lead byte
+	int     extra       = 0;
+	Uint32  codepoint   = 0;
+	if      ( ( lead & 0xE0 ) == 0xC0 ) { extra = 1; codepoint = lead & 0x1F; }
+	else if ( ( lead & 0xF0 ) == 0xE0 ) { extra = 2; codepoint = lead & 0x0F; }
+	else if ( ( lead & 0xF8 ) == 0xF0 ) { extra = 3; codepoint = lead & 0x07; }
+	else
+	{
+		return 0xFFFD;
+	}
+
+	//  Continuation bytes
+	for ( int i = 0; i < extra; ++i )
+	{
+		if  ( offset >= (int) text.length() || ( text[ offset ] & 0xC0 ) != 0x80 )
+		{
+			return 0xFFFD;
+		}
+		codepoint = ( codepoint << 6 ) | ( text[ offset++ ] & 0x3F );
+	}
+
+	//  Reject overlong forms, surrogates and values past Unicode
+	const Uint32 minimum[ 4 ] = { 0, 0x80, 0x800, 0x10000 };
+	if  (
+            codepoint < minimum[ extra ]                        ||
+            codepoint > 0x10FFFF                                ||
+            ( codepoint >= 0xD800 && codepoint <= 0xDFFF )
+        )
+	{
+		return 0xFFFD;
+	}
+
+	return codepoint;
+}
+
+//  Decodes like nextCodepoint, but past the basic multilingual plane
+//	gives U+FFFD, SDL_ttf glyph functions take 16 bit characters
+inline Uint16 nextCharacter( const std::string& text, int& offset )
+{
+	Uint32 codepoint = nextCodepoint( text, offset );
+	return codepoint > 0xFFFF ? 0xFFFD : (Uint16) codepoint;
+}
+
+//  Appends a character as UTF-8
+inline void appendCharacter( std::string& text, Uint32 codepoint )
+{
+	if  ( codepoint < 0x80 )
+	{
+		text += (char) codepoint;
+	}
+	else if ( codepoint < 0x800 )
+	{
+		text += (char)( 0xC0 | ( codepoint >> 6 ) );
+		text += (char)( 0x80 | ( codepoint & 0x3F ) );
+	}
+	else if ( codepoint < 0x10000 )
+	{
+		text += (char)( 0xE0 | ( codepoint >> 12 ) );
+		text += (char)( 0x80 | ( ( codepoint >> 6 ) & 0x3F ) );
+		text += (char)( 0x80 | ( codepoint & 0x3F ) );
+	}
+	else
+	{
+		text += (char)( 0xF0 | ( codepoint >> 18 ) );
+		text += (char)( 0x80 | ( ( codepoint >> 12 ) & 0x3F ) );
+		text += (char)( 0x80 | ( ( codepoint >> 6 ) & 0x3F ) );
+		text += (char)( 0x80 | ( codepoint & 0x3F ) );
+	}
+}
+
+#endif